@@ -0,0 +1,337 @@
+//
+// Created by hexiufeng on 2026/10/19.
+//
+
+#include "audio_convert.h"
+#include <limits.h>
+#include <stdlib.h>
+#include <libavutil/channel_layout.h>
+#include <libavutil/common.h>
+#include <libavutil/error.h>
+#include <libavutil/mem.h>
+#include <libavutil/opt.h>
+#include <libavutil/samplefmt.h>
+
+/* where a chunk of samples with a timestamp of its own starts in the fifo */
+typedef struct PtsMark {
+    int64_t pos;
+    int64_t pts;
+} PtsMark;
+
+int audio_convert_pick_format(const int *formats, int in)
+{
+    int bps = av_get_bytes_per_sample(in);
+    int best = -1, best_score = INT_MIN;
+    const int *p;
+
+    if (!formats)
+        return in;
+    for (p = formats; *p != AV_SAMPLE_FMT_NONE; p++) {
+        if (*p == in)
+            return in;
+    }
+    // same rules as swap_sample_fmts() in libavfilter
+    for (p = formats; *p != AV_SAMPLE_FMT_NONE; p++) {
+        int out_bps = av_get_bytes_per_sample(*p);
+        int score;
+
+        if (av_get_packed_sample_fmt(*p) == in || av_get_planar_sample_fmt(*p) == in)
+            return *p;
+        if (bps == 4 && out_bps == 8)
+            return *p;
+        score = -abs(out_bps - bps);
+        if (out_bps >= bps)
+            score += INT_MAX / 2;
+        if (score > best_score) {
+            best_score = score;
+            best = *p;
+        }
+    }
+    return best < 0 ? in : best;
+}
+
+int audio_convert_pick_rate(const int *rates, int in)
+{
+    int best = 0;
+    const int *p;
+
+    if (!rates)
+        return in;
+    for (p = rates; *p; p++) {
+        if (!best || abs(*p - in) < abs(best - in))
+            best = *p;
+    }
+    return best ? best : in;
+}
+
+#define CH_CENTER_PAIR (AV_CH_FRONT_LEFT_OF_CENTER | AV_CH_FRONT_RIGHT_OF_CENTER)
+#define CH_FRONT_PAIR  (AV_CH_FRONT_LEFT           | AV_CH_FRONT_RIGHT)
+#define CH_WIDE_PAIR   (AV_CH_WIDE_LEFT            | AV_CH_WIDE_RIGHT)
+#define CH_SIDE_PAIR   (AV_CH_SIDE_LEFT            | AV_CH_SIDE_RIGHT)
+#define CH_DIRECT_PAIR (AV_CH_SURROUND_DIRECT_LEFT | AV_CH_SURROUND_DIRECT_RIGHT)
+#define CH_BACK_PAIR   (AV_CH_BACK_LEFT            | AV_CH_BACK_RIGHT)
+
+/* channels that may stand in for each other, from libavfilter/formats.c */
+static const uint64_t ch_subst[][2] = {
+    { CH_FRONT_PAIR,      CH_CENTER_PAIR     },
+    { CH_FRONT_PAIR,      CH_WIDE_PAIR       },
+    { CH_FRONT_PAIR,      AV_CH_FRONT_CENTER },
+    { CH_CENTER_PAIR,     CH_FRONT_PAIR      },
+    { CH_CENTER_PAIR,     CH_WIDE_PAIR       },
+    { CH_CENTER_PAIR,     AV_CH_FRONT_CENTER },
+    { CH_WIDE_PAIR,       CH_FRONT_PAIR      },
+    { CH_WIDE_PAIR,       CH_CENTER_PAIR     },
+    { CH_WIDE_PAIR,       AV_CH_FRONT_CENTER },
+    { AV_CH_FRONT_CENTER, CH_FRONT_PAIR      },
+    { AV_CH_FRONT_CENTER, CH_CENTER_PAIR     },
+    { AV_CH_FRONT_CENTER, CH_WIDE_PAIR       },
+    { CH_SIDE_PAIR,       CH_DIRECT_PAIR     },
+    { CH_SIDE_PAIR,       CH_BACK_PAIR       },
+    { CH_SIDE_PAIR,       AV_CH_BACK_CENTER  },
+    { CH_BACK_PAIR,       CH_DIRECT_PAIR     },
+    { CH_BACK_PAIR,       CH_SIDE_PAIR       },
+    { CH_BACK_PAIR,       AV_CH_BACK_CENTER  },
+    { AV_CH_BACK_CENTER,  CH_BACK_PAIR       },
+    { AV_CH_BACK_CENTER,  CH_DIRECT_PAIR     },
+    { AV_CH_BACK_CENTER,  CH_SIDE_PAIR       },
+};
+
+uint64_t audio_convert_pick_layout(const uint64_t *layouts, uint64_t in)
+{
+    int in_channels = av_get_channel_layout_nb_channels(in);
+    int best_score = INT_MIN, best_count_diff = INT_MAX;
+    uint64_t best = 0;
+    const uint64_t *p;
+    int k;
+
+    if (!layouts || !layouts[0])
+        return in;
+    // same scoring as swap_channel_layouts() in libavfilter, both sides are real layouts here
+    for (p = layouts; *p; p++) {
+        uint64_t in_layout = in, out_layout = *p;
+        int count_diff = av_get_channel_layout_nb_channels(out_layout) - in_channels;
+        int score = 100000;
+
+        for (k = 0; k < FF_ARRAY_ELEMS(ch_subst); k++) {
+            uint64_t cmp0 = ch_subst[k][0];
+            uint64_t cmp1 = ch_subst[k][1];
+            if ((in_layout & cmp0) && !(out_layout & cmp0) &&
+                (out_layout & cmp1) && !(in_layout & cmp1)) {
+                in_layout  &= ~cmp0;
+                out_layout &= ~cmp1;
+                score += 10 * av_get_channel_layout_nb_channels(cmp1) - 2;
+            }
+        }
+        if ((in_layout & AV_CH_LOW_FREQUENCY) && (out_layout & AV_CH_LOW_FREQUENCY))
+            score += 10;
+        in_layout  &= ~AV_CH_LOW_FREQUENCY;
+        out_layout &= ~AV_CH_LOW_FREQUENCY;
+        score += 10 * av_get_channel_layout_nb_channels(in_layout & out_layout) -
+                  5 * av_get_channel_layout_nb_channels(out_layout & ~in_layout);
+
+        if (score > best_score || (count_diff < best_count_diff && score == best_score)) {
+            best_score      = score;
+            best_count_diff = count_diff;
+            best            = *p;
+        }
+    }
+    return best;
+}
+
+int audio_convert_alloc(AudioConvert **pc, int format, int rate, uint64_t layout, AVDictionary *swr_opts)
+{
+    AudioConvert *c;
+
+    *pc = NULL;
+    if (!(c = av_mallocz(sizeof(*c))))
+        return AVERROR(ENOMEM);
+    c->in_format    = AV_SAMPLE_FMT_NONE;
+    c->out_format   = format;
+    c->out_rate     = rate;
+    c->out_layout   = layout;
+    c->out_channels = av_get_channel_layout_nb_channels(layout);
+    if (av_dict_copy(&c->swr_opts, swr_opts, 0) < 0 ||
+        !(c->fifo = av_audio_fifo_alloc(format, c->out_channels, 1024)) ||
+        !(c->marks = av_fifo_alloc(8 * sizeof(PtsMark)))) {
+        audio_convert_free(&c);
+        return AVERROR(ENOMEM);
+    }
+    *pc = c;
+    return 0;
+}
+
+int audio_convert_set_frame_size(AudioConvert *c, int frame_size)
+{
+    c->frame_size = frame_size;
+    // one frame being filled while one is handed out, so writes rarely have to grow it
+    if (frame_size && av_audio_fifo_space(c->fifo) + av_audio_fifo_size(c->fifo) < 2 * frame_size)
+        return av_audio_fifo_realloc(c->fifo, 2 * frame_size);
+    return 0;
+}
+
+static int queue_samples(AudioConvert *c, uint8_t **data, int nb_samples, int64_t pts)
+{
+    int ret;
+
+    if (!nb_samples)
+        return 0;
+    if (pts != AV_NOPTS_VALUE) {
+        PtsMark m = { c->queued, pts };
+        if (av_fifo_space(c->marks) < sizeof(m) && (ret = av_fifo_grow(c->marks, sizeof(m))) < 0)
+            return ret;
+        av_fifo_generic_write(c->marks, &m, sizeof(m), NULL);
+    }
+    ret = av_audio_fifo_write(c->fifo, (void **)data, nb_samples);
+    if (ret < 0)
+        return ret;
+    c->queued += nb_samples;
+    return 0;
+}
+
+/*
+ * like ff_inlink_consume_samples(): a frame takes the timestamp of the chunk its first sample
+ * came in with, plus the samples of that chunk already handed out. so gaps in the input
+ * timestamps show up at the next frame, samples without one run on from the last frame.
+ */
+static int64_t next_pts(AudioConvert *c)
+{
+    PtsMark m, next;
+
+    while (av_fifo_size(c->marks) >= 2 * sizeof(m)) {
+        av_fifo_generic_peek_at(c->marks, &next, sizeof(m), sizeof(next), NULL);
+        if (next.pos > c->read)
+            break;
+        av_fifo_drain(c->marks, sizeof(m));
+    }
+    if (av_fifo_size(c->marks) >= sizeof(m)) {
+        av_fifo_generic_peek(c->marks, &m, sizeof(m), NULL);
+        if (m.pos <= c->read)
+            return m.pts + c->read - m.pos;
+    }
+    return c->pts;
+}
+
+static int convert(AudioConvert *c, const uint8_t **in, int nb_in, int64_t pts)
+{
+    int nb = swr_get_out_samples(c->swr, nb_in);
+
+    if (nb <= 0)
+        return nb;
+    if (nb > c->buf_samples) {
+        if (c->buf)
+            av_freep(&c->buf[0]);
+        av_freep(&c->buf);
+        c->buf_samples = 0;
+        if (av_samples_alloc_array_and_samples(&c->buf, NULL, c->out_channels, nb, c->out_format, 0) < 0)
+            return AVERROR(ENOMEM);
+        c->buf_samples = nb;
+    }
+    // what swr still holds comes out first
+    if (pts != AV_NOPTS_VALUE)
+        pts -= swr_get_delay(c->swr, c->out_rate);
+    nb = swr_convert(c->swr, c->buf, nb, in, nb_in);
+    if (nb < 0)
+        return nb;
+    return queue_samples(c, c->buf, nb, pts);
+}
+
+static int init_swr(AudioConvert *c)
+{
+    AVDictionary *opts = NULL;
+    int ret;
+
+    swr_free(&c->swr);
+    if (c->in_format == c->out_format && c->in_rate == c->out_rate && c->in_layout == c->out_layout)
+        return 0;
+
+    c->swr = swr_alloc_set_opts(NULL, c->out_layout, c->out_format, c->out_rate,
+                                c->in_layout, c->in_format, c->in_rate, 0, NULL);
+    if (!c->swr)
+        return AVERROR(ENOMEM);
+    if ((ret = av_dict_copy(&opts, c->swr_opts, 0)) < 0 ||
+        (ret = av_opt_set_dict(c->swr, &opts)) < 0 ||
+        (ret = swr_init(c->swr)) < 0) {
+        av_dict_free(&opts);
+        swr_free(&c->swr);
+        return ret;
+    }
+    av_dict_free(&opts);
+    return 0;
+}
+
+int audio_convert_send(AudioConvert *c, const AVFrame *frame)
+{
+    uint64_t layout;
+    int64_t pts = AV_NOPTS_VALUE;
+    int ret;
+
+    if (!frame)
+        return c->swr ? convert(c, NULL, 0, AV_NOPTS_VALUE) : 0;
+
+    layout = frame->channel_layout ? frame->channel_layout :
+             av_get_default_channel_layout(frame->channels);
+    if (frame->format != c->in_format || frame->sample_rate != c->in_rate || layout != c->in_layout) {
+        // parameters changed mid stream, the old context is drained before it goes
+        if (c->swr && (ret = convert(c, NULL, 0, AV_NOPTS_VALUE)) < 0)
+            return ret;
+        c->in_format = frame->format;
+        c->in_rate   = frame->sample_rate;
+        c->in_layout = layout;
+        if ((ret = init_swr(c)) < 0)
+            return ret;
+    }
+
+    if (frame->pts != AV_NOPTS_VALUE)
+        pts = av_rescale(frame->pts, c->out_rate, c->in_rate);
+    if (!c->swr)
+        return queue_samples(c, frame->extended_data, frame->nb_samples, pts);
+    return convert(c, (const uint8_t **)frame->extended_data, frame->nb_samples, pts);
+}
+
+int audio_convert_receive(AudioConvert *c, AVFrame *frame, int eof)
+{
+    int size = av_audio_fifo_size(c->fifo);
+    int nb = c->frame_size ? c->frame_size : size;
+    int ret;
+
+    if (!size)
+        return eof ? AVERROR_EOF : AVERROR(EAGAIN);
+    if (size < nb) {
+        if (!eof)
+            return AVERROR(EAGAIN);
+        nb = size;
+    }
+
+    frame->format         = c->out_format;
+    frame->sample_rate    = c->out_rate;
+    frame->channel_layout = c->out_layout;
+    frame->channels       = c->out_channels;
+    frame->nb_samples     = nb;
+    if ((ret = av_frame_get_buffer(frame, 0)) < 0)
+        return ret;
+    if ((ret = av_audio_fifo_read(c->fifo, (void **)frame->extended_data, nb)) < 0) {
+        av_frame_unref(frame);
+        return ret;
+    }
+    frame->pts = next_pts(c);
+    c->pts   = frame->pts + nb;
+    c->read += nb;
+    return 0;
+}
+
+void audio_convert_free(AudioConvert **pc)
+{
+    AudioConvert *c = *pc;
+
+    if (!c)
+        return;
+    swr_free(&c->swr);
+    av_dict_free(&c->swr_opts);
+    if (c->fifo)
+        av_audio_fifo_free(c->fifo);
+    av_fifo_freep(&c->marks);
+    if (c->buf)
+        av_freep(&c->buf[0]);
+    av_freep(&c->buf);
+    av_freep(pc);
+}
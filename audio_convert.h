@@ -0,0 +1,62 @@
+//
+// Created by hexiufeng on 2026/10/19.
+//
+
+#ifndef RUN_FFMPEG_AUDIO_CONVERT_H
+#define RUN_FFMPEG_AUDIO_CONVERT_H
+
+#include <stdint.h>
+#include <libavutil/audio_fifo.h>
+#include <libavutil/dict.h>
+#include <libavutil/fifo.h>
+#include <libavutil/frame.h>
+#include <libswresample/swresample.h>
+
+/*
+ * decoded audio to encoder frames without lavfi, for jobs that only need a sample format,
+ * rate or channel layout conversion. frames go through one SwrContext (none when the input
+ * already has the output format) into a fifo that hands out frame_size samples at a time,
+ * what abuffersink does for the encoder in a filtergraph. timestamps are in 1/out_rate, every
+ * frame takes the one of the input frame its first sample came from, as lavfi does, so gaps
+ * in the input are kept.
+ */
+typedef struct AudioConvert {
+    struct SwrContext *swr;
+    AVDictionary *swr_opts;
+    AVAudioFifo *fifo;
+    AVFifoBuffer *marks;        // PtsMark of every queued chunk that had a timestamp
+    int64_t queued;             // samples ever written to the fifo
+    int64_t read;               // samples ever read from it
+    uint8_t **buf;              // swr output before it is queued
+    int buf_samples;
+
+    int in_format;
+    int in_rate;
+    uint64_t in_layout;
+
+    int out_format;
+    int out_rate;
+    uint64_t out_layout;
+    int out_channels;
+
+    int frame_size;             // samples per frame given to the encoder, 0 for all that is queued
+    int64_t pts;                // of the next sample when no chunk timestamp covers it
+} AudioConvert;
+
+/* the format lavfi negotiation would pick from an encoder list (-1/0 terminated) for the input */
+int audio_convert_pick_format(const int *formats, int in);
+int audio_convert_pick_rate(const int *rates, int in);
+uint64_t audio_convert_pick_layout(const uint64_t *layouts, uint64_t in);
+
+int audio_convert_alloc(AudioConvert **c, int format, int rate, uint64_t layout, AVDictionary *swr_opts);
+int audio_convert_set_frame_size(AudioConvert *c, int frame_size);
+/* queues the samples of frame, NULL drains the resampler */
+int audio_convert_send(AudioConvert *c, const AVFrame *frame);
+/*
+ * a frame of frame_size samples, AVERROR(EAGAIN) while fewer are queued. with eof set the rest
+ * comes out as a shorter frame, then AVERROR_EOF.
+ */
+int audio_convert_receive(AudioConvert *c, AVFrame *frame, int eof);
+void audio_convert_free(AudioConvert **c);
+
+#endif //RUN_FFMPEG_AUDIO_CONVERT_H
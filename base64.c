@@ -206,4 +206,221 @@ int Base64encode(char *encoded, const char *string, int len)
 
     *p++ = '\0';
     return p - encoded;
-}
\ No newline at end of file
+}
+
+/*
+ * block kernels used by the streaming base64 handles (mem_io.c). they work on
+ * whole groups (3 bytes <-> 4 chars) without padding, the callers deal with the tail.
+ */
+
+#include "config.h"
+#include <libavutil/cpu.h>
+#if ARCH_X86_64 && HAVE_SSSE3_INLINE && defined(__GNUC__)
+#include <tmmintrin.h>
+#define BASE64_SSSE3 1
+#endif
+#if ARCH_AARCH64 && HAVE_INTRINSICS_NEON
+#include <arm_neon.h>
+#define BASE64_NEON 1
+#endif
+
+static void encode_groups_c(char *dst, const uint8_t *src, size_t nb_groups)
+{
+    size_t i;
+
+    for (i = 0; i < nb_groups; i++, src += 3, dst += 4) {
+        dst[0] = basis_64[src[0] >> 2];
+        dst[1] = basis_64[((src[0] & 0x3) << 4) | (src[1] >> 4)];
+        dst[2] = basis_64[((src[1] & 0xF) << 2) | (src[2] >> 6)];
+        dst[3] = basis_64[src[2] & 0x3F];
+    }
+}
+
+static int decode_groups_c(uint8_t *dst, const char *src, size_t nb_groups)
+{
+    const unsigned char *in = (const unsigned char *)src;
+    size_t i;
+
+    for (i = 0; i < nb_groups; i++, in += 4, dst += 3) {
+        unsigned a = pr2six[in[0]], b = pr2six[in[1]], c = pr2six[in[2]], d = pr2six[in[3]];
+        if ((a | b | c | d) > 63)
+            return -1;
+        dst[0] = (uint8_t)(a << 2 | b >> 4);
+        dst[1] = (uint8_t)(b << 4 | c >> 2);
+        dst[2] = (uint8_t)(c << 6 | d);
+    }
+    return 0;
+}
+
+#if BASE64_SSSE3
+/* 12 bytes -> 16 chars per step, the load reads 4 bytes ahead */
+__attribute__((target("ssse3")))
+static size_t encode_groups_ssse3(char *dst, const uint8_t *src, size_t nb_groups)
+{
+    const __m128i shuf      = _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1);
+    const __m128i shift_lut = _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                            '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+                                            '/' - 63, 'A', 0, 0);
+    size_t done = 0;
+
+    while (nb_groups - done >= 6) {
+        __m128i in  = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(src + done * 3)), shuf);
+        __m128i t0  = _mm_mulhi_epu16(_mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00)), _mm_set1_epi32(0x04000040));
+        __m128i t1  = _mm_mullo_epi16(_mm_and_si128(in, _mm_set1_epi32(0x003f03f0)), _mm_set1_epi32(0x01000010));
+        __m128i idx = _mm_or_si128(t0, t1);
+        __m128i res = _mm_subs_epu8(idx, _mm_set1_epi8(51));
+        __m128i lt  = _mm_cmpgt_epi8(_mm_set1_epi8(26), idx);
+
+        res = _mm_or_si128(res, _mm_and_si128(lt, _mm_set1_epi8(13)));
+        res = _mm_add_epi8(_mm_shuffle_epi8(shift_lut, res), idx);
+        _mm_storeu_si128((__m128i *)(dst + done * 4), res);
+        done += 4;
+    }
+    return done;
+}
+
+static inline __m128i in_range(__m128i in, char lo, char hi)
+{
+    return _mm_and_si128(_mm_cmpgt_epi8(in, _mm_set1_epi8(lo - 1)),
+                         _mm_cmplt_epi8(in, _mm_set1_epi8(hi + 1)));
+}
+
+/* 16 chars -> 12 bytes per step, the store writes 4 bytes ahead, so 6 groups must be left */
+__attribute__((target("ssse3")))
+static size_t decode_groups_ssse3(uint8_t *dst, const char *src, size_t nb_groups)
+{
+    const __m128i pack = _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+    size_t done = 0;
+
+    while (nb_groups - done >= 6) {
+        __m128i in    = _mm_loadu_si128((const __m128i *)(src + done * 4));
+        __m128i upper = in_range(in, 'A', 'Z');
+        __m128i lower = in_range(in, 'a', 'z');
+        __m128i digit = in_range(in, '0', '9');
+        __m128i plus  = _mm_cmpeq_epi8(in, _mm_set1_epi8('+'));
+        __m128i slash = _mm_cmpeq_epi8(in, _mm_set1_epi8('/'));
+        __m128i valid = _mm_or_si128(_mm_or_si128(upper, lower), _mm_or_si128(_mm_or_si128(digit, plus), slash));
+        __m128i shift, out;
+
+        if (_mm_movemask_epi8(valid) != 0xFFFF)
+            break;
+        shift = _mm_or_si128(_mm_or_si128(_mm_and_si128(upper, _mm_set1_epi8(-65)),
+                                          _mm_and_si128(lower, _mm_set1_epi8(-71))),
+                             _mm_or_si128(_mm_and_si128(digit, _mm_set1_epi8(4)),
+                                          _mm_or_si128(_mm_and_si128(plus, _mm_set1_epi8(19)),
+                                                       _mm_and_si128(slash, _mm_set1_epi8(16)))));
+        in  = _mm_add_epi8(in, shift);
+        out = _mm_maddubs_epi16(in, _mm_set1_epi32(0x01400140));
+        out = _mm_madd_epi16(out, _mm_set1_epi32(0x00011000));
+        _mm_storeu_si128((__m128i *)(dst + done * 3), _mm_shuffle_epi8(out, pack));
+        done += 4;
+    }
+    return done;
+}
+#endif
+
+#if BASE64_NEON
+static inline uint8x16_t in_range_neon(uint8x16_t in, uint8_t lo, uint8_t hi)
+{
+    return vandq_u8(vcgeq_u8(in, vdupq_n_u8(lo)), vcleq_u8(in, vdupq_n_u8(hi)));
+}
+
+static inline uint8x16_t decode_neon(uint8x16_t in, uint8x16_t *invalid)
+{
+    uint8x16_t upper = in_range_neon(in, 'A', 'Z');
+    uint8x16_t lower = in_range_neon(in, 'a', 'z');
+    uint8x16_t digit = in_range_neon(in, '0', '9');
+    uint8x16_t plus  = vceqq_u8(in, vdupq_n_u8('+'));
+    uint8x16_t slash = vceqq_u8(in, vdupq_n_u8('/'));
+    uint8x16_t valid = vorrq_u8(vorrq_u8(upper, lower), vorrq_u8(vorrq_u8(digit, plus), slash));
+    uint8x16_t shift = vorrq_u8(vorrq_u8(vandq_u8(upper, vdupq_n_u8((uint8_t)-65)),
+                                         vandq_u8(lower, vdupq_n_u8((uint8_t)-71))),
+                                vorrq_u8(vandq_u8(digit, vdupq_n_u8(4)),
+                                         vorrq_u8(vandq_u8(plus, vdupq_n_u8(19)),
+                                                  vandq_u8(slash, vdupq_n_u8(16)))));
+
+    *invalid = vorrq_u8(*invalid, vmvnq_u8(valid));
+    return vaddq_u8(in, shift);
+}
+
+/* 48 bytes -> 64 chars per step */
+static size_t encode_groups_neon(char *dst, const uint8_t *src, size_t nb_groups)
+{
+    uint8x16x4_t lut;
+    size_t done = 0;
+
+    lut.val[0] = vld1q_u8((const uint8_t *)basis_64);
+    lut.val[1] = vld1q_u8((const uint8_t *)basis_64 + 16);
+    lut.val[2] = vld1q_u8((const uint8_t *)basis_64 + 32);
+    lut.val[3] = vld1q_u8((const uint8_t *)basis_64 + 48);
+
+    while (nb_groups - done >= 16) {
+        uint8x16x3_t in = vld3q_u8(src + done * 3);
+        uint8x16x4_t out;
+
+        out.val[0] = vshrq_n_u8(in.val[0], 2);
+        out.val[1] = vandq_u8(vorrq_u8(vshlq_n_u8(in.val[0], 4), vshrq_n_u8(in.val[1], 4)), vdupq_n_u8(0x3F));
+        out.val[2] = vandq_u8(vorrq_u8(vshlq_n_u8(in.val[1], 2), vshrq_n_u8(in.val[2], 6)), vdupq_n_u8(0x3F));
+        out.val[3] = vandq_u8(in.val[2], vdupq_n_u8(0x3F));
+        out.val[0] = vqtbl4q_u8(lut, out.val[0]);
+        out.val[1] = vqtbl4q_u8(lut, out.val[1]);
+        out.val[2] = vqtbl4q_u8(lut, out.val[2]);
+        out.val[3] = vqtbl4q_u8(lut, out.val[3]);
+        vst4q_u8((uint8_t *)dst + done * 4, out);
+        done += 16;
+    }
+    return done;
+}
+
+/* 64 chars -> 48 bytes per step */
+static size_t decode_groups_neon(uint8_t *dst, const char *src, size_t nb_groups)
+{
+    size_t done = 0;
+
+    while (nb_groups - done >= 16) {
+        uint8x16x4_t in = vld4q_u8((const uint8_t *)src + done * 4);
+        uint8x16_t invalid = vdupq_n_u8(0);
+        uint8x16x3_t out;
+        uint8x16_t a = decode_neon(in.val[0], &invalid);
+        uint8x16_t b = decode_neon(in.val[1], &invalid);
+        uint8x16_t c = decode_neon(in.val[2], &invalid);
+        uint8x16_t d = decode_neon(in.val[3], &invalid);
+
+        if (vmaxvq_u8(invalid))
+            break;
+        out.val[0] = vorrq_u8(vshlq_n_u8(a, 2), vshrq_n_u8(b, 4));
+        out.val[1] = vorrq_u8(vshlq_n_u8(b, 4), vshrq_n_u8(c, 2));
+        out.val[2] = vorrq_u8(vshlq_n_u8(c, 6), d);
+        vst3q_u8(dst + done * 3, out);
+        done += 16;
+    }
+    return done;
+}
+#endif
+
+void base64_encode_groups(char *dst, const uint8_t *src, size_t nb_groups)
+{
+    size_t done = 0;
+
+#if BASE64_SSSE3
+    if (av_get_cpu_flags() & AV_CPU_FLAG_SSSE3)
+        done = encode_groups_ssse3(dst, src, nb_groups);
+#elif BASE64_NEON
+    done = encode_groups_neon(dst, src, nb_groups);
+#endif
+    encode_groups_c(dst + done * 4, src + done * 3, nb_groups - done);
+}
+
+int base64_decode_groups(uint8_t *dst, const char *src, size_t nb_groups)
+{
+    size_t done = 0;
+
+#if BASE64_SSSE3
+    if (av_get_cpu_flags() & AV_CPU_FLAG_SSSE3)
+        done = decode_groups_ssse3(dst, src, nb_groups);
+#elif BASE64_NEON
+    done = decode_groups_neon(dst, src, nb_groups);
+#endif
+    /* the vector loops stop early on an invalid char, the scalar loop reports it */
+    return decode_groups_c(dst + done * 3, src + done * 4, nb_groups - done);
+}
@@ -84,6 +84,8 @@
 #ifndef _BASE64_H_
 #define _BASE64_H_
 
+#include <stddef.h>
+#include <stdint.h>
 
 int Base64encode_len(int len);
 int Base64encode(char * coded_dst, const char *plain_src,int len_plain_src);
@@ -91,6 +93,10 @@ int Base64encode(char * coded_dst, const char *plain_src,int len_plain_src);
 int Base64decode_len(const char * coded_src);
 int Base64decode(char * plain_dst, const char *coded_src);
 
+/* whole groups only, no padding. decode returns -1 on a char outside the alphabet */
+void base64_encode_groups(char *dst, const uint8_t *src, size_t nb_groups);
+int base64_decode_groups(uint8_t *dst, const char *src, size_t nb_groups);
+
 
 
 #endif //_BASE64_H_
\ No newline at end of file
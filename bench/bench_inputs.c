@@ -0,0 +1,164 @@
+//
+// Created by hexiufeng on 2026/10/19.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "bench_inputs.h"
+#include "run_ffmpeg.h"
+
+/*
+ * what the services mostly run: remux, audio transcode (with and without lavfi, from a file and
+ * from a filemem: buffer), video transcode, a filtered A/V transcode, two inputs mixed with
+ * -filter_complex and one input encoded to a ladder of sizes. outputs go to the null muxer so the
+ * disk doesn't bound the numbers.
+ */
+const BenchShape bench_shapes[] = {
+    { "remux",  "ffmpeg -i %s/av.mp4 -c copy -f null -" },
+    { "audio",  "ffmpeg -i %s/tone.wav -c:a aac -b:a 128k -f null -" },
+    { "audio_fast", "ffmpeg -audio_fast_path -i %s/tone.wav -c:a aac -b:a 128k -f null -" },
+    { "audio_mem", "ffmpeg -i filemem:%%lld -c:a aac -b:a 128k -f null -", "tone.wav" },
+    { "video",  "ffmpeg -i %s/av.mp4 -an -c:v mpeg4 -q:v 5 -f null -" },
+    { "filter", "ffmpeg -i %s/av.mp4 -vf scale=320:180,fps=15 -c:v mpeg4 -c:a aac -f null -" },
+    { "mix",    "ffmpeg -i %s/av.mp4 -i %s/tone.wav -filter_complex [0:a][1:a]amix=inputs=2:duration=first[a] "
+                "-map 0:v -map [a] -c:v mpeg4 -c:a aac -f null -" },
+    { "ladder", "ffmpeg -i %s/av.mp4 -map 0:v -vf scale=640:360 -c:v mpeg4 -q:v 4 -f null - "
+                "-map 0:v -vf scale=426:240 -c:v mpeg4 -q:v 5 -f null - "
+                "-map 0:v -vf scale=256:144 -c:v mpeg4 -q:v 6 -f null -" },
+};
+const int nb_bench_shapes = sizeof(bench_shapes) / sizeof(bench_shapes[0]);
+
+static const char *input_cmds[][2] = {
+    { "tone.wav", "ffmpeg -y -f lavfi -i sine=frequency=440:sample_rate=48000:duration=10 "
+                  "-ac 2 -c:a pcm_s16le %s/tone.wav" },
+    { "av.mp4",   "ffmpeg -y -f lavfi -i testsrc=size=640x360:rate=25:duration=4 "
+                  "-f lavfi -i sine=frequency=1000:sample_rate=48000:duration=4 "
+                  "-c:v mpeg4 -q:v 4 -g 25 -c:a aac -b:a 96k %s/av.mp4" },
+};
+
+/* the mem_input files of the shapes, read once by bench_make_inputs and only read by the jobs */
+static struct {
+    const char *name;
+    char *data;
+    int64_t len;
+} mem_inputs[4];
+static int nb_mem_inputs;
+
+static char *fill_dir(const char *fmt, const char *dir)
+{
+    size_t len = strlen(fmt) + 4 * strlen(dir) + 1;
+    char *cmd = malloc(len);
+
+    if (cmd)
+        snprintf(cmd, len, fmt, dir, dir, dir, dir);
+    return cmd;
+}
+
+static int load_mem_inputs(const char *dir)
+{
+    char path[1024];
+    int i, j;
+
+    for (i = 0; i < nb_bench_shapes; i++) {
+        const char *name = bench_shapes[i].mem_input;
+        FILE *f;
+        long len;
+
+        if (!name)
+            continue;
+        for (j = 0; j < nb_mem_inputs && strcmp(mem_inputs[j].name, name); j++)
+            ;
+        if (j < nb_mem_inputs)
+            continue;
+        if (nb_mem_inputs == sizeof(mem_inputs) / sizeof(mem_inputs[0]))
+            return -1;
+        snprintf(path, sizeof(path), "%s/%s", dir, name);
+        if (!(f = fopen(path, "rb")))
+            return -1;
+        fseek(f, 0, SEEK_END);
+        len = ftell(f);
+        fseek(f, 0, SEEK_SET);
+        mem_inputs[j].data = len > 0 ? malloc(len) : NULL;
+        if (!mem_inputs[j].data || fread(mem_inputs[j].data, 1, len, f) != (size_t)len) {
+            fprintf(stderr, "could not read %s into memory\n", path);
+            free(mem_inputs[j].data);
+            fclose(f);
+            return -1;
+        }
+        fclose(f);
+        mem_inputs[j].name = name;
+        mem_inputs[j].len  = len;
+        nb_mem_inputs++;
+    }
+    return 0;
+}
+
+int bench_make_inputs(const char *dir)
+{
+    char path[1024];
+    struct stat st;
+    int i;
+
+    mkdir(dir, 0755);
+    for (i = 0; i < sizeof(input_cmds) / sizeof(input_cmds[0]); i++) {
+        char *cmd;
+
+        snprintf(path, sizeof(path), "%s/%s", dir, input_cmds[i][0]);
+        if (!stat(path, &st) && st.st_size > 0)
+            continue;
+        if (!(cmd = fill_dir(input_cmds[i][1], dir)))
+            return -1;
+        run_ffmpeg_cmd("bench-input", cmd);
+        free(cmd);
+        if (stat(path, &st) || !st.st_size) {
+            fprintf(stderr, "could not generate %s, is lavfi available?\n", path);
+            return -1;
+        }
+    }
+    return load_mem_inputs(dir);
+}
+
+char *bench_shape_cmd(const BenchShape *shape, const char *dir)
+{
+    return fill_dir(shape->cmd, dir);
+}
+
+const BenchShape *bench_find_shape(const char *name)
+{
+    int i;
+
+    for (i = 0; i < nb_bench_shapes; i++) {
+        if (!strcmp(bench_shapes[i].name, name))
+            return &bench_shapes[i];
+    }
+    return NULL;
+}
+
+char *bench_job_cmd(const BenchShape *shape, const char *cmd, int64_t *handle)
+{
+    size_t len;
+    char *job_cmd;
+    int i;
+
+    *handle = 0;
+    if (!shape->mem_input)
+        return strdup(cmd);
+    for (i = 0; i < nb_mem_inputs && strcmp(mem_inputs[i].name, shape->mem_input); i++)
+        ;
+    if (i == nb_mem_inputs)
+        return NULL;
+    len = strlen(cmd) + 24;
+    if (!(job_cmd = malloc(len)))
+        return NULL;
+    // a handle per job like the services create per request, the buffer itself is shared and not copied
+    *handle = new_input_mem(mem_inputs[i].data, mem_inputs[i].len, 0);
+    snprintf(job_cmd, len, cmd, (long long)*handle);
+    return job_cmd;
+}
+
+void bench_job_done(int64_t handle)
+{
+    free_mem(handle, 0);
+}
@@ -0,0 +1,36 @@
+//
+// Created by hexiufeng on 2026/10/19.
+//
+
+#ifndef RUN_FFMPEG_BENCH_INPUTS_H
+#define RUN_FFMPEG_BENCH_INPUTS_H
+
+#include <stdint.h>
+
+/* a command shape run by the bench and the stress tool, %s is the input directory */
+typedef struct BenchShape {
+    const char *name;
+    const char *cmd;
+    /* when set, this file of the input directory is read into memory once and every job reads it
+     * through its own filemem: handle. cmd then writes the url as filemem:%%lld, which
+     * bench_shape_cmd turns into the %lld that bench_job_cmd fills in */
+    const char *mem_input;
+} BenchShape;
+
+extern const BenchShape bench_shapes[];
+extern const int nb_bench_shapes;
+
+/* generate the synthetic inputs with lavfi into dir, returns < 0 when one could not be made */
+int bench_make_inputs(const char *dir);
+/* the command of shape with the input directory filled in, the caller frees it */
+char *bench_shape_cmd(const BenchShape *shape, const char *dir);
+const BenchShape *bench_find_shape(const char *name);
+/*
+ * the command of one job from the output of bench_shape_cmd. for a shape with mem_input a new
+ * filemem: handle is put into *handle, to be released with bench_job_done after the job,
+ * otherwise *handle is 0. the caller frees the command
+ */
+char *bench_job_cmd(const BenchShape *shape, const char *cmd, int64_t *handle);
+void bench_job_done(int64_t handle);
+
+#endif //RUN_FFMPEG_BENCH_INPUTS_H
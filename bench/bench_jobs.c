@@ -0,0 +1,126 @@
+//
+// Created by hexiufeng on 2026/10/19.
+//
+
+/*
+ * throughput of run_ffmpeg_cmd: every command shape runs on 1, 2, 4 .. max threads,
+ * each thread running the same number of jobs back to back, and the JobStats of each
+ * round are printed as one row. compare the rows of two builds to spot regressions.
+ *
+ *   bench_jobs [-t max_threads] [-n jobs_per_thread] [-s shape] [-d input_dir]
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <libavutil/log.h>
+#include "bench_inputs.h"
+#include "run_ffmpeg.h"
+
+typedef struct BenchThread {
+    pthread_t tid;
+    int index;
+    int nb_jobs;
+    const char *cmd;
+    const BenchShape *shape;
+} BenchThread;
+
+static void *bench_thread(void *arg)
+{
+    BenchThread *t = arg;
+    char trace_id[64];
+    int i;
+
+    for (i = 0; i < t->nb_jobs; i++) {
+        int64_t handle;
+        char *cmd = bench_job_cmd(t->shape, t->cmd, &handle);
+
+        if (!cmd)
+            break;
+        snprintf(trace_id, sizeof(trace_id), "bench-%s-%d-%d", t->shape->name, t->index, i);
+        run_ffmpeg_cmd(trace_id, cmd);
+        bench_job_done(handle);
+        free(cmd);
+    }
+    return NULL;
+}
+
+static void run_round(const BenchShape *shape, const char *cmd, int nb_threads, int nb_jobs)
+{
+    BenchThread *threads = calloc(nb_threads, sizeof(*threads));
+    JobStats stats;
+    int i;
+
+    if (!threads)
+        return;
+    reset_job_stats();
+    for (i = 0; i < nb_threads; i++) {
+        threads[i].index   = i;
+        threads[i].nb_jobs = nb_jobs;
+        threads[i].cmd     = cmd;
+        threads[i].shape   = shape;
+        pthread_create(&threads[i].tid, NULL, bench_thread, &threads[i]);
+    }
+    for (i = 0; i < nb_threads; i++)
+        pthread_join(threads[i].tid, NULL);
+    free(threads);
+
+    get_job_stats(&stats);
+    printf("%-10s %7d %6llu %6llu %9.2f %9.1f %7lld %7lld %10lld\n", shape->name, nb_threads,
+           (unsigned long long)stats.nb_jobs, (unsigned long long)stats.nb_failed,
+           stats.jobs_per_sec, stats.realtime_factor, (long long)stats.p50_ms, (long long)stats.p99_ms,
+           (long long)stats.peak_rss_kb);
+    fflush(stdout);
+}
+
+int main(int argc, char **argv)
+{
+    const char *dir = "/tmp/run_ffmpeg_bench";
+    const char *only = NULL;
+    int max_threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    int nb_jobs = 20;
+    int opt, i, n;
+
+    while ((opt = getopt(argc, argv, "t:n:s:d:")) != -1) {
+        switch (opt) {
+        case 't': max_threads = atoi(optarg); break;
+        case 'n': nb_jobs = atoi(optarg); break;
+        case 's': only = optarg; break;
+        case 'd': dir = optarg; break;
+        default:
+            fprintf(stderr, "usage: %s [-t max_threads] [-n jobs_per_thread] [-s shape] [-d input_dir]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (max_threads < 1)
+        max_threads = 1;
+    if (only && !bench_find_shape(only)) {
+        fprintf(stderr, "unknown shape %s\n", only);
+        return 1;
+    }
+
+    init_ffmpeg();
+    av_log_set_level(AV_LOG_ERROR);
+    set_job_log_level(AV_LOG_ERROR);
+    if (bench_make_inputs(dir) < 0)
+        return 1;
+
+    printf("%-10s %7s %6s %6s %9s %9s %7s %7s %10s\n", "shape", "threads", "jobs", "failed",
+           "jobs/s", "realtime", "p50_ms", "p99_ms", "peak_rss_kb");
+    for (i = 0; i < nb_bench_shapes; i++) {
+        const BenchShape *shape = &bench_shapes[i];
+        char *cmd;
+
+        if (only && strcmp(only, shape->name))
+            continue;
+        if (!(cmd = bench_shape_cmd(shape, dir)))
+            return 1;
+        for (n = 1; n < max_threads; n *= 2)
+            run_round(shape, cmd, n, nb_jobs);
+        run_round(shape, cmd, max_threads, nb_jobs);
+        free(cmd);
+    }
+    return 0;
+}
@@ -0,0 +1,70 @@
+//
+// Created by hexiufeng on 2026/10/19.
+//
+
+/*
+ * palette expansion of sub2video bitmaps, the c and the simd version on rows of the usual
+ * subtitle widths, in megapixels per second.
+ *
+ *   bench_palette [-n rows]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <libavutil/time.h>
+#include "palette.h"
+
+#define MAX_WIDTH 1920
+
+static uint32_t pal[256];
+static uint8_t src[MAX_WIDTH];
+static uint32_t dst[MAX_WIDTH];
+
+static double run(palette_expand_fn expand, int w, int nb_rows)
+{
+    int64_t start = av_gettime_relative();
+    int64_t elapsed;
+    int i;
+
+    for (i = 0; i < nb_rows; i++) {
+        expand(dst, src, pal, w);
+        // keep the rows from being folded into one
+        src[i % w] ^= (uint8_t)dst[(i * 7) % w];
+    }
+    elapsed = av_gettime_relative() - start;
+    return elapsed > 0 ? (double)w * nb_rows / elapsed : 0;
+}
+
+int main(int argc, char **argv)
+{
+    static const int widths[] = { 7, 64, 333, 720, 1280, 1920 };
+    palette_expand_fn simd = palette_expand_simd();
+    int nb_rows = 200000;
+    int opt, i;
+
+    while ((opt = getopt(argc, argv, "n:")) != -1) {
+        switch (opt) {
+        case 'n': nb_rows = atoi(optarg); break;
+        default:
+            fprintf(stderr, "usage: %s [-n rows]\n", argv[0]);
+            return 1;
+        }
+    }
+    srand(1);
+    for (i = 0; i < 256; i++)
+        pal[i] = (uint32_t)rand();
+    for (i = 0; i < MAX_WIDTH; i++)
+        src[i] = (uint8_t)rand();
+
+    printf("%6s %10s %11s %7s\n", "width", "c_mpix/s", "simd_mpix/s", "speedup");
+    for (i = 0; i < sizeof(widths) / sizeof(widths[0]); i++) {
+        double c = run(palette_expand_c, widths[i], nb_rows);
+        double s = simd ? run(simd, widths[i], nb_rows) : 0;
+
+        printf("%6d %10.1f %11.1f %7.2f\n", widths[i], c, s, c > 0 && s > 0 ? s / c : 0);
+    }
+    if (!simd)
+        printf("no simd version on this build or cpu\n");
+    return 0;
+}
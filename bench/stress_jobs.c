@@ -0,0 +1,169 @@
+//
+// Created by hexiufeng on 2026/10/19.
+//
+
+/*
+ * long running leak hunt: threads run the command shapes of the bench and the failing ones
+ * below in turn until the total is reached, the error paths being where cleanup leaks.
+ * every -i jobs rss_kb of JobStats is sampled, the first sample is taken as the baseline
+ * once allocators and caches have warmed up, and the run fails when a later sample grew
+ * past -m kilobytes. build it with -DRUN_FFMPEG_SANITIZER=address or thread to check
+ * the cleanup paths at the same time.
+ *
+ *   stress_jobs [-t threads] [-j total_jobs] [-i sample_interval] [-m max_drift_kb] [-d input_dir]
+ */
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <libavutil/log.h>
+#include "bench_inputs.h"
+#include "run_ffmpeg.h"
+
+/* jobs that fail while parsing, opening or in the middle of the transcode */
+static const BenchShape failing_shapes[] = {
+    { "bad_option", "ffmpeg -i %s/tone.wav -no_such_option 1 -f null -" },
+    { "missing",    "ffmpeg -i %s/no_such_file.wav -f null -" },
+    { "truncated",  "ffmpeg -i %s/truncated.mp4 -c:v mpeg4 -c:a aac -f null -" },
+    { "unwritable", "ffmpeg -y -i %s/tone.wav -c:a pcm_s16le -f wav /dev/full" },
+    { "mem_limit",  "ffmpeg -job_mem_limit 65536 -i %s/av.mp4 -c:v mpeg4 -c:a aac -f null -" },
+};
+#define NB_FAILING_SHAPES (int)(sizeof(failing_shapes) / sizeof(failing_shapes[0]))
+
+static char *shape_cmds[32];
+static int nb_shape_cmds;
+static atomic_long nb_failing_jobs;
+static atomic_long next_job;
+static long total_jobs = 100000;
+static long sample_interval = 10000;
+
+static pthread_mutex_t sample_lock = PTHREAD_MUTEX_INITIALIZER;
+static int64_t baseline_kb = -1;
+static int64_t max_drift_kb = 64 * 1024;
+static int64_t worst_drift_kb;
+
+static void sample_rss(long nb_done)
+{
+    JobStats stats;
+    int64_t drift;
+
+    get_job_stats(&stats);
+    pthread_mutex_lock(&sample_lock);
+    if (baseline_kb < 0) {
+        baseline_kb = stats.rss_kb;
+        drift = 0;
+    } else {
+        drift = stats.rss_kb - baseline_kb;
+        if (drift > worst_drift_kb)
+            worst_drift_kb = drift;
+    }
+    printf("jobs %8ld failed %6llu (%ld meant to) running %3d jobs/s %8.2f rss_kb %8lld drift_kb %+8lld\n",
+           nb_done, (unsigned long long)stats.nb_failed, atomic_load(&nb_failing_jobs), stats.nb_running,
+           stats.jobs_per_sec,
+           (long long)stats.rss_kb, (long long)drift);
+    fflush(stdout);
+    pthread_mutex_unlock(&sample_lock);
+}
+
+static void *stress_thread(void *arg)
+{
+    char trace_id[64];
+    long job;
+
+    while ((job = atomic_fetch_add(&next_job, 1)) < total_jobs) {
+        int shape = (int)(job % nb_shape_cmds);
+        int64_t handle = 0;
+        char *cmd;
+
+        snprintf(trace_id, sizeof(trace_id), "stress-%ld", job);
+        if (shape >= nb_bench_shapes) {
+            atomic_fetch_add(&nb_failing_jobs, 1);
+            run_ffmpeg_cmd(trace_id, shape_cmds[shape]);
+        } else if ((cmd = bench_job_cmd(&bench_shapes[shape], shape_cmds[shape], &handle))) {
+            run_ffmpeg_cmd(trace_id, cmd);
+            bench_job_done(handle);
+            free(cmd);
+        }
+        // the job that completes an interval samples, rss then holds whatever is still running
+        if ((job + 1) % sample_interval == 0)
+            sample_rss(job + 1);
+    }
+    return NULL;
+}
+
+/* av.mp4 with the index up front, cut in half so demuxing fails part way */
+static int make_truncated_input(const char *dir)
+{
+    char cmd[2048], path[1024];
+    struct stat st;
+
+    snprintf(path, sizeof(path), "%s/truncated.mp4", dir);
+    if (!stat(path, &st) && st.st_size > 0)
+        return 0;
+    snprintf(cmd, sizeof(cmd), "ffmpeg -y -i %s/av.mp4 -c copy -movflags faststart %s", dir, path);
+    run_ffmpeg_cmd("stress-input", cmd);
+    if (stat(path, &st) || !st.st_size || truncate(path, st.st_size / 2) < 0) {
+        fprintf(stderr, "could not make %s\n", path);
+        return -1;
+    }
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    const char *dir = "/tmp/run_ffmpeg_bench";
+    int nb_threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    pthread_t *threads;
+    int opt, i;
+
+    while ((opt = getopt(argc, argv, "t:j:i:m:d:")) != -1) {
+        switch (opt) {
+        case 't': nb_threads = atoi(optarg); break;
+        case 'j': total_jobs = atol(optarg); break;
+        case 'i': sample_interval = atol(optarg); break;
+        case 'm': max_drift_kb = atoll(optarg); break;
+        case 'd': dir = optarg; break;
+        default:
+            fprintf(stderr, "usage: %s [-t threads] [-j total_jobs] [-i sample_interval] "
+                            "[-m max_drift_kb] [-d input_dir]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (nb_threads < 1)
+        nb_threads = 1;
+    if (sample_interval < 1)
+        sample_interval = 1;
+
+    init_ffmpeg();
+    av_log_set_level(AV_LOG_ERROR);
+    set_job_log_level(AV_LOG_ERROR);
+    if (bench_make_inputs(dir) < 0 || make_truncated_input(dir) < 0)
+        return 1;
+    for (i = 0; i < nb_bench_shapes + NB_FAILING_SHAPES; i++) {
+        const BenchShape *shape = i < nb_bench_shapes ? &bench_shapes[i] : &failing_shapes[i - nb_bench_shapes];
+        if (!(shape_cmds[nb_shape_cmds++] = bench_shape_cmd(shape, dir)))
+            return 1;
+    }
+
+    if (!(threads = calloc(nb_threads, sizeof(*threads))))
+        return 1;
+    for (i = 0; i < nb_threads; i++)
+        pthread_create(&threads[i], NULL, stress_thread, NULL);
+    for (i = 0; i < nb_threads; i++)
+        pthread_join(threads[i], NULL);
+    free(threads);
+    for (i = 0; i < nb_shape_cmds; i++)
+        free(shape_cmds[i]);
+
+    printf("rss baseline_kb %lld worst drift_kb %lld, limit %lld\n",
+           (long long)baseline_kb, (long long)worst_drift_kb, (long long)max_drift_kb);
+    if (worst_drift_kb > max_drift_kb) {
+        fprintf(stderr, "rss grew by %lld KB over %ld jobs, look for a leak\n",
+                (long long)worst_drift_kb, total_jobs);
+        return 1;
+    }
+    return 0;
+}
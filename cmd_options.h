@@ -16,6 +16,9 @@
 #include <libavutil/eval.h>
 #include <stdatomic.h>
 #include "config.h"
+#include "latency.h"
+#include "audio_convert.h"
+#include "download_pool.h"
 
 #define VSYNC_AUTO       -1
 #define VSYNC_PASSTHROUGH 0
@@ -185,6 +188,8 @@ typedef struct OutputStream {
     AVDictionary *swr_opts;
     AVDictionary *resample_opts;
     char *apad;
+    int audio_fast;              /* decoded frames skip the filtergraph, see audio_convert.h */
+    AudioConvert *audio_convert; /* created with the first frame */
     OSTFinished finished;        /* no more packets should be written for this stream */
     int unavailable;                     /* true if the steram is unavailable (possibly temporarily) */
     int stream_copy;
@@ -217,6 +222,9 @@ typedef struct OutputStream {
 
     int max_muxing_queue_size;
 
+    /* threads counted against the process-wide codec thread cap */
+    int pool_reserved_threads;
+
     /* the packets are buffered here until the muxer is ready to be initialized */
     AVFifoBuffer *muxing_queue;
 
@@ -229,6 +237,10 @@ typedef struct OutputStream {
     /* Threshold after which max_muxing_queue_size will be in effect */
     size_t muxing_queue_data_threshold;
 
+    /* high-water marks of the muxing queue, reported at the end of the job */
+    int muxing_queue_peak_packets;
+    size_t muxing_queue_peak_data_size;
+
     /* packet picture type */
     int pict_type;
 
@@ -236,6 +248,12 @@ typedef struct OutputStream {
     int64_t error[4];
 } OutputStream;
 
+#define SUB2VIDEO_MAX_DIRTY 8
+
+typedef struct Sub2VideoRect {
+    int x, y, w, h;
+} Sub2VideoRect;
+
 typedef struct InputStream {
     int file_index;
     AVStream *st;
@@ -251,7 +269,6 @@ typedef struct InputStream {
     AVFrame *filter_frame; /* a ref of decoded_frame, to be sent to filters */
     AVPacket *pkt;
 
-    int64_t       start;     /* time when read started */
     /* predicted dts of the next packet read for this stream or (when there are
      * several frames in a packet) of the next frame in current packet (in AV_TIME_BASE units) */
     int64_t       next_dts;
@@ -294,6 +311,12 @@ typedef struct InputStream {
         AVFifoBuffer *sub_queue;    ///< queue of AVSubtitle* before filter init
         AVFrame *frame;
         int w, h;
+        AVBufferPool *pool;         ///< canvas buffers, recycled once the filters release them
+        int pool_linesize, pool_h;
+        Sub2VideoRect dirty[SUB2VIDEO_MAX_DIRTY]; ///< areas of frame drawn since it was last cleared
+        int nb_dirty;
+        int empty;                  ///< nothing is drawn on frame
+        int bypassed;               ///< the blending filter is disabled while the canvas is empty
         unsigned int initialize; ///< marks if sub2video_update should force an initialization
     } sub2video;
 
@@ -321,6 +344,10 @@ typedef struct InputStream {
     enum AVPixelFormat hwaccel_retrieved_pix_fmt;
     AVBufferRef *hw_frames_ctx;
 
+    /* download target of hwaccel_retrieve_data, reused for every frame */
+    AVFrame *hwaccel_download_frame;
+    DownloadPool hwaccel_download_pool;
+
     /* stats */
     // combined size of all the packets read
     uint64_t data_size;
@@ -335,16 +362,24 @@ typedef struct InputStream {
 
     int got_output;
 
+    /* threads counted against the process-wide codec thread cap */
+    int pool_reserved_threads;
+
+    /* when recent packets were read, -low_latency only */
+    LatencyTrack *latency;
+
     void * p_run_context;
 
 } InputStream;
 
 typedef struct InputFile {
     AVFormatContext *ctx;
+    void * p_run_context;
     int eof_reached;      /* true if eof reached */
     int eagain;           /* true if last read attempt returned EAGAIN */
     int ist_index;        /* index of first stream in input_streams */
     int loop;             /* set number of times input stream should be looped */
+    int seek_index;       /* save the keyframe index to the shared cache when closed */
     int64_t duration;     /* actual duration of the longest stream in a file
                              at the moment when looping happens */
     AVRational time_base; /* time base of the duration */
@@ -359,16 +394,23 @@ typedef struct InputFile {
                              from ctx.nb_streams if new streams appear during av_read_frame() */
     int nb_streams_warn;  /* number of streams that the user was warned of */
     int rate_emu;
+    /* -re clock: the file is read once its furthest stream dts is due */
+    int64_t rate_emu_start;     // av_gettime_relative() when reading started
+    int64_t rate_emu_dts;       // furthest dts of its streams, AV_TIME_BASE
+    int rate_emu_stream;        // stream holding rate_emu_dts
+    int rate_emu_wait;          // the last EAGAIN came from the clock, not from the input
+    int64_t rate_emu_due;       // wall time of that wait
     int accurate_seek;
 
     AVPacket *pkt;
 
 #if HAVE_THREADS
-    AVThreadMessageQueue *in_thread_queue;
+    struct InputQueue *in_thread_queue;
     pthread_t thread;           /* thread reading from this file */
     int non_blocking;           /* reading packets from the thread should not block */
     int joined;                 /* the thread has been joined */
     int thread_queue_size;      /* maximum number of queued packets */
+    int thread_queue_adaptive;  /* thread_queue_size was not given, the depth follows the rates */
 #endif
 } InputFile;
 
@@ -519,6 +561,10 @@ typedef struct OutputFile {
     int shortest;
 
     int header_written;
+    int closed;          // -multi_clip: trailer written as soon as all its streams finished
+
+    struct _mem_data *mem_output;   // data of a filemem:/b64mem: output, NULL for other outputs
+    int64_t mem_charged;            // part of mem_output->size charged to the job
 } OutputFile;
 
 typedef struct OptionOutput {
@@ -534,6 +580,7 @@ typedef struct FilterGraph {
 
     AVFilterGraph *graph;
     int reconfiguration;
+    int pool_attached;      // graph->execute points to the shared filter pool
 
     InputFilter   **inputs;
     int          nb_inputs;
@@ -573,6 +620,8 @@ typedef struct RunContext {
     float max_error_rate  ;
     int filter_nbthreads ;
     int filter_complex_nbthreads ;
+    int shared_codec_threads ;
+    int sub2video_bypass ;
 //    int vstats_version ;
     int auto_conversion_filters ;
 //    int64_t stats_period ;
@@ -618,8 +667,25 @@ typedef struct RunContext {
     int nb_hw_devices;
     HWDevice **hw_devices;
     HWDevice *filter_hw_device;
+    int hw_device_cache;
 
     char * trace_id;
+    int64_t output_duration;    // furthest output timestamp in AV_TIME_BASE, for job stats
+    int log_level;              // messages above it are dropped before formatting
+    const char *_Atomic log_stage;  // written by the job thread, read by its input threads
+    int64_t mem_limit;          // -job_mem_limit, cap of job_mem_charge() in bytes, 0 for none
+    atomic_int_fast64_t mem_used;
+    atomic_int_fast64_t mem_peak;
+    atomic_int mem_exceeded;    // set by a refused charge, transcode() stops at the next step
+    int input_queue_depth;      // deepest input thread queue when the threads were freed
+    int64_t nb_input_send_stalls;
+    int64_t nb_input_recv_stalls;
+    int eager_init;             // -eager_init, open encoders and write headers in transcode_init
+    int low_latency;            // -low_latency, also implies eager_init
+    int multi_clip;             // -multi_clip, seek to the first output window, close outputs when done
+    int audio_fast_path;        // -audio_fast_path lets audio only jobs skip lavfi
+    int audio_fast;             // transcode_init found an audio only job, decoded frames skip lavfi
+    LatencyHist latency;        // input-to-output delay of the muxed packets
 #if HAVE_THREADS
     int need_input_thread;
 #endif
@@ -662,6 +728,8 @@ typedef struct OptionsContext {
     int rate_emu;
     int accurate_seek;
     int thread_queue_size;
+    const char *file_read;
+    int seek_index;
 
     SpecifierOpt *ts_scale;
     int nb_ts_scale;
@@ -4,6 +4,8 @@
 
 #include "cmd_util.h"
 #include "config.h"
+#include "opt_route.h"
+#include <libavutil/avassert.h>
 #include <libavutil/avstring.h>
 #include <libavutil/eval.h>
 #include <libavutil/parseutils.h>
@@ -17,6 +19,10 @@
 #include <sys/resource.h>
 #endif
 
+/*
+ * options[], const_groups and global_group are shared by all jobs and never written,
+ * init_parse_context() gives every job its own copy of the group definitions.
+ */
 extern const OptionDef options[];
 static const OptionGroupDef const_groups[] = {
         [GROUP_OUTFILE] = { "output url",  NULL, OPT_OUTPUT },
@@ -27,7 +33,51 @@ static const OptionGroupDef const_groups[] = {
 
 static const OptionGroupDef global_group = { "global" };
 
+/*
+ * open addressing index over options[], parse_option() and split_commandline() may look up
+ * every argument three times. names never contain ':', the stream specifier is skipped here
+ */
+#define OPTION_INDEX_SIZE 1024
+static const OptionDef *option_index[OPTION_INDEX_SIZE];
+static const OptionDef *options_end;
+static pthread_once_t option_index_once = PTHREAD_ONCE_INIT;
+
+static unsigned option_hash(const char *name, size_t len) {
+    unsigned h = 5381;
+    while (len--)
+        h = h * 33 + (unsigned char)*name++;
+    return h;
+}
+
+static void build_option_index(void) {
+    const OptionDef *po;
+    for (po = options; po->name; po++) {
+        unsigned h = option_hash(po->name, strlen(po->name)) & (OPTION_INDEX_SIZE - 1);
+        while (option_index[h] && strcmp(option_index[h]->name, po->name))
+            h = (h + 1) & (OPTION_INDEX_SIZE - 1);
+        // the first entry of a name wins, as it did for the linear scan
+        if (!option_index[h])
+            option_index[h] = po;
+    }
+    av_assert0(po - options < OPTION_INDEX_SIZE / 2);
+    options_end = po;
+}
+
+void init_option_index(void) {
+    pthread_once(&option_index_once, build_option_index);
+}
+
 static const OptionDef *find_option(const OptionDef *po, const char *name) {
+    if (po == options) {
+        size_t len = strcspn(name, ":");
+        unsigned h = option_hash(name, len) & (OPTION_INDEX_SIZE - 1);
+        init_option_index();
+        for (; (po = option_index[h]); h = (h + 1) & (OPTION_INDEX_SIZE - 1)) {
+            if (!strncmp(po->name, name, len) && !po->name[len])
+                return po;
+        }
+        return options_end;
+    }
     while (po->name) {
         const char *end;
         if (av_strstart(name, po->name, &end) && (!*end || *end == ':'))
@@ -226,61 +276,35 @@ int opt_timelimit(void *optctx, const char *opt, const char *arg) {
     return 0;
 }
 
-static const AVOption *opt_find(void *obj, const char *name, const char *unit,
-                                int opt_flags, int search_flags) {
-    const AVOption *o = av_opt_find(obj, name, unit, opt_flags, search_flags);
-    if (o && !o->flags)
-        return NULL;
-    return o;
-}
-
 #define FLAGS (o->type == AV_OPT_TYPE_FLAGS && (arg[0]=='-' || arg[0]=='+')) ? AV_DICT_APPEND : 0
 
 int opt_default(void *optctx, const char *opt, const char *arg) {
     const AVOption *o;
-    int consumed = 0;
-    char opt_stripped[128];
-    const char *p;
-    const AVClass *cc = avcodec_get_class(), *fc = avformat_get_class();
+    OptRoute route;
+    int consumed;
 
     OptionsContext *ctx = optctx;
-#if CONFIG_AVRESAMPLE
-    const AVClass *rc = avresample_get_class();
-#endif
-#if CONFIG_SWSCALE
-    const AVClass *sc = sws_get_class();
-#endif
-#if CONFIG_SWRESAMPLE
-    const AVClass *swr_class = swr_get_class();
-#endif
 
+    // only this job logs more, av_log_set_level() would change it for every job of the process
     if (!strcmp(opt, "debug") || !strcmp(opt, "fdebug"))
-        av_log_set_level(AV_LOG_DEBUG);
+        ctx->run_context_ref->log_level = AV_LOG_DEBUG;
 
-    if (!(p = strchr(opt, ':')))
-        p = opt + strlen(opt);
-    av_strlcpy(opt_stripped, opt, FFMIN(sizeof(opt_stripped), p - opt + 1));
+    opt_route_get(opt, &route);
+    consumed = route.layers != 0;
 
-    if ((o = opt_find(&cc, opt_stripped, NULL, 0,
-                      AV_OPT_SEARCH_CHILDREN | AV_OPT_SEARCH_FAKE_OBJ)) ||
-        ((opt[0] == 'v' || opt[0] == 'a' || opt[0] == 's') &&
-         (o = opt_find(&cc, opt + 1, NULL, 0, AV_OPT_SEARCH_FAKE_OBJ)))) {
+    if (route.layers & OPT_ROUTE_CODEC) {
+        o = route.codec;
         av_dict_set(&ctx->run_context_ref->codec_opts, opt, arg, FLAGS);
-        consumed = 1;
     }
-    if ((o = opt_find(&fc, opt, NULL, 0,
-                      AV_OPT_SEARCH_CHILDREN | AV_OPT_SEARCH_FAKE_OBJ))) {
+    if (route.layers & OPT_ROUTE_FORMAT) {
+        o = route.format;
         av_dict_set(&ctx->run_context_ref->format_opts, opt, arg, FLAGS);
-        if (consumed)
+        if (route.layers & OPT_ROUTE_CODEC)
             av_log(NULL, AV_LOG_VERBOSE, "Routing option %s to both codec and muxer layer\n", opt);
-        consumed = 1;
     }
 #if CONFIG_SWSCALE
-    if (!consumed && (o = opt_find(&sc, opt, NULL, 0,
-                                   AV_OPT_SEARCH_CHILDREN | AV_OPT_SEARCH_FAKE_OBJ))) {
-        struct SwsContext *sws = sws_alloc_context();
-        int ret = av_opt_set(sws, opt, arg, 0);
-        sws_freeContext(sws);
+    if (route.layers & OPT_ROUTE_SWS) {
+        int ret = opt_route_check(OPT_ROUTE_SWS, opt, arg);
         if (!strcmp(opt, "srcw") || !strcmp(opt, "srch") ||
             !strcmp(opt, "dstw") || !strcmp(opt, "dsth") ||
             !strcmp(opt, "src_format") || !strcmp(opt, "dst_format")) {
@@ -293,9 +317,8 @@ int opt_default(void *optctx, const char *opt, const char *arg) {
             return ret;
         }
 
+        o = route.sws;
         av_dict_set(&ctx->run_context_ref->sws_dict, opt, arg, FLAGS);
-
-        consumed = 1;
     }
 #else
     if (!consumed && !strcmp(opt, "sws_flags")) {
@@ -304,24 +327,20 @@ int opt_default(void *optctx, const char *opt, const char *arg) {
     }
 #endif
 #if CONFIG_SWRESAMPLE
-    if (!consumed && (o = opt_find(&swr_class, opt, NULL, 0,
-                                   AV_OPT_SEARCH_CHILDREN | AV_OPT_SEARCH_FAKE_OBJ))) {
-        struct SwrContext *swr = swr_alloc();
-        int ret = av_opt_set(swr, opt, arg, 0);
-        swr_free(&swr);
+    if (route.layers & OPT_ROUTE_SWR) {
+        int ret = opt_route_check(OPT_ROUTE_SWR, opt, arg);
         if (ret < 0) {
             av_log(NULL, AV_LOG_ERROR, "Error setting option %s.\n", opt);
             return ret;
         }
+        o = route.swr;
         av_dict_set(&ctx->run_context_ref->swr_opts, opt, arg, FLAGS);
-        consumed = 1;
     }
 #endif
 #if CONFIG_AVRESAMPLE
-    if ((o=opt_find(&rc, opt, NULL, 0,
-                       AV_OPT_SEARCH_CHILDREN | AV_OPT_SEARCH_FAKE_OBJ))) {
+    if (route.layers & OPT_ROUTE_AVRESAMPLE) {
+        o = route.avresample;
         av_dict_set(&resample_opts, opt, arg, FLAGS);
-        consumed = 1;
     }
 #endif
 
@@ -805,6 +824,82 @@ AVDictionary *filter_codec_opts(AVDictionary *opts, enum AVCodecID codec_id,
     return ret;
 }
 
+static int has_stream_specifier(AVDictionary *opts)
+{
+    AVDictionaryEntry *t = NULL;
+    while ((t = av_dict_get(opts, "", t, AV_DICT_IGNORE_SUFFIX))) {
+        if (strchr(t->key, ':'))
+            return 1;
+    }
+    return 0;
+}
+
+StreamCodecOpts *resolve_stream_codec_opts(const char *trace_id, AVFormatContext *s, AVDictionary *codec_opts, int *error)
+{
+    StreamCodecOpts *resolved;
+    int i, j, specific;
+
+    if (!s->nb_streams)
+        return NULL;
+    resolved = av_mallocz_array(s->nb_streams, sizeof(*resolved));
+    if (!resolved) {
+        av_log(NULL, AV_LOG_ERROR,
+               "tid=%s,Could not alloc memory for stream options.\n",trace_id);
+        *error = 1;
+        return NULL;
+    }
+    // without specifiers the result only depends on the codec and the media type
+    specific = has_stream_specifier(codec_opts);
+    for (i = 0; i < s->nb_streams; i++) {
+        AVStream *st = s->streams[i];
+        StreamCodecOpts *r = &resolved[i];
+
+        r->codec_id = st->codecpar->codec_id;
+        r->codec    = avcodec_find_decoder(r->codec_id);
+        for (j = 0; !specific && j < i; j++) {
+            if (resolved[j].codec == r->codec && resolved[j].codec_id == r->codec_id &&
+                s->streams[j]->codecpar->codec_type == st->codecpar->codec_type)
+                break;
+        }
+        if (!specific && j < i) {
+            if (av_dict_copy(&r->opts, resolved[j].opts, 0) < 0)
+                *error = 1;
+        } else {
+            r->opts = filter_codec_opts(codec_opts, r->codec_id, s, st, r->codec, error);
+        }
+        if (*error) {
+            free_stream_codec_opts(&resolved, i + 1);
+            return NULL;
+        }
+    }
+    return resolved;
+}
+
+AVDictionary *take_stream_codec_opts(StreamCodecOpts *resolved, int nb_resolved, AVDictionary *codec_opts,
+                                     AVFormatContext *s, AVStream *st, const AVCodec *codec, int *error)
+{
+    AVDictionary *opts;
+
+    if (st->index < nb_resolved && resolved[st->index].codec == codec &&
+        resolved[st->index].codec_id == st->codecpar->codec_id) {
+        opts = resolved[st->index].opts;
+        resolved[st->index].opts = NULL;
+        return opts;
+    }
+    return filter_codec_opts(codec_opts, st->codecpar->codec_id, s, st, codec, error);
+}
+
+void free_stream_codec_opts(StreamCodecOpts **resolved, int nb_resolved)
+{
+    int i;
+
+    if (!*resolved)
+        return;
+    for (i = 0; i < nb_resolved; i++)
+        av_dict_free(&(*resolved)[i].opts);
+    av_freep(resolved);
+}
+
 FILE *get_preset_file(char *filename, size_t filename_size,
                       const char *preset_name, int is_path,
                       const char *codec_name)
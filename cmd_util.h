@@ -29,6 +29,8 @@
         p++;   \
     }
 
+/* hash index of options[], built on first use. init_ffmpeg() builds it up front */
+void init_option_index(void);
 int parse_option(void *optctx, const char *opt, const char *arg,
                  const OptionDef *options);
 void *grow_array(char *trace_id,void *array, int elem_size, int *size, int new_size,int *has_error);
@@ -64,6 +66,20 @@ AVDictionary **setup_find_stream_info_opts(const char * trace_id,AVFormatContext
 AVDictionary *filter_codec_opts(AVDictionary *opts, enum AVCodecID codec_id,
                                 AVFormatContext *s, AVStream *st, const AVCodec *codec,int *error);
 
+/* the codec options of one input stream, filtered once per file and reused while its codec stays the same */
+typedef struct StreamCodecOpts {
+    AVDictionary *opts;
+    enum AVCodecID codec_id;
+    const AVCodec *codec;       // the decoder opts were filtered for
+} StreamCodecOpts;
+
+/* the same dictionaries setup_find_stream_info_opts() gives, one per stream of s */
+StreamCodecOpts *resolve_stream_codec_opts(const char *trace_id, AVFormatContext *s, AVDictionary *codec_opts, int *error);
+/* hands over the stream's resolved dictionary if it was filtered for codec, otherwise filters anew */
+AVDictionary *take_stream_codec_opts(StreamCodecOpts *resolved, int nb_resolved, AVDictionary *codec_opts,
+                                     AVFormatContext *s, AVStream *st, const AVCodec *codec, int *error);
+void free_stream_codec_opts(StreamCodecOpts **resolved, int nb_resolved);
+
 FILE *get_preset_file(char *filename, size_t filename_size,
                       const char *preset_name, int is_path, const char *codec_name);
 
@@ -0,0 +1,146 @@
+//
+// Created by hexiufeng on 2026/10/19.
+//
+
+#include "codec_pool.h"
+#include "worker_pool.h"
+#include <libavutil/cpu.h>
+
+/* same limit libavcodec applies to threads=auto */
+#define MAX_AUTO_THREADS 16
+
+#ifndef AV_CODEC_CAP_OTHER_THREADS
+#define AV_CODEC_CAP_OTHER_THREADS AV_CODEC_CAP_AUTO_THREADS
+#endif
+
+typedef struct CodecJobs {
+    AVCodecContext *avctx;
+    int (*func)(AVCodecContext *c2, void *arg2);
+    uint8_t *arg;
+    int *rets;
+    int size;
+} CodecJobs;
+
+static pthread_mutex_t cap_lock = PTHREAD_MUTEX_INITIALIZER;
+static int thread_cap;
+static int threads_in_use;
+
+static void run_codec_job(WorkerBatch *b, int jobnr)
+{
+    CodecJobs *j = b->priv;
+    int ret = j->func(j->avctx, j->arg + (size_t)jobnr * j->size);
+    if (j->rets)
+        j->rets[jobnr] = ret;
+}
+
+static int pool_execute(AVCodecContext *c, int (*func)(AVCodecContext *c2, void *arg2),
+                        void *arg2, int *ret, int count, int size)
+{
+    CodecJobs j   = { .avctx = c, .func = func, .arg = arg2, .rets = ret, .size = size };
+    WorkerBatch b = { .run = run_codec_job, .priv = &j, .nb_jobs = count };
+
+    worker_pool_execute(&b);
+    return 0;
+}
+
+/*
+ * execute2() hands each job a thread index below thread_count, and codecs size their per
+ * thread state by it. codecs served here are opened with one thread, so their jobs run in
+ * turn on index 0, just like avcodec_default_execute2() would.
+ */
+static int pool_execute2(AVCodecContext *c, int (*func)(AVCodecContext *c2, void *arg2, int jobnr, int threadnr),
+                         void *arg2, int *ret, int count)
+{
+    int i;
+
+    for (i = 0; i < count; i++) {
+        int r = func(c, arg2, i, 0);
+        if (ret)
+            ret[i] = r;
+    }
+    return 0;
+}
+
+/*
+ * whether libavcodec will run threads of its own for avctx: frame or slice threads once
+ * thread_count > 1, or the threads of an external library (libx264, libdav1d...)
+ */
+static int has_own_threads(const AVCodecContext *avctx)
+{
+    int caps = avctx->codec ? avctx->codec->capabilities : 0;
+
+    return ((caps & AV_CODEC_CAP_FRAME_THREADS) && (avctx->thread_type & FF_THREAD_FRAME)) ||
+           ((caps & AV_CODEC_CAP_SLICE_THREADS) && (avctx->thread_type & FF_THREAD_SLICE)) ||
+           (caps & AV_CODEC_CAP_OTHER_THREADS);
+}
+
+void codec_pool_set_thread_cap(int cap)
+{
+    pthread_mutex_lock(&cap_lock);
+    thread_cap = FFMAX(cap, 0);
+    pthread_mutex_unlock(&cap_lock);
+}
+
+int codec_pool_prepare(RunContext *run_context, AVCodecContext *avctx, AVDictionary **opts, int *reserved)
+{
+    AVDictionaryEntry *e = av_dict_get(*opts, "threads", NULL, 0);
+    int is_auto = !e || !strcmp(e->value, "auto") || !strcmp(e->value, "0");
+    int own_threads = has_own_threads(avctx);
+    int wanted, granted;
+
+    *reserved = 0;
+
+    /*
+     * libavcodec replaces execute/execute2 with its own slice threads as soon as thread_count > 1,
+     * and a codec opened with one thread splits its work into a single slice. a threaded codec
+     * on the pool would lose all its parallelism, so it keeps its threads and counts against the cap.
+     */
+    if (run_context->shared_codec_threads && is_auto && own_threads)
+        av_log(NULL, AV_LOG_VERBOSE, "tid=%s,%s keeps its own threads, not using the shared pool\n",
+               run_context->trace_id, avctx->codec->name);
+
+    if (run_context->shared_codec_threads && is_auto && !own_threads && worker_pool_start() > 0) {
+        av_dict_set(opts, "threads", "1", 0);
+        avctx->execute  = pool_execute;
+        avctx->execute2 = pool_execute2;
+        return 0;
+    }
+
+    // most audio codecs run on the calling thread whatever threads says, nothing to reserve
+    if (!own_threads)
+        return 0;
+
+    wanted = is_auto ? FFMIN(av_cpu_count() + 1, MAX_AUTO_THREADS) : atoi(e->value);
+    if (wanted <= 1)
+        return 0;
+
+    pthread_mutex_lock(&cap_lock);
+    if (!thread_cap) {
+        pthread_mutex_unlock(&cap_lock);
+        return 0;
+    }
+    granted = FFMIN(wanted, FFMAX(1, thread_cap - threads_in_use));
+    if (granted > 1)
+        threads_in_use += granted;
+    pthread_mutex_unlock(&cap_lock);
+
+    if (granted > 1)
+        *reserved = granted;
+    if (granted < wanted) {
+        av_log(NULL, AV_LOG_VERBOSE, "tid=%s,codec thread cap reached, %s opened with %d threads instead of %d\n",
+               run_context->trace_id, avctx->codec ? avctx->codec->name : avcodec_get_name(avctx->codec_id),
+               granted, wanted);
+        return av_dict_set_int(opts, "threads", granted, 0);
+    }
+    return 0;
+}
+
+void codec_pool_release(int *reserved)
+{
+    if (!*reserved)
+        return;
+    pthread_mutex_lock(&cap_lock);
+    threads_in_use -= *reserved;
+    pthread_mutex_unlock(&cap_lock);
+    *reserved = 0;
+}
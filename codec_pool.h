@@ -0,0 +1,25 @@
+//
+// Created by hexiufeng on 2026/10/19.
+//
+
+#ifndef RUN_FFMPEG_CODEC_POOL_H
+#define RUN_FFMPEG_CODEC_POOL_H
+
+#include "cmd_options.h"
+
+/* process-wide limit on threads owned by codecs of all jobs, 0 = unlimited */
+void codec_pool_set_thread_cap(int cap);
+
+/*
+ * called right before avcodec_open2() with the final codec options.
+ * with -shared_codec_threads, codecs on auto threads that have no threading of their own are
+ * opened single threaded and their execute() is served by the shared worker pool. codecs with
+ * frame, slice or library threads keep them, as libavcodec only calls a custom execute() for a
+ * single threaded codec. their threads option is clamped to what is left of the cap, codecs
+ * without threads reserve nothing. *reserved must be handed to codec_pool_release() once the
+ * codec is freed.
+ */
+int codec_pool_prepare(RunContext *run_context, AVCodecContext *avctx, AVDictionary **opts, int *reserved);
+void codec_pool_release(int *reserved);
+
+#endif //RUN_FFMPEG_CODEC_POOL_H
@@ -5,6 +5,7 @@
 #include <libavutil/avassert.h>
 #include <libavfilter/buffersrc.h>
 #include "common.h"
+#include "palette.h"
 #if HAVE_SYS_RESOURCE_H
 #include <sys/time.h>
 #endif
@@ -145,27 +146,92 @@ uint8_t *get_line(AVIOContext *s,int *has_error)
     return buf;
 }
 
+/* canvas rows are padded like av_frame_get_buffer() does, filters may read past the width */
+#define SUB2VIDEO_ALIGN 64
+
+static void sub2video_clear_dirty(InputStream *ist, AVFrame *frame)
+{
+    int i, y;
+
+    for (i = 0; i < ist->sub2video.nb_dirty; i++) {
+        const Sub2VideoRect *r = &ist->sub2video.dirty[i];
+        uint8_t *dst = frame->data[0] + r->y * frame->linesize[0] + r->x * 4;
+        for (y = 0; y < r->h; y++, dst += frame->linesize[0])
+            memset(dst, 0, r->w * 4);
+    }
+    ist->sub2video.nb_dirty = 0;
+}
+
 static int sub2video_get_blank_frame(InputStream *ist)
 {
-    int ret;
     AVFrame *frame = ist->sub2video.frame;
+    int w = ist->dec_ctx->width  ? ist->dec_ctx->width  : ist->sub2video.w;
+    int h = ist->dec_ctx->height ? ist->dec_ctx->height : ist->sub2video.h;
+    int linesize = FFALIGN(w * 4, SUB2VIDEO_ALIGN);
+
+    /* the filters are done with the last canvas, only wipe what was drawn on it */
+    if (frame->buf[0] && av_frame_is_writable(frame) &&
+        frame->width == w && frame->height == h) {
+        sub2video_clear_dirty(ist, frame);
+        return 0;
+    }
 
     av_frame_unref(frame);
-    ist->sub2video.frame->width  = ist->dec_ctx->width  ? ist->dec_ctx->width  : ist->sub2video.w;
-    ist->sub2video.frame->height = ist->dec_ctx->height ? ist->dec_ctx->height : ist->sub2video.h;
-    ist->sub2video.frame->format = AV_PIX_FMT_RGB32;
-    if ((ret = av_frame_get_buffer(frame, 0)) < 0)
-        return ret;
-    memset(frame->data[0], 0, frame->height * frame->linesize[0]);
+    if (!ist->sub2video.pool || ist->sub2video.pool_linesize != linesize || ist->sub2video.pool_h != h) {
+        av_buffer_pool_uninit(&ist->sub2video.pool);
+        ist->sub2video.pool = av_buffer_pool_init(linesize * h + SUB2VIDEO_ALIGN, NULL);
+        if (!ist->sub2video.pool)
+            return AVERROR(ENOMEM);
+        ist->sub2video.pool_linesize = linesize;
+        ist->sub2video.pool_h        = h;
+    }
+    frame->buf[0] = av_buffer_pool_get(ist->sub2video.pool);
+    if (!frame->buf[0])
+        return AVERROR(ENOMEM);
+    frame->data[0]     = (uint8_t *)FFALIGN((uintptr_t)frame->buf[0]->data, SUB2VIDEO_ALIGN);
+    frame->linesize[0] = linesize;
+    frame->width       = w;
+    frame->height      = h;
+    frame->format      = AV_PIX_FMT_RGB32;
+
+    /* a recycled buffer holds whatever an older canvas left in it */
+    memset(frame->data[0], 0, h * linesize);
+    ist->sub2video.nb_dirty = 0;
     return 0;
 }
 
-static void sub2video_copy_rect(uint8_t *dst, int dst_linesize, int w, int h,
+static void sub2video_mark_dirty(InputStream *ist, int x, int y, int w, int h)
+{
+    Sub2VideoRect *r;
+    int i;
+
+    if (ist->sub2video.nb_dirty == SUB2VIDEO_MAX_DIRTY) {
+        /* out of slots, merge everything into one bounding box */
+        r = &ist->sub2video.dirty[0];
+        for (i = 1; i < SUB2VIDEO_MAX_DIRTY; i++) {
+            const Sub2VideoRect *o = &ist->sub2video.dirty[i];
+            int x1 = FFMAX(r->x + r->w, o->x + o->w), y1 = FFMAX(r->y + r->h, o->y + o->h);
+            r->x = FFMIN(r->x, o->x);
+            r->y = FFMIN(r->y, o->y);
+            r->w = x1 - r->x;
+            r->h = y1 - r->y;
+        }
+        ist->sub2video.nb_dirty = 1;
+    }
+    r = &ist->sub2video.dirty[ist->sub2video.nb_dirty++];
+    r->x = x;
+    r->y = y;
+    r->w = w;
+    r->h = h;
+}
+
+static void sub2video_copy_rect(InputStream *ist, uint8_t *dst, int dst_linesize, int w, int h,
                                 AVSubtitleRect *r)
 {
-    uint32_t *pal, *dst2;
-    uint8_t *src, *src2;
-    int x, y;
+    palette_expand_fn expand = get_palette_expand();
+    uint32_t *pal;
+    uint8_t *src;
+    int y;
 
     if (r->type != SUBTITLE_BITMAP) {
         av_log(NULL, AV_LOG_WARNING, "sub2video: non-bitmap subtitle\n");
@@ -178,14 +244,12 @@ static void sub2video_copy_rect(uint8_t *dst, int dst_linesize, int w, int h,
         return;
     }
 
+    sub2video_mark_dirty(ist, r->x, r->y, r->w, r->h);
     dst += r->y * dst_linesize + r->x * 4;
     src = r->data[0];
     pal = (uint32_t *)r->data[1];
     for (y = 0; y < r->h; y++) {
-        dst2 = (uint32_t *)dst;
-        src2 = src;
-        for (x = 0; x < r->w; x++)
-            *(dst2++) = pal[*(src2++)];
+        expand((uint32_t *)dst, src, pal, r->w);
         dst += dst_linesize;
         src += r->linesize[0];
     }
@@ -209,8 +273,46 @@ static void sub2video_push_ref(InputStream *ist, int64_t pts)
     }
 }
 
+/* the first filter downstream of the sub2video buffer source that merges it with other inputs */
+static AVFilterContext *sub2video_blend_filter(InputFilter *ifilter)
+{
+    AVFilterContext *f = ifilter->filter;
+
+    while (f && f->nb_outputs == 1 && f->outputs[0]) {
+        f = f->outputs[0]->dst;
+        if (f->nb_inputs > 1)
+            return f->filter->flags & AVFILTER_FLAG_SUPPORT_TIMELINE ? f : NULL;
+    }
+    return NULL;
+}
+
+/*
+ * while the canvas is empty the blending filter only blends transparent pixels.
+ * disabling it through its timeline makes it pass the main input through. main frames
+ * before end_pts may still be queued in the filter, so the switch off is done by time.
+ */
+static void sub2video_set_bypass(InputStream *ist, int bypass, int64_t end_pts)
+{
+    char expr[64];
+    int i;
+
+    if (bypass)
+        snprintf(expr, sizeof(expr), "lt(t,%.6f)", end_pts * av_q2d(ist->st->time_base));
+    for (i = 0; i < ist->nb_filters; i++) {
+        AVFilterContext *f = sub2video_blend_filter(ist->filters[i]);
+        if (!f)
+            continue;
+        /* leave a user supplied enable expression alone */
+        if (!ist->sub2video.bypassed && f->enable_str && strcmp(f->enable_str, "1"))
+            continue;
+        avfilter_process_command(f, "enable", bypass ? expr : "1", NULL, 0, 0);
+    }
+    ist->sub2video.bypassed = bypass;
+}
+
 void sub2video_update(InputStream *ist, int64_t heartbeat_pts, AVSubtitle *sub)
 {
+    RunContext *run_context = ist->p_run_context;
     AVFrame *frame = ist->sub2video.frame;
     int8_t *dst;
     int     dst_linesize;
@@ -235,15 +337,22 @@ void sub2video_update(InputStream *ist, int64_t heartbeat_pts, AVSubtitle *sub)
         end_pts   = INT64_MAX;
         num_rects = 0;
     }
-    if (sub2video_get_blank_frame(ist) < 0) {
-        av_log(ist->dec_ctx, AV_LOG_ERROR,
-               "Impossible to get a blank canvas.\n");
-        return;
+    /* an empty canvas stays empty, push it again with the new timestamp */
+    if (num_rects || !ist->sub2video.empty || !frame->buf[0]) {
+        if (sub2video_get_blank_frame(ist) < 0) {
+            av_log(ist->dec_ctx, AV_LOG_ERROR,
+                   "Impossible to get a blank canvas.\n");
+            return;
+        }
+        dst          = frame->data    [0];
+        dst_linesize = frame->linesize[0];
+        for (i = 0; i < num_rects; i++)
+            sub2video_copy_rect(ist, dst, dst_linesize, frame->width, frame->height, sub->rects[i]);
+        ist->sub2video.empty = !ist->sub2video.nb_dirty;
     }
-    dst          = frame->data    [0];
-    dst_linesize = frame->linesize[0];
-    for (i = 0; i < num_rects; i++)
-        sub2video_copy_rect(dst, dst_linesize, frame->width, frame->height, sub->rects[i]);
+    if (run_context && run_context->sub2video_bypass && ist->sub2video.bypassed != ist->sub2video.empty &&
+        pts != INT64_MIN && pts != INT64_MAX)
+        sub2video_set_bypass(ist, ist->sub2video.empty, pts);
     sub2video_push_ref(ist, pts);
     ist->sub2video.end_pts = end_pts;
     ist->sub2video.initialize = 0;
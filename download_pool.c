@@ -0,0 +1,48 @@
+//
+// Created by hexiufeng on 2026/10/19.
+//
+
+#include "download_pool.h"
+#include <libavutil/error.h>
+#include <libavutil/imgutils.h>
+
+#define DOWNLOAD_ALIGN 64
+
+int download_pool_get(DownloadPool *p, AVFrame *output, enum AVPixelFormat format, int width, int height)
+{
+    int size, ret;
+
+    if (p->unpooled)
+        return 0;
+    size = av_image_get_buffer_size(format, width, height, DOWNLOAD_ALIGN);
+    if (size < 0)
+        return 0;
+
+    if (!p->pool || p->size != size) {
+        av_buffer_pool_uninit(&p->pool);
+        p->pool = av_buffer_pool_init(size, NULL);
+        if (!p->pool)
+            return AVERROR(ENOMEM);
+        p->size = size;
+    }
+    output->buf[0] = av_buffer_pool_get(p->pool);
+    if (!output->buf[0])
+        return AVERROR(ENOMEM);
+    ret = av_image_fill_arrays(output->data, output->linesize, output->buf[0]->data,
+                               format, width, height, DOWNLOAD_ALIGN);
+    if (ret < 0) {
+        av_frame_unref(output);
+        return ret;
+    }
+    output->format = format;
+    output->width  = width;
+    output->height = height;
+    return 1;
+}
+
+void download_pool_uninit(DownloadPool *p)
+{
+    av_buffer_pool_uninit(&p->pool);
+    p->size = 0;
+    p->unpooled = 0;
+}
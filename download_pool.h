@@ -0,0 +1,30 @@
+//
+// Created by hexiufeng on 2026/10/19.
+//
+
+#ifndef RUN_FFMPEG_DOWNLOAD_POOL_H
+#define RUN_FFMPEG_DOWNLOAD_POOL_H
+
+#include <libavutil/buffer.h>
+#include <libavutil/frame.h>
+#include <libavutil/pixfmt.h>
+
+/*
+ * buffers for downloading hw frames to system memory, one pool per input stream.
+ * the pool is sized for format at the hw surface dimensions and rebuilt when they change.
+ */
+typedef struct DownloadPool {
+    AVBufferPool *pool;
+    int size;
+    int unpooled;               ///< the hwcontext refused a preallocated target
+} DownloadPool;
+
+/*
+ * back output with a buffer of the pool and set its format, size and data pointers.
+ * returns 1 on success, 0 when the caller should let av_hwframe_transfer_data() allocate
+ * instead (pool turned off or no valid image size), < 0 on error.
+ */
+int download_pool_get(DownloadPool *p, AVFrame *output, enum AVPixelFormat format, int width, int height);
+void download_pool_uninit(DownloadPool *p);
+
+#endif //RUN_FFMPEG_DOWNLOAD_POOL_H
@@ -0,0 +1,167 @@
+//
+// Created by hexiufeng on 2026/10/19.
+//
+
+#include "file_io.h"
+#include "config.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#if HAVE_MMAP
+#include <sys/mman.h>
+#endif
+#include <libavutil/avstring.h>
+#include <libavutil/common.h>
+#include <libavutil/error.h>
+#include <libavutil/mem.h>
+
+#define FILE_IO_SIZE (1 << 20)
+
+typedef struct FileIO {
+    int fd;
+    int64_t size;
+    int64_t pos;
+    const uint8_t *map;     // whole file in mmap mode, NULL in block mode
+} FileIO;
+
+int file_io_parse_mode(const char *name, enum FileReadMode *mode)
+{
+    if (!name || !strcmp(name, "default"))
+        *mode = FILE_READ_DEFAULT;
+    else if (!strcmp(name, "mmap"))
+        *mode = FILE_READ_MMAP;
+    else if (!strcmp(name, "block"))
+        *mode = FILE_READ_BLOCK;
+    else
+        return AVERROR(EINVAL);
+    return 0;
+}
+
+static int file_io_read(void *opaque, uint8_t *buf, int size)
+{
+    FileIO *f = opaque;
+    ssize_t n;
+
+    if (f->map) {
+        if (f->pos >= f->size)
+            return AVERROR_EOF;
+        size = FFMIN(size, f->size - f->pos);
+        memcpy(buf, f->map + f->pos, size);
+        f->pos += size;
+        return size;
+    }
+
+    do {
+        n = pread(f->fd, buf, size, f->pos);
+    } while (n < 0 && errno == EINTR);
+    if (n < 0)
+        return AVERROR(errno);
+    if (!n)
+        return AVERROR_EOF;
+    f->pos += n;
+    return n;
+}
+
+static int64_t file_io_seek(void *opaque, int64_t offset, int whence)
+{
+    FileIO *f = opaque;
+    int64_t pos;
+
+    whence &= ~AVSEEK_FORCE;
+    switch (whence) {
+    case AVSEEK_SIZE: return f->size;
+    case SEEK_SET:    pos = offset;           break;
+    case SEEK_CUR:    pos = f->pos + offset;  break;
+    case SEEK_END:    pos = f->size + offset; break;
+    default:          return AVERROR(EINVAL);
+    }
+    if (pos < 0)
+        return AVERROR(EINVAL);
+    f->pos = pos;
+    return pos;
+}
+
+static void free_file(FileIO *f)
+{
+#if HAVE_MMAP
+    if (f->map)
+        munmap((void *)f->map, f->size);
+#endif
+    close(f->fd);
+    av_free(f);
+}
+
+int file_io_open(const char *url, enum FileReadMode mode, AVIOContext **pb)
+{
+    const char *proto = avio_find_protocol_name(url);
+    const char *path = url;
+    struct stat st;
+    uint8_t *io_buf;
+    FileIO *f;
+
+    *pb = NULL;
+    if (mode == FILE_READ_DEFAULT || !proto || strcmp(proto, "file"))
+        return AVERROR(ENOSYS);
+    av_strstart(url, "file:", &path);
+
+    f = av_mallocz(sizeof(*f));
+    if (!f)
+        return AVERROR(ENOMEM);
+    f->fd = open(path, O_RDONLY);
+    if (f->fd < 0) {
+        av_free(f);
+        return AVERROR(ENOSYS);
+    }
+    // pipes, devices and empty files are left to the file protocol
+    if (fstat(f->fd, &st) || !S_ISREG(st.st_mode) || !st.st_size) {
+        close(f->fd);
+        av_free(f);
+        return AVERROR(ENOSYS);
+    }
+    f->size = st.st_size;
+
+#if HAVE_MMAP
+    if (mode == FILE_READ_MMAP && f->size <= SIZE_MAX) {
+        void *map = mmap(NULL, (size_t)f->size, PROT_READ, MAP_PRIVATE, f->fd, 0);
+        if (map != MAP_FAILED) {
+            f->map = map;
+            madvise(map, f->size, MADV_SEQUENTIAL);
+        }
+    }
+#endif
+#ifdef POSIX_FADV_SEQUENTIAL
+    // also where mmap failed, e.g. on a 32 bit address space
+    if (!f->map)
+        posix_fadvise(f->fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+    io_buf = av_malloc(FILE_IO_SIZE);
+    if (!io_buf) {
+        free_file(f);
+        return AVERROR(ENOMEM);
+    }
+    *pb = avio_alloc_context(io_buf, FILE_IO_SIZE, 0, f, file_io_read, NULL, file_io_seek);
+    if (!*pb) {
+        av_free(io_buf);
+        free_file(f);
+        return AVERROR(ENOMEM);
+    }
+    return 0;
+}
+
+int file_io_owns(AVIOContext *pb)
+{
+    return pb && pb->seek == file_io_seek;
+}
+
+void file_io_close(AVIOContext **pb)
+{
+    if (!*pb)
+        return;
+    free_file((*pb)->opaque);
+    av_freep(&(*pb)->buffer);
+    avio_context_free(pb);
+}
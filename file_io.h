@@ -0,0 +1,32 @@
+//
+// Created by hexiufeng on 2026/10/19.
+//
+
+#ifndef RUN_FFMPEG_FILE_IO_H
+#define RUN_FFMPEG_FILE_IO_H
+
+#include <libavformat/avio.h>
+
+/*
+ * -file_read for local regular files: "mmap" maps the whole file and the avio reads
+ * are plain copies, "block" reads it in 1MB blocks with sequential read-ahead advice.
+ * either way the demuxer refills its buffer with one call per megabyte instead of
+ * a read() per 32KB.
+ */
+
+enum FileReadMode {
+    FILE_READ_DEFAULT,
+    FILE_READ_MMAP,
+    FILE_READ_BLOCK,
+};
+
+/* AVERROR(EINVAL) for an unknown mode name, NULL and "default" give FILE_READ_DEFAULT */
+int file_io_parse_mode(const char *name, enum FileReadMode *mode);
+
+/* AVERROR(ENOSYS) when url is not a local regular file, the caller then opens it the usual way */
+int file_io_open(const char *url, enum FileReadMode mode, AVIOContext **pb);
+/* whether pb was opened by file_io_open() */
+int file_io_owns(AVIOContext *pb);
+void file_io_close(AVIOContext **pb);
+
+#endif //RUN_FFMPEG_FILE_IO_H
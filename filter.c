@@ -6,6 +6,9 @@
 #include "cmd_util.h"
 #include "common.h"
 #include "hw.h"
+#include "filter_cache.h"
+#include "filter_pool.h"
+#include "job_mem.h"
 #include <libavutil/avassert.h>
 #include <libavutil/avstring.h>
 #include <libavutil/opt.h>
@@ -17,7 +20,7 @@
 
 /* Define a function for building a string containing a list of
         * allowed formats. */
-#define DEF_CHOOSE_FORMAT(suffix, type, var, supported_list, none, get_name)   \
+#define DEF_CHOOSE_FORMAT(suffix, type, var, supported_list, none, get_name, kind)   \
 static char *choose_ ## suffix (OutputFilter *ofilter,int *has_err)            \
 {                                                                              \
     if (ofilter->var != none) {                                                \
@@ -29,6 +32,10 @@ static char *choose_ ## suffix (OutputFilter *ofilter,int *has_err)            \
         uint8_t *ret;                                                          \
         int len;                                                               \
                                                                                \
+        /* the list is a copy of the encoder's one, see open_output_file */    \
+        if ((ret = (uint8_t *)filter_cache_get_formats(ofilter->ost->enc,      \
+                                                       kind, 0)))              \
+            return ret;                                                        \
         if (avio_open_dyn_buf(&s) < 0)                                         \
         {                                                                      \
             *has_err = -1;                                                     \
@@ -41,6 +48,7 @@ static char *choose_ ## suffix (OutputFilter *ofilter,int *has_err)            \
         }                                                                      \
         len = avio_close_dyn_buf(s, &ret);                                     \
         ret[len - 1] = 0;                                                      \
+        filter_cache_put_formats(ofilter->ost->enc, kind, 0, (char *)ret);     \
         return ret;                                                            \
     } else                                                                     \
         return NULL;                                                           \
@@ -50,39 +58,18 @@ static char *choose_ ## suffix (OutputFilter *ofilter,int *has_err)            \
 //                  GET_PIX_FMT_NAME)
 
 DEF_CHOOSE_FORMAT(sample_fmts, enum AVSampleFormat, format, formats,
-                  AV_SAMPLE_FMT_NONE, GET_SAMPLE_FMT_NAME)
+                  AV_SAMPLE_FMT_NONE, GET_SAMPLE_FMT_NAME, FILTER_FORMAT_SAMPLE_FMTS)
 
 DEF_CHOOSE_FORMAT(sample_rates, int, sample_rate, sample_rates, 0,
-                  GET_SAMPLE_RATE_NAME)
+                  GET_SAMPLE_RATE_NAME, FILTER_FORMAT_SAMPLE_RATES)
 
 DEF_CHOOSE_FORMAT(channel_layouts, uint64_t, channel_layout, channel_layouts, 0,
-                  GET_CH_LAYOUT_NAME)
+                  GET_CH_LAYOUT_NAME, FILTER_FORMAT_CHANNEL_LAYOUTS)
 
-static char *describe_filter_link(FilterGraph *fg, AVFilterInOut *inout, int in,int *has_error)
-{
-    AVFilterContext *ctx = inout->filter_ctx;
-    AVFilterPad *pads = in ? ctx->input_pads  : ctx->output_pads;
-    int       nb_pads = in ? ctx->nb_inputs   : ctx->nb_outputs;
-    AVIOContext *pb;
-    uint8_t *res = NULL;
-
-    if (avio_open_dyn_buf(&pb) < 0){
-//        exit_program(1);
-        *has_error = 1;
-        return NULL;
-    }
-    avio_printf(pb, "%s", ctx->filter->name);
-    if (nb_pads > 1)
-        avio_printf(pb, ":%s", avfilter_pad_get_name(pads, inout->pad_idx));
-    avio_w8(pb, 0);
-    avio_close_dyn_buf(pb, &res);
-    return res;
-}
-
-static int init_input_filter(FilterGraph *fg, AVFilterInOut *in,RunContext *run_context)
+static int init_input_filter(FilterGraph *fg, const FilterPadTemplate *in,RunContext *run_context)
 {
     InputStream *ist = NULL;
-    enum AVMediaType type = avfilter_pad_get_type(in->filter_ctx->input_pads, in->pad_idx);
+    enum AVMediaType type = in->type;
     int i;
 
     char * trace_id = run_context->trace_id;
@@ -94,11 +81,11 @@ static int init_input_filter(FilterGraph *fg, AVFilterInOut *in,RunContext *run_
         return -1;
     }
 
-    if (in->name) {
+    if (in->label) {
         AVFormatContext *s;
         AVStream       *st = NULL;
         char *p;
-        int file_idx = strtol(in->name, &p, 0);
+        int file_idx = strtol(in->label, &p, 0);
 
         if (file_idx < 0 || file_idx >= run_context->option_input.nb_input_files) {
             av_log(NULL, AV_LOG_FATAL, "tid=%s,Invalid file index %d in filtergraph description %s.\n",
@@ -144,7 +131,7 @@ static int init_input_filter(FilterGraph *fg, AVFilterInOut *in,RunContext *run_
         if (i == run_context->option_input.nb_input_streams) {
             av_log(NULL, AV_LOG_FATAL, "tid=%s,Cannot find a matching stream for "
                                        "unlabeled input pad %d on filter %s\n", trace_id,in->pad_idx,
-                   in->filter_ctx->name);
+                   in->filter_name);
 //            exit_program(1);
             return -1;
         }
@@ -168,9 +155,8 @@ static int init_input_filter(FilterGraph *fg, AVFilterInOut *in,RunContext *run_
     fg->inputs[fg->nb_inputs - 1]->graph = fg;
     fg->inputs[fg->nb_inputs - 1]->format = -1;
     fg->inputs[fg->nb_inputs - 1]->type = ist->st->codecpar->codec_type;
-    has_err = 0;
-    fg->inputs[fg->nb_inputs - 1]->name = describe_filter_link(fg, in, 1,&has_err);
-    if(has_err < 0){
+    fg->inputs[fg->nb_inputs - 1]->name = (uint8_t *)av_strdup(in->link_name);
+    if (!fg->inputs[fg->nb_inputs - 1]->name){
         return -1;
     }
 
@@ -187,13 +173,18 @@ static int init_input_filter(FilterGraph *fg, AVFilterInOut *in,RunContext *run_
         return  -1;
     }
     ist->filters[ist->nb_filters - 1] = fg->inputs[fg->nb_inputs - 1];
+    return 0;
 }
 
-int init_complex_filtergraph(RunContext *run_context,FilterGraph *fg)
+static int probe_filtergraph_template(const char *graph_desc, FilterGraphTemplate *tpl)
 {
-    AVFilterInOut *inputs, *outputs, *cur;
+    AVFilterInOut *inputs = NULL, *outputs = NULL;
     AVFilterGraph *graph;
-    int ret = 0;
+    int ret;
+
+    ret = filter_cache_get_template(graph_desc, tpl);
+    if (ret != 0)
+        return ret;
 
     /* this graph is only used for determining the kinds of inputs
      * and outputs we have, and is discarded on exit from this function */
@@ -202,49 +193,76 @@ int init_complex_filtergraph(RunContext *run_context,FilterGraph *fg)
         return AVERROR(ENOMEM);
     graph->nb_threads = 1;
 
-    ret = avfilter_graph_parse2(graph, fg->graph_desc, &inputs, &outputs);
+    ret = avfilter_graph_parse2(graph, graph_desc, &inputs, &outputs);
+    if (ret < 0)
+        goto fail;
+
+    ret = filter_template_from_inouts(tpl, inputs, outputs);
     if (ret < 0)
         goto fail;
+    // a failed insert only costs the next job another parse
+    filter_cache_put_template(graph_desc, tpl);
 
-    for (cur = inputs; cur; cur = cur->next){
-        ret = init_input_filter(fg, cur,run_context);
+    fail:
+    avfilter_inout_free(&inputs);
+    avfilter_inout_free(&outputs);
+    avfilter_graph_free(&graph);
+    return ret;
+}
+
+int init_complex_filtergraph(RunContext *run_context,FilterGraph *fg)
+{
+    FilterGraphTemplate tpl;
+    int ret, i;
+
+    ret = probe_filtergraph_template(fg->graph_desc, &tpl);
+    if (ret < 0)
+        return ret;
+
+    for (i = 0; i < tpl.nb_inputs; i++){
+        ret = init_input_filter(fg, &tpl.inputs[i],run_context);
         if (ret < 0){
-            // 不用跳转到fail,直接返回，资源统一释放
-            return -1;
+            goto fail;
         }
     }
 
-    for (cur = outputs; cur;) {
+    for (i = 0; i < tpl.nb_outputs; i++) {
+        const FilterPadTemplate *out = &tpl.outputs[i];
+        OutputFilter *ofilter;
         int has_err = 0;
         GROW_ARRAY(run_context->trace_id,fg->outputs, fg->nb_outputs,has_err);
         if(has_err<0){
 //            exit_program(1);
-            return -1;
+            ret = -1;
+            goto fail;
         }
-        fg->outputs[fg->nb_outputs - 1] = av_mallocz(sizeof(*fg->outputs[0]));
-        if (!fg->outputs[fg->nb_outputs - 1]){
-
+        ofilter = fg->outputs[fg->nb_outputs - 1] = av_mallocz(sizeof(*fg->outputs[0]));
+        if (!ofilter){
 //            exit_program(1);
-            return -1;
+            ret = -1;
+            goto fail;
         }
 
-        fg->outputs[fg->nb_outputs - 1]->graph   = fg;
-        fg->outputs[fg->nb_outputs - 1]->out_tmp = cur;
-        fg->outputs[fg->nb_outputs - 1]->type    = avfilter_pad_get_type(cur->filter_ctx->output_pads,
-                                                                         cur->pad_idx);
-        has_err = 0;
-        fg->outputs[fg->nb_outputs - 1]->name = describe_filter_link(fg, cur, 0,&has_err);
-        if(has_err){
-            //            exit_program(1);
-            return -1;
+        ofilter->graph = fg;
+        ofilter->type  = out->type;
+        /* only the label is looked at while mapping outputs, the pad itself
+         * is resolved again when the real graph is configured */
+        ofilter->out_tmp = avfilter_inout_alloc();
+        ofilter->name = (uint8_t *)av_strdup(out->link_name);
+        if (!ofilter->out_tmp || !ofilter->name){
+            ret = AVERROR(ENOMEM);
+            goto fail;
+        }
+        ofilter->out_tmp->pad_idx = out->pad_idx;
+        if (out->label && !(ofilter->out_tmp->name = av_strdup(out->label))){
+            ret = AVERROR(ENOMEM);
+            goto fail;
         }
-        cur = cur->next;
-        fg->outputs[fg->nb_outputs - 1]->out_tmp->next = NULL;
     }
+    ret = 0;
 
     fail:
-    avfilter_inout_free(&inputs);
-    avfilter_graph_free(&graph);
+    filter_template_uninit(&tpl);
     return ret;
 }
 
@@ -344,6 +362,8 @@ static int sub2video_prepare(InputStream *ist, InputFilter *ifilter,RunContext *
         return AVERROR(ENOMEM);
     ist->sub2video.last_pts = INT64_MIN;
     ist->sub2video.end_pts  = INT64_MIN;
+    ist->sub2video.empty    = 0;
+    ist->sub2video.bypassed = 0;
 
     /* sub2video structure has been (re-)initialized.
        Mark it as such so that the system will be
@@ -685,6 +705,7 @@ static void cleanup_filtergraph(FilterGraph *fg)
         fg->outputs[i]->filter = (AVFilterContext *)NULL;
     for (i = 0; i < fg->nb_inputs; i++)
         fg->inputs[i]->filter = (AVFilterContext *)NULL;
+    filter_pool_detach(fg);
     avfilter_graph_free(&fg->graph);
 }
 
@@ -764,6 +785,10 @@ static char *choose_pix_fmts(RunContext *run_context,OutputFilter *ofilter,int *
         AVIOContext *s = NULL;
         uint8_t *ret;
         int len;
+        int unofficial = ost->enc_ctx->strict_std_compliance <= FF_COMPLIANCE_UNOFFICIAL;
+
+        if ((ret = (uint8_t *)filter_cache_get_formats(ost->enc, FILTER_FORMAT_PIX_FMTS, unofficial)))
+            return ret;
 
         if (avio_open_dyn_buf(&s) < 0){
 //            exit_program(1);
@@ -772,7 +797,7 @@ static char *choose_pix_fmts(RunContext *run_context,OutputFilter *ofilter,int *
         }
 
         p = ost->enc->pix_fmts;
-        if (ost->enc_ctx->strict_std_compliance <= FF_COMPLIANCE_UNOFFICIAL) {
+        if (unofficial) {
             p = get_compliance_unofficial_pix_fmts(ost->enc_ctx->codec_id, p);
         }
 
@@ -782,6 +807,7 @@ static char *choose_pix_fmts(RunContext *run_context,OutputFilter *ofilter,int *
         }
         len = avio_close_dyn_buf(s, &ret);
         ret[len - 1] = 0;
+        filter_cache_put_formats(ost->enc, FILTER_FORMAT_PIX_FMTS, unofficial, (char *)ret);
         return ret;
     } else
         return NULL;
@@ -1088,6 +1114,11 @@ int configure_filtergraph(RunContext *run_context,FilterGraph *fg)
         fg->graph->nb_threads = run_context->filter_complex_nbthreads;
     }
 
+    /* auto thread count: borrow slices from the shared pool instead of
+     * starting a private pool of nb_cpus threads for every graph */
+    if (!fg->graph->nb_threads && (ret = filter_pool_attach(fg)) < 0)
+        goto fail;
+
     if ((ret = avfilter_graph_parse2(fg->graph, graph_desc, &inputs, &outputs)) < 0)
         goto fail;
     ret = hw_device_setup_for_filter(run_context,fg);
@@ -1178,6 +1209,7 @@ int configure_filtergraph(RunContext *run_context,FilterGraph *fg)
         while (av_fifo_size(fg->inputs[i]->frame_queue)) {
             AVFrame *tmp;
             av_fifo_generic_read(fg->inputs[i]->frame_queue, &tmp, sizeof(tmp), NULL);
+            job_mem_release(run_context, job_mem_frame_size(tmp));
             ret = av_buffersrc_add_frame(fg->inputs[i]->filter, tmp);
             av_frame_free(&tmp);
             if (ret < 0)
@@ -0,0 +1,295 @@
+//
+// Created by hexiufeng on 2026/10/19.
+//
+
+#include "filter_cache.h"
+#include <libavutil/avstring.h>
+#include <libavutil/mem.h>
+
+#define FILTER_CACHE_BUCKETS 64
+
+typedef struct TemplateEntry {
+    char *graph_desc;
+    FilterGraphTemplate tpl;
+    struct TemplateEntry *next;
+} TemplateEntry;
+
+typedef struct FormatsEntry {
+    const AVCodec *enc;
+    enum FilterFormatKind kind;
+    int unofficial;
+    char *list;
+    struct FormatsEntry *next;
+} FormatsEntry;
+
+static pthread_mutex_t cache_lock = PTHREAD_MUTEX_INITIALIZER;
+static TemplateEntry *template_buckets[FILTER_CACHE_BUCKETS];
+static int nb_templates;
+static FormatsEntry *formats_buckets[FILTER_CACHE_BUCKETS];
+static int nb_formats;
+
+static unsigned str_hash(const char *s)
+{
+    unsigned h = 5381;
+    while (*s)
+        h = h * 33 + (unsigned char)*s++;
+    return h;
+}
+
+static unsigned formats_hash(const AVCodec *enc, enum FilterFormatKind kind, int unofficial)
+{
+    uintptr_t p = (uintptr_t)enc;
+    return (unsigned)((p >> 4) ^ (p >> 12)) * 31 + kind * 2 + !!unofficial;
+}
+
+static char *describe_pad(AVFilterInOut *inout, int in)
+{
+    AVFilterContext *ctx = inout->filter_ctx;
+    AVFilterPad *pads = in ? ctx->input_pads : ctx->output_pads;
+    int nb_pads = in ? ctx->nb_inputs : ctx->nb_outputs;
+
+    if (nb_pads > 1)
+        return av_asprintf("%s:%s", ctx->filter->name, avfilter_pad_get_name(pads, inout->pad_idx));
+    return av_strdup(ctx->filter->name);
+}
+
+static void pad_uninit(FilterPadTemplate *pad)
+{
+    av_freep(&pad->label);
+    av_freep(&pad->link_name);
+    av_freep(&pad->filter_name);
+}
+
+static int pad_copy(FilterPadTemplate *dst, const FilterPadTemplate *src)
+{
+    dst->type = src->type;
+    dst->pad_idx = src->pad_idx;
+    dst->label = src->label ? av_strdup(src->label) : NULL;
+    dst->link_name = av_strdup(src->link_name);
+    dst->filter_name = av_strdup(src->filter_name);
+    if ((src->label && !dst->label) || !dst->link_name || !dst->filter_name) {
+        pad_uninit(dst);
+        return AVERROR(ENOMEM);
+    }
+    return 0;
+}
+
+static int pads_from_inouts(FilterPadTemplate **pads, int *nb_pads, AVFilterInOut *list, int in)
+{
+    AVFilterInOut *cur;
+    int n = 0, i;
+
+    for (cur = list; cur; cur = cur->next)
+        n++;
+    *nb_pads = 0;
+    if (!n)
+        return 0;
+    if (!(*pads = av_mallocz_array(n, sizeof(**pads))))
+        return AVERROR(ENOMEM);
+
+    for (cur = list, i = 0; cur; cur = cur->next, i++) {
+        FilterPadTemplate *pad = &(*pads)[i];
+        pad->type = in ? avfilter_pad_get_type(cur->filter_ctx->input_pads, cur->pad_idx) :
+                         avfilter_pad_get_type(cur->filter_ctx->output_pads, cur->pad_idx);
+        pad->pad_idx = cur->pad_idx;
+        pad->label = cur->name ? av_strdup(cur->name) : NULL;
+        pad->link_name = describe_pad(cur, in);
+        pad->filter_name = av_strdup(cur->filter_ctx->name);
+        *nb_pads = i + 1;
+        if ((cur->name && !pad->label) || !pad->link_name || !pad->filter_name)
+            return AVERROR(ENOMEM);
+    }
+    return 0;
+}
+
+int filter_template_from_inouts(FilterGraphTemplate *tpl, AVFilterInOut *inputs, AVFilterInOut *outputs)
+{
+    int ret;
+
+    memset(tpl, 0, sizeof(*tpl));
+    if ((ret = pads_from_inouts(&tpl->inputs, &tpl->nb_inputs, inputs, 1)) < 0 ||
+        (ret = pads_from_inouts(&tpl->outputs, &tpl->nb_outputs, outputs, 0)) < 0) {
+        filter_template_uninit(tpl);
+        return ret;
+    }
+    return 0;
+}
+
+void filter_template_uninit(FilterGraphTemplate *tpl)
+{
+    int i;
+    for (i = 0; i < tpl->nb_inputs; i++)
+        pad_uninit(&tpl->inputs[i]);
+    for (i = 0; i < tpl->nb_outputs; i++)
+        pad_uninit(&tpl->outputs[i]);
+    av_freep(&tpl->inputs);
+    av_freep(&tpl->outputs);
+    tpl->nb_inputs = tpl->nb_outputs = 0;
+}
+
+static int template_copy(FilterGraphTemplate *dst, const FilterGraphTemplate *src)
+{
+    int i, ret;
+
+    memset(dst, 0, sizeof(*dst));
+    if (src->nb_inputs && !(dst->inputs = av_mallocz_array(src->nb_inputs, sizeof(*dst->inputs))))
+        goto fail;
+    if (src->nb_outputs && !(dst->outputs = av_mallocz_array(src->nb_outputs, sizeof(*dst->outputs))))
+        goto fail;
+    for (i = 0; i < src->nb_inputs; i++) {
+        if ((ret = pad_copy(&dst->inputs[i], &src->inputs[i])) < 0)
+            goto fail;
+        dst->nb_inputs++;
+    }
+    for (i = 0; i < src->nb_outputs; i++) {
+        if ((ret = pad_copy(&dst->outputs[i], &src->outputs[i])) < 0)
+            goto fail;
+        dst->nb_outputs++;
+    }
+    return 0;
+
+    fail:
+    filter_template_uninit(dst);
+    return AVERROR(ENOMEM);
+}
+
+static void clear_templates(void)
+{
+    int i;
+    for (i = 0; i < FILTER_CACHE_BUCKETS; i++) {
+        TemplateEntry *e = template_buckets[i];
+        while (e) {
+            TemplateEntry *next = e->next;
+            filter_template_uninit(&e->tpl);
+            av_free(e->graph_desc);
+            av_free(e);
+            e = next;
+        }
+        template_buckets[i] = NULL;
+    }
+    nb_templates = 0;
+}
+
+static void clear_formats(void)
+{
+    int i;
+    for (i = 0; i < FILTER_CACHE_BUCKETS; i++) {
+        FormatsEntry *e = formats_buckets[i];
+        while (e) {
+            FormatsEntry *next = e->next;
+            av_free(e->list);
+            av_free(e);
+            e = next;
+        }
+        formats_buckets[i] = NULL;
+    }
+    nb_formats = 0;
+}
+
+int filter_cache_get_template(const char *graph_desc, FilterGraphTemplate *tpl)
+{
+    TemplateEntry *e;
+    int ret = 0;
+
+    pthread_mutex_lock(&cache_lock);
+    for (e = template_buckets[str_hash(graph_desc) % FILTER_CACHE_BUCKETS]; e; e = e->next) {
+        if (!strcmp(e->graph_desc, graph_desc)) {
+            ret = template_copy(tpl, &e->tpl);
+            if (ret >= 0)
+                ret = 1;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&cache_lock);
+    return ret;
+}
+
+int filter_cache_put_template(const char *graph_desc, const FilterGraphTemplate *tpl)
+{
+    unsigned bucket = str_hash(graph_desc) % FILTER_CACHE_BUCKETS;
+    TemplateEntry *e;
+    int ret = 0;
+
+    pthread_mutex_lock(&cache_lock);
+    for (e = template_buckets[bucket]; e; e = e->next) {
+        if (!strcmp(e->graph_desc, graph_desc))
+            goto end;
+    }
+    // generated descriptions (with per-job labels or values) would grow the table forever,
+    // start over instead of tracking recency
+    if (nb_templates >= FILTER_CACHE_MAX_TEMPLATES)
+        clear_templates();
+
+    if (!(e = av_mallocz(sizeof(*e))) || !(e->graph_desc = av_strdup(graph_desc))) {
+        av_freep(&e);
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    if ((ret = template_copy(&e->tpl, tpl)) < 0) {
+        av_free(e->graph_desc);
+        av_free(e);
+        goto end;
+    }
+    e->next = template_buckets[bucket];
+    template_buckets[bucket] = e;
+    nb_templates++;
+
+    end:
+    pthread_mutex_unlock(&cache_lock);
+    return ret;
+}
+
+char *filter_cache_get_formats(const AVCodec *enc, enum FilterFormatKind kind, int unofficial)
+{
+    FormatsEntry *e;
+    char *list = NULL;
+
+    pthread_mutex_lock(&cache_lock);
+    for (e = formats_buckets[formats_hash(enc, kind, unofficial) % FILTER_CACHE_BUCKETS]; e; e = e->next) {
+        if (e->enc == enc && e->kind == kind && e->unofficial == !!unofficial) {
+            list = av_strdup(e->list);
+            break;
+        }
+    }
+    pthread_mutex_unlock(&cache_lock);
+    return list;
+}
+
+int filter_cache_put_formats(const AVCodec *enc, enum FilterFormatKind kind, int unofficial, const char *list)
+{
+    unsigned bucket = formats_hash(enc, kind, unofficial) % FILTER_CACHE_BUCKETS;
+    FormatsEntry *e;
+    int ret = 0;
+
+    pthread_mutex_lock(&cache_lock);
+    for (e = formats_buckets[bucket]; e; e = e->next) {
+        if (e->enc == enc && e->kind == kind && e->unofficial == !!unofficial)
+            goto end;
+    }
+    if (nb_formats >= FILTER_CACHE_MAX_FORMATS)
+        clear_formats();
+
+    if (!(e = av_mallocz(sizeof(*e))) || !(e->list = av_strdup(list))) {
+        av_freep(&e);
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    e->enc = enc;
+    e->kind = kind;
+    e->unofficial = !!unofficial;
+    e->next = formats_buckets[bucket];
+    formats_buckets[bucket] = e;
+    nb_formats++;
+
+    end:
+    pthread_mutex_unlock(&cache_lock);
+    return ret;
+}
+
+void filter_cache_clear(void)
+{
+    pthread_mutex_lock(&cache_lock);
+    clear_templates();
+    clear_formats();
+    pthread_mutex_unlock(&cache_lock);
+}
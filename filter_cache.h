@@ -0,0 +1,59 @@
+//
+// Created by hexiufeng on 2026/10/19.
+//
+
+#ifndef RUN_FFMPEG_FILTER_CACHE_H
+#define RUN_FFMPEG_FILTER_CACHE_H
+
+#include "cmd_options.h"
+
+#define FILTER_CACHE_MAX_TEMPLATES 256
+#define FILTER_CACHE_MAX_FORMATS   512
+
+enum FilterFormatKind {
+    FILTER_FORMAT_PIX_FMTS,
+    FILTER_FORMAT_SAMPLE_FMTS,
+    FILTER_FORMAT_SAMPLE_RATES,
+    FILTER_FORMAT_CHANNEL_LAYOUTS,
+};
+
+/* one open pad of a parsed graph description, detached from any AVFilterGraph */
+typedef struct FilterPadTemplate {
+    char *label;            // link label ("0:a", "out"...), NULL when unlabeled
+    char *link_name;        // same string describe_filter_link() builds
+    char *filter_name;      // instance name of the filter owning the pad
+    enum AVMediaType type;
+    int pad_idx;
+} FilterPadTemplate;
+
+/*
+ * topology of a validated graph description. AVFilterGraph instances carry
+ * per-job state and cannot be shared, but the open inputs/outputs of a
+ * description never change, so jobs with the same -filter_complex reuse them
+ * instead of parsing a throwaway graph.
+ */
+typedef struct FilterGraphTemplate {
+    FilterPadTemplate *inputs;
+    int nb_inputs;
+    FilterPadTemplate *outputs;
+    int nb_outputs;
+} FilterGraphTemplate;
+
+int filter_template_from_inouts(FilterGraphTemplate *tpl, AVFilterInOut *inputs, AVFilterInOut *outputs);
+void filter_template_uninit(FilterGraphTemplate *tpl);
+
+/* return 1 and fill tpl with a private copy on hit, 0 on miss, <0 on error */
+int filter_cache_get_template(const char *graph_desc, FilterGraphTemplate *tpl);
+int filter_cache_put_template(const char *graph_desc, const FilterGraphTemplate *tpl);
+
+/*
+ * format lists built from an encoder's supported formats ("yuv420p|nv12|...").
+ * unofficial is set when the list went through the strict -2 mjpeg/ljpeg override.
+ * returns an av_malloc'ed copy, or NULL on miss.
+ */
+char *filter_cache_get_formats(const AVCodec *enc, enum FilterFormatKind kind, int unofficial);
+int filter_cache_put_formats(const AVCodec *enc, enum FilterFormatKind kind, int unofficial, const char *list);
+
+void filter_cache_clear(void);
+
+#endif //RUN_FFMPEG_FILTER_CACHE_H
@@ -0,0 +1,57 @@
+//
+// Created by hexiufeng on 2026/10/19.
+//
+
+#include "filter_pool.h"
+#include "worker_pool.h"
+
+typedef struct FilterSlices {
+    AVFilterContext *ctx;
+    avfilter_action_func *func;
+    void *arg;
+    int *rets;
+} FilterSlices;
+
+static atomic_int nb_graphs;     // graphs currently attached
+
+static void run_slice(WorkerBatch *b, int jobnr)
+{
+    FilterSlices *s = b->priv;
+    int ret = s->func(s->ctx, s->arg, jobnr, b->nb_jobs);
+    if (s->rets)
+        s->rets[jobnr] = ret;
+}
+
+static int pool_execute(AVFilterContext *ctx, avfilter_action_func *func, void *arg,
+                        int *ret, int nb_jobs)
+{
+    FilterSlices s = { .ctx = ctx, .func = func, .arg = arg, .rets = ret };
+    WorkerBatch b  = { .run = run_slice, .priv = &s, .nb_jobs = nb_jobs };
+
+    worker_pool_execute(&b);
+    return 0;
+}
+
+int filter_pool_attach(FilterGraph *fg)
+{
+    int nb_workers = worker_pool_start();
+    int share;
+
+    if (nb_workers <= 0)
+        return nb_workers;
+
+    share = FFMAX(1, nb_workers / (atomic_fetch_add(&nb_graphs, 1) + 1));
+
+    fg->graph->execute    = pool_execute;
+    fg->graph->nb_threads = share + 1;
+    fg->pool_attached     = 1;
+    return 0;
+}
+
+void filter_pool_detach(FilterGraph *fg)
+{
+    if (!fg->pool_attached)
+        return;
+    atomic_fetch_sub(&nb_graphs, 1);
+    fg->pool_attached = 0;
+}
@@ -0,0 +1,21 @@
+//
+// Created by hexiufeng on 2026/10/19.
+//
+
+#ifndef RUN_FFMPEG_FILTER_POOL_H
+#define RUN_FFMPEG_FILTER_POOL_H
+
+#include "cmd_options.h"
+
+/*
+ * filter graphs whose thread count is left to auto (-filter_threads/-filter_complex_threads 0)
+ * hand their slice work to the shared worker pool through AVFilterGraph.execute
+ * instead of spawning their own threads.
+ */
+
+/* must be called right after avfilter_graph_alloc(), before any filter is added */
+int filter_pool_attach(FilterGraph *fg);
+/* must be called before fg->graph is freed */
+void filter_pool_detach(FilterGraph *fg);
+
+#endif //RUN_FFMPEG_FILTER_POOL_H
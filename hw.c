@@ -3,10 +3,21 @@
 //
 #include <libavfilter/buffersink.h>
 #include <libavutil/pixdesc.h>
+#include <libavutil/imgutils.h>
+#include <libavutil/hwcontext.h>
 #if CONFIG_QSV
 #include <libavutil/hwcontext_qsv.h>
 #endif
 #include "hw.h"
+#include "hw_registry.h"
+
+static int hw_device_create(RunContext *run_context, AVBufferRef **device_ref, enum AVHWDeviceType type,
+                            const char *device, AVDictionary *opts)
+{
+    if (run_context->hw_device_cache)
+        return hw_registry_acquire(type, device, opts, device_ref);
+    return av_hwdevice_ctx_create(device_ref, type, device, opts, 0);
+}
 
 static HWDevice *hw_device_get_by_type(RunContext *run_context,enum AVHWDeviceType type)
 {
@@ -129,8 +140,8 @@ int hw_device_init_from_string(RunContext *run_context,const char *arg, HWDevice
 
     if (!*p) {
         // New device with no parameters.
-        err = av_hwdevice_ctx_create(&device_ref, type,
-                                     NULL, NULL, 0);
+        err = hw_device_create(run_context, &device_ref, type,
+                               NULL, NULL);
         if (err < 0)
             goto fail;
 
@@ -153,9 +164,9 @@ int hw_device_init_from_string(RunContext *run_context,const char *arg, HWDevice
             }
         }
 
-        err = av_hwdevice_ctx_create(&device_ref, type,
-                                     q ? device : p[0] ? p : NULL,
-                                     options, 0);
+        err = hw_device_create(run_context, &device_ref, type,
+                               q ? device : p[0] ? p : NULL,
+                               options);
         if (err < 0)
             goto fail;
 
@@ -225,7 +236,7 @@ static int hw_device_init_from_type(RunContext *run_context,enum AVHWDeviceType
         goto fail;
     }
 
-    err = av_hwdevice_ctx_create(&device_ref, type, device, NULL, 0);
+    err = hw_device_create(run_context, &device_ref, type, device, NULL);
     if (err < 0) {
         av_log(NULL, AV_LOG_ERROR,
                "tid=%s,Device creation failed: %d.\n", run_context->trace_id,err);
@@ -448,45 +459,78 @@ int hw_device_setup_for_encode(RunContext *run_context,OutputStream *ost)
 }
 
 
+/*
+ * back output with a buffer of the stream's download pool, sized like the hw surfaces.
+ * returns 0 when the caller should let av_hwframe_transfer_data() allocate instead.
+ */
+static int hwaccel_get_download_buffer(InputStream *ist, AVFrame *output, const AVFrame *input)
+{
+    AVHWFramesContext *frames = (AVHWFramesContext *)input->hw_frames_ctx->data;
+    enum AVPixelFormat format = output->format != AV_PIX_FMT_NONE ? output->format : frames->sw_format;
+
+    return download_pool_get(&ist->hwaccel_download_pool, output, format, frames->width, frames->height);
+}
+
 static int hwaccel_retrieve_data(AVCodecContext *avctx, AVFrame *input)
 {
     InputStream *ist = avctx->opaque;
-    AVFrame *output = NULL;
+    AVFrame *output;
     enum AVPixelFormat output_format = ist->hwaccel_output_format;
-    int err;
+    int err, pooled = 0;
 
     if (input->format == output_format) {
         // Nothing to do.
         return 0;
     }
 
-    output = av_frame_alloc();
-    if (!output)
-        return AVERROR(ENOMEM);
+    if (!ist->hwaccel_download_frame) {
+        ist->hwaccel_download_frame = av_frame_alloc();
+        if (!ist->hwaccel_download_frame)
+            return AVERROR(ENOMEM);
+    }
+    output = ist->hwaccel_download_frame;
 
     output->format = output_format;
 
+    if (input->hw_frames_ctx) {
+        pooled = hwaccel_get_download_buffer(ist, output, input);
+        if (pooled < 0)
+            return pooled;
+    }
+
     err = av_hwframe_transfer_data(output, input, 0);
+    if (err < 0 && pooled) {
+        /* some hwcontexts only download into buffers they allocate themselves */
+        av_log(avctx, AV_LOG_VERBOSE, "Download into a pooled frame failed, "
+                                      "falling back to per frame buffers.\n");
+        ist->hwaccel_download_pool.unpooled = 1;
+        av_frame_unref(output);
+        output->format = output_format;
+        pooled = 0;
+        err = av_hwframe_transfer_data(output, input, 0);
+    }
     if (err < 0) {
         av_log(avctx, AV_LOG_ERROR, "Failed to transfer data to "
                                     "output frame: %d.\n", err);
         goto fail;
     }
+    if (pooled) {
+        /* the surfaces may be padded, keep the size of the picture */
+        output->width  = input->width;
+        output->height = input->height;
+    }
 
     err = av_frame_copy_props(output, input);
-    if (err < 0) {
-        av_frame_unref(output);
+    if (err < 0)
         goto fail;
-    }
 
     av_frame_unref(input);
     av_frame_move_ref(input, output);
-    av_frame_free(&output);
 
     return 0;
 
     fail:
-    av_frame_free(&output);
+    av_frame_unref(output);
     return err;
 }
 
@@ -504,6 +548,7 @@ void hw_device_free_all(RunContext *run_context)
     int i;
     for (i = 0; i < run_context->nb_hw_devices; i++) {
         av_freep(&run_context->hw_devices[i]->name);
+        // devices from the registry only drop this job's reference and stay open
         av_buffer_unref(&run_context->hw_devices[i]->device_ref);
         av_freep(&run_context->hw_devices[i]);
     }
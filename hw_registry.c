@@ -0,0 +1,137 @@
+//
+// Created by hexiufeng on 2026/10/19.
+//
+
+#include "hw_registry.h"
+#include <pthread.h>
+#include <string.h>
+#include <libavutil/avstring.h>
+#include <libavutil/mem.h>
+
+typedef struct HWRegistryEntry {
+    char *key;
+    AVBufferRef *device_ref;    // the registry's own reference
+    struct HWRegistryEntry *next;
+} HWRegistryEntry;
+
+static pthread_mutex_t registry_lock = PTHREAD_MUTEX_INITIALIZER;
+static HWRegistryEntry *entries;
+
+static int create_device(AVBufferRef **device_ref, int type, const char *device,
+                         AVDictionary *opts, int flags)
+{
+    return av_hwdevice_ctx_create(device_ref, type, device, opts, flags);
+}
+
+static hw_device_create_fn create_fn = create_device;
+
+void hw_registry_set_create_fn(hw_device_create_fn fn)
+{
+    pthread_mutex_lock(&registry_lock);
+    create_fn = fn ? fn : create_device;
+    pthread_mutex_unlock(&registry_lock);
+}
+
+static char *make_key(enum AVHWDeviceType type, const char *device, AVDictionary *opts)
+{
+    const char *type_name = av_hwdevice_get_type_name(type);
+    char *opts_str = NULL, *key;
+
+    if (opts && av_dict_get_string(opts, &opts_str, '=', ',') < 0)
+        return NULL;
+    if (type_name)
+        key = av_asprintf("%s|%s|%s", type_name, device ? device : "", opts_str ? opts_str : "");
+    else
+        key = av_asprintf("#%d|%s|%s", type, device ? device : "", opts_str ? opts_str : "");
+    av_free(opts_str);
+    return key;
+}
+
+static HWRegistryEntry *find_entry(const char *key)
+{
+    HWRegistryEntry *e;
+    for (e = entries; e; e = e->next) {
+        if (!strcmp(e->key, key))
+            return e;
+    }
+    return NULL;
+}
+
+int hw_registry_acquire(enum AVHWDeviceType type, const char *device, AVDictionary *opts,
+                        AVBufferRef **device_ref)
+{
+    HWRegistryEntry *e;
+    AVBufferRef *created = NULL;
+    hw_device_create_fn create;
+    char *key;
+    int err;
+
+    *device_ref = NULL;
+    key = make_key(type, device, opts);
+    if (!key)
+        return AVERROR(ENOMEM);
+
+    pthread_mutex_lock(&registry_lock);
+    e = find_entry(key);
+    if (e) {
+        *device_ref = av_buffer_ref(e->device_ref);
+        pthread_mutex_unlock(&registry_lock);
+        av_free(key);
+        return *device_ref ? 0 : AVERROR(ENOMEM);
+    }
+    create = create_fn;
+    pthread_mutex_unlock(&registry_lock);
+
+    // opening a device can take tens of milliseconds, don't hold up other jobs meanwhile
+    err = create(&created, type, device, opts, 0);
+    if (err < 0) {
+        av_free(key);
+        return err;
+    }
+
+    pthread_mutex_lock(&registry_lock);
+    e = find_entry(key);
+    if (e) {
+        // another job opened the same device concurrently, keep the first one
+        av_buffer_unref(&created);
+        av_free(key);
+    } else if ((e = av_mallocz(sizeof(*e)))) {
+        e->key = key;
+        e->device_ref = created;
+        e->next = entries;
+        entries = e;
+    } else {
+        pthread_mutex_unlock(&registry_lock);
+        av_free(key);
+        // could not cache it, the job still gets a working device
+        *device_ref = created;
+        return 0;
+    }
+    *device_ref = av_buffer_ref(e->device_ref);
+    pthread_mutex_unlock(&registry_lock);
+
+    return *device_ref ? 0 : AVERROR(ENOMEM);
+}
+
+int hw_registry_flush(int only_idle)
+{
+    HWRegistryEntry **p, *e;
+    int nb_closed = 0;
+
+    pthread_mutex_lock(&registry_lock);
+    p = &entries;
+    while ((e = *p)) {
+        if (only_idle && av_buffer_get_ref_count(e->device_ref) > 1) {
+            p = &e->next;
+            continue;
+        }
+        *p = e->next;
+        // jobs still holding a reference keep the device alive until they are done
+        av_buffer_unref(&e->device_ref);
+        av_free(e->key);
+        av_free(e);
+        nb_closed++;
+    }
+    pthread_mutex_unlock(&registry_lock);
+    return nb_closed;
+}
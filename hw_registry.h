@@ -0,0 +1,32 @@
+//
+// Created by hexiufeng on 2026/10/19.
+//
+
+#ifndef RUN_FFMPEG_HW_REGISTRY_H
+#define RUN_FFMPEG_HW_REGISTRY_H
+
+#include <libavutil/buffer.h>
+#include <libavutil/dict.h>
+#include <libavutil/hwcontext.h>
+
+/*
+ * process-wide cache of hardware device contexts keyed by type + device string + options.
+ * jobs borrow a reference instead of opening the device again, the device itself stays
+ * open after the last job drops its reference until hw_registry_flush().
+ */
+
+/* type is an enum AVHWDeviceType, an int so the hook can be declared in run_ffmpeg.h */
+typedef int (*hw_device_create_fn)(AVBufferRef **device_ref, int type,
+                                   const char *device, AVDictionary *opts, int flags);
+
+/* replace av_hwdevice_ctx_create, e.g. with a stub that needs no gpu. NULL restores the default */
+void hw_registry_set_create_fn(hw_device_create_fn fn);
+
+/* *device_ref receives a new reference owned by the caller */
+int hw_registry_acquire(enum AVHWDeviceType type, const char *device, AVDictionary *opts,
+                        AVBufferRef **device_ref);
+
+/* close cached devices, only the ones no job references when only_idle is set. returns the number closed */
+int hw_registry_flush(int only_idle);
+
+#endif //RUN_FFMPEG_HW_REGISTRY_H
@@ -0,0 +1,207 @@
+//
+// Created by hexiufeng on 2026/10/19.
+//
+
+#include "input_queue.h"
+#include <limits.h>
+#include <pthread.h>
+#include <libavutil/common.h>
+#include <libavutil/error.h>
+#include <libavutil/fifo.h>
+#include <libavutil/mem.h>
+
+/* received packets between two depth decisions */
+#define WINDOW 32
+
+struct InputQueue {
+    AVFifoBuffer *fifo;
+    pthread_mutex_t lock;
+    pthread_cond_t cond_recv;
+    pthread_cond_t cond_send;
+    int err_send;
+    int err_recv;
+
+    int min_depth, max_depth;
+    int64_t max_bytes;
+    int64_t bytes;
+
+    /* current window */
+    int nb_recv;
+    int low_water;              // fewest packets queued at a receive
+    int send_stalled;
+    int recv_stalled;
+
+    InputQueueStats stats;
+};
+
+static int nb_queued(InputQueue *q)
+{
+    return av_fifo_size(q->fifo) / sizeof(AVPacket *);
+}
+
+static int is_full(InputQueue *q)
+{
+    int nb = nb_queued(q);
+    return nb >= q->stats.depth || (nb && q->bytes >= q->max_bytes);
+}
+
+static int set_depth(InputQueue *q, int depth)
+{
+    int space;
+
+    depth = av_clip(depth, q->min_depth, q->max_depth);
+    space = depth * sizeof(AVPacket *);
+    if (space > av_fifo_size(q->fifo) + av_fifo_space(q->fifo)) {
+        int ret = av_fifo_grow(q->fifo, space - av_fifo_size(q->fifo) - av_fifo_space(q->fifo));
+        if (ret < 0)
+            return ret;
+    }
+    q->stats.depth      = depth;
+    q->stats.peak_depth = FFMAX(q->stats.peak_depth, depth);
+    pthread_cond_broadcast(&q->cond_send);
+    return 0;
+}
+
+static void end_window(InputQueue *q)
+{
+    if (q->send_stalled && q->recv_stalled && q->bytes < q->max_bytes)
+        set_depth(q, q->stats.depth * 2);
+    else if (!q->send_stalled && q->low_water > q->stats.depth / 2)
+        set_depth(q, q->stats.depth / 2);
+
+    q->nb_recv      = 0;
+    q->low_water    = INT_MAX;
+    q->send_stalled = 0;
+    q->recv_stalled = 0;
+}
+
+int input_queue_alloc(InputQueue **pq, int depth, int min_depth, int max_depth, int64_t max_bytes)
+{
+    InputQueue *q;
+    int ret;
+
+    *pq = NULL;
+    q = av_mallocz(sizeof(*q));
+    if (!q)
+        return AVERROR(ENOMEM);
+    q->fifo = av_fifo_alloc(depth * sizeof(AVPacket *));
+    if (!q->fifo) {
+        av_free(q);
+        return AVERROR(ENOMEM);
+    }
+    if ((ret = pthread_mutex_init(&q->lock, NULL))) {
+        av_fifo_freep(&q->fifo);
+        av_free(q);
+        return AVERROR(ret);
+    }
+    pthread_cond_init(&q->cond_recv, NULL);
+    pthread_cond_init(&q->cond_send, NULL);
+    q->min_depth = FFMIN(min_depth, depth);
+    q->max_depth = FFMAX(max_depth, depth);
+    q->max_bytes = max_bytes;
+    q->low_water = INT_MAX;
+    q->stats.depth = q->stats.peak_depth = depth;
+    *pq = q;
+    return 0;
+}
+
+void input_queue_free(InputQueue **pq)
+{
+    InputQueue *q = *pq;
+
+    if (!q)
+        return;
+    while (av_fifo_size(q->fifo)) {
+        AVPacket *pkt;
+        av_fifo_generic_read(q->fifo, &pkt, sizeof(pkt), NULL);
+        av_packet_free(&pkt);
+    }
+    av_fifo_freep(&q->fifo);
+    pthread_cond_destroy(&q->cond_send);
+    pthread_cond_destroy(&q->cond_recv);
+    pthread_mutex_destroy(&q->lock);
+    av_freep(pq);
+}
+
+int input_queue_send(InputQueue *q, AVPacket *pkt, int nonblock)
+{
+    int ret = 0;
+
+    pthread_mutex_lock(&q->lock);
+    if (!q->err_send && is_full(q)) {
+        q->send_stalled = 1;
+        q->stats.nb_send_stalls++;
+        // a non blocking input loses data or falls behind when it waits, grow right away
+        if (nonblock && q->stats.depth < q->max_depth && q->bytes < q->max_bytes)
+            ret = set_depth(q, q->stats.depth * 2);
+    }
+    while (!ret && !q->err_send && is_full(q)) {
+        if (nonblock) {
+            ret = AVERROR(EAGAIN);
+            break;
+        }
+        pthread_cond_wait(&q->cond_send, &q->lock);
+    }
+    if (!ret && q->err_send)
+        ret = q->err_send;
+    if (!ret) {
+        av_fifo_generic_write(q->fifo, &pkt, sizeof(pkt), NULL);
+        q->bytes += pkt->size;
+        pthread_cond_signal(&q->cond_recv);
+    }
+    pthread_mutex_unlock(&q->lock);
+    return ret;
+}
+
+int input_queue_recv(InputQueue *q, AVPacket **pkt, int nonblock)
+{
+    int ret = 0;
+
+    pthread_mutex_lock(&q->lock);
+    q->low_water = FFMIN(q->low_water, nb_queued(q));
+    if (!q->err_recv && !av_fifo_size(q->fifo)) {
+        q->recv_stalled = 1;
+        q->stats.nb_recv_stalls++;
+    }
+    while (!q->err_recv && !av_fifo_size(q->fifo)) {
+        if (nonblock) {
+            ret = AVERROR(EAGAIN);
+            break;
+        }
+        pthread_cond_wait(&q->cond_recv, &q->lock);
+    }
+    if (!ret && !av_fifo_size(q->fifo))
+        ret = q->err_recv;
+    if (!ret) {
+        av_fifo_generic_read(q->fifo, pkt, sizeof(*pkt), NULL);
+        q->bytes -= (*pkt)->size;
+        if (q->min_depth < q->max_depth && ++q->nb_recv >= WINDOW)
+            end_window(q);
+        pthread_cond_signal(&q->cond_send);
+    }
+    pthread_mutex_unlock(&q->lock);
+    return ret;
+}
+
+void input_queue_set_err_send(InputQueue *q, int err)
+{
+    pthread_mutex_lock(&q->lock);
+    q->err_send = err;
+    pthread_cond_broadcast(&q->cond_send);
+    pthread_mutex_unlock(&q->lock);
+}
+
+void input_queue_set_err_recv(InputQueue *q, int err)
+{
+    pthread_mutex_lock(&q->lock);
+    q->err_recv = err;
+    pthread_cond_broadcast(&q->cond_recv);
+    pthread_mutex_unlock(&q->lock);
+}
+
+void input_queue_get_stats(InputQueue *q, InputQueueStats *stats)
+{
+    pthread_mutex_lock(&q->lock);
+    *stats = q->stats;
+    pthread_mutex_unlock(&q->lock);
+}
@@ -0,0 +1,49 @@
+//
+// Created by hexiufeng on 2026/10/19.
+//
+
+#ifndef RUN_FFMPEG_INPUT_QUEUE_H
+#define RUN_FFMPEG_INPUT_QUEUE_H
+
+#include <stdint.h>
+#include <libavcodec/packet.h>
+
+/*
+ * packet queue between an input thread and the transcode loop, a drop-in for
+ * AVThreadMessageQueue whose depth can change while the job runs.
+ * an adaptive queue looks at each window of received packets: when both sides had to
+ * wait in it the input is bursty and the depth doubles, when the queue never drained
+ * below half of its depth the reader is ahead anyway and the depth halves.
+ * a queue also stops accepting packets once it holds max_bytes.
+ */
+
+#define INPUT_QUEUE_MIN_DEPTH 2
+#define INPUT_QUEUE_MAX_DEPTH 1024
+#define INPUT_QUEUE_MAX_BYTES (64 << 20)
+
+typedef struct InputQueue InputQueue;
+
+typedef struct InputQueueStats {
+    int depth;                  // current depth
+    int peak_depth;
+    int64_t nb_send_stalls;     // the input thread found the queue full
+    int64_t nb_recv_stalls;     // the transcode loop found the queue empty
+} InputQueueStats;
+
+/* min_depth == max_depth gives a fixed size queue */
+int input_queue_alloc(InputQueue **q, int depth, int min_depth, int max_depth, int64_t max_bytes);
+/* frees the packets still queued */
+void input_queue_free(InputQueue **q);
+
+/* on success the queue owns *pkt. AVERROR(EAGAIN) when nonblock and the queue can't grow */
+int input_queue_send(InputQueue *q, AVPacket *pkt, int nonblock);
+/* queued packets are still returned after input_queue_set_err_recv() */
+int input_queue_recv(InputQueue *q, AVPacket **pkt, int nonblock);
+
+/* same meaning as av_thread_message_queue_set_err_send/recv */
+void input_queue_set_err_send(InputQueue *q, int err);
+void input_queue_set_err_recv(InputQueue *q, int err);
+
+void input_queue_get_stats(InputQueue *q, InputQueueStats *stats);
+
+#endif //RUN_FFMPEG_INPUT_QUEUE_H
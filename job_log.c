@@ -0,0 +1,164 @@
+//
+// Created by hexiufeng on 2026/10/19.
+//
+
+#include "job_log.h"
+#include <stdio.h>
+#include <stdatomic.h>
+#include <string.h>
+
+#define LINE_SIZE 1024
+
+typedef struct ThreadLog {
+    RunContext *job;
+    char line[LINE_SIZE];
+    int len;
+    int print_prefix;
+    int stream_index;           // of the context that started the line
+} ThreadLog;
+
+static _Thread_local ThreadLog thread_log = { .print_prefix = 1 };
+
+static _Atomic(JobLogSink) sink;
+static void *_Atomic sink_opaque;
+static atomic_int default_level = AV_LOG_INFO;
+
+static const char *level_name(int level)
+{
+    switch (level) {
+    case AV_LOG_PANIC:   return "panic";
+    case AV_LOG_FATAL:   return "fatal";
+    case AV_LOG_ERROR:   return "error";
+    case AV_LOG_WARNING: return "warning";
+    case AV_LOG_INFO:    return "info";
+    case AV_LOG_VERBOSE: return "verbose";
+    case AV_LOG_DEBUG:   return "debug";
+    default:             return "trace";
+    }
+}
+
+/* "tid=<trace_id>," at the start of line, which most messages of the library carry */
+static const char *skip_trace_id(const RunContext *job, const char *line)
+{
+    size_t len;
+
+    if (strncmp(line, "tid=", 4) || !job->trace_id)
+        return line;
+    len = strlen(job->trace_id);
+    if (strncmp(line + 4, job->trace_id, len) || line[4 + len] != ',')
+        return line;
+    return line + 4 + len + 1;
+}
+
+static void emit(RunContext *job, int level, int stream_index, const char *line)
+{
+    JobLogSink s = atomic_load(&sink);
+    const char *stage = atomic_load(&job->log_stage);
+
+    line = skip_trace_id(job, line);
+    if (s) {
+        s(atomic_load(&sink_opaque), level, job->trace_id, stage, stream_index, line);
+        return;
+    }
+    if (stream_index >= 0)
+        fprintf(stderr, "tid=%s stage=%s stream=%d level=%s %s", job->trace_id,
+                stage ? stage : "-", stream_index, level_name(level), line);
+    else
+        fprintf(stderr, "tid=%s stage=%s level=%s %s", job->trace_id,
+                stage ? stage : "-", level_name(level), line);
+}
+
+/* index in its file of the stream a decoder or encoder of job works for, -1 for other contexts */
+static int context_stream(const RunContext *job, void *avcl)
+{
+    int i;
+
+    if (!avcl || *(const AVClass **)avcl != avcodec_get_class())
+        return -1;
+    // looked up rather than read from opaque, lavfi and lavf open codecs of their own
+    for (i = 0; i < job->option_input.nb_input_streams; i++) {
+        InputStream *ist = job->option_input.input_streams[i];
+        if (ist->dec_ctx == avcl)
+            return ist->st->index;
+    }
+    for (i = 0; i < job->option_output.nb_output_streams; i++) {
+        OutputStream *ost = job->option_output.output_streams[i];
+        if (ost->enc_ctx == avcl)
+            return ost->index;
+    }
+    return -1;
+}
+
+static void log_callback(void *avcl, int level, const char *fmt, va_list vl)
+{
+    ThreadLog *t = &thread_log;
+    int n;
+
+    if (!t->job) {
+        av_log_default_callback(avcl, level, fmt, vl);
+        return;
+    }
+    if ((level & 0xff) > t->job->log_level)
+        return;
+
+    if (!t->len)
+        t->stream_index = context_stream(t->job, avcl);
+    // av_log may deliver a line in pieces, keep them until the newline
+    n = av_log_format_line2(avcl, level, fmt, vl, t->line + t->len, LINE_SIZE - t->len, &t->print_prefix);
+    if (n < 0)
+        return;
+    t->len = FFMIN(t->len + n, LINE_SIZE - 1);
+    if (t->len && (t->line[t->len - 1] == '\n' || t->len == LINE_SIZE - 1)) {
+        emit(t->job, level & 0xff, t->stream_index, t->line);
+        t->len = 0;
+    }
+}
+
+void job_log_init(void)
+{
+    av_log_set_callback(log_callback);
+}
+
+void job_log_set_sink(JobLogSink s, void *opaque)
+{
+    atomic_store(&sink_opaque, opaque);
+    atomic_store(&sink, s);
+}
+
+void job_log_set_default_level(int level)
+{
+    atomic_store(&default_level, level);
+}
+
+int job_log_default_level(void)
+{
+    return atomic_load(&default_level);
+}
+
+void job_log_enter(RunContext *run_context)
+{
+    thread_log.job = run_context;
+    thread_log.len = 0;
+    thread_log.print_prefix = 1;
+}
+
+void job_log_leave(void)
+{
+    if (thread_log.job && thread_log.len)
+        emit(thread_log.job, AV_LOG_INFO, thread_log.stream_index, thread_log.line);
+    thread_log.job = NULL;
+    thread_log.len = 0;
+}
+
+void job_log(RunContext *run_context, int level, int stream_index, const char *fmt, ...)
+{
+    char line[LINE_SIZE];
+    va_list vl;
+
+    if (level > run_context->log_level)
+        return;
+    va_start(vl, fmt);
+    vsnprintf(line, sizeof(line), fmt, vl);
+    va_end(vl);
+    emit(run_context, level, stream_index, line);
+}
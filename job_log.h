@@ -0,0 +1,37 @@
+//
+// Created by hexiufeng on 2026/10/19.
+//
+
+#ifndef RUN_FFMPEG_JOB_LOG_H
+#define RUN_FFMPEG_JOB_LOG_H
+
+#include "cmd_options.h"
+#include "run_ffmpeg.h"
+
+/*
+ * logs of a job go to one sink with trace_id/stage/stream as separate fields.
+ * a thread bound to a job by job_log_enter() also routes the av_log() calls of
+ * libav* to it, filtered by the job's level before anything is formatted.
+ * lines are assembled in a per-thread buffer, so concurrent jobs never interleave.
+ * the stream of a line logged by a decoder or encoder is its index in its file, and the
+ * "tid=<trace_id>," the library's own messages start with is cut, the sink has it already.
+ */
+
+/* installs the av_log callback, called once from init_ffmpeg() */
+void job_log_init(void);
+
+void job_log_set_sink(JobLogSink sink, void *opaque);
+void job_log_set_default_level(int level);
+int job_log_default_level(void);
+
+void job_log_enter(RunContext *run_context);
+void job_log_leave(void);
+
+static inline void job_log_stage(RunContext *run_context, const char *stage)
+{
+    atomic_store(&run_context->log_stage, stage);
+}
+
+void job_log(RunContext *run_context, int level, int stream_index, const char *fmt, ...) av_printf_format(4, 5);
+
+#endif //RUN_FFMPEG_JOB_LOG_H
@@ -0,0 +1,39 @@
+//
+// Created by hexiufeng on 2026/10/19.
+//
+
+#include "job_mem.h"
+
+int job_mem_charge(RunContext *run_context, int64_t size)
+{
+    int64_t used = atomic_fetch_add(&run_context->mem_used, size) + size;
+    int_fast64_t peak = atomic_load(&run_context->mem_peak);
+
+    if (run_context->mem_limit > 0 && used > run_context->mem_limit) {
+        atomic_fetch_sub(&run_context->mem_used, size);
+        if (!atomic_exchange(&run_context->mem_exceeded, 1))
+            av_log(NULL, AV_LOG_ERROR, "tid=%s,job memory limit of %"PRId64" bytes reached, failing the job\n",
+                   run_context->trace_id, run_context->mem_limit);
+        return AVERROR(ENOMEM);
+    }
+    while (used > peak && !atomic_compare_exchange_weak(&run_context->mem_peak, &peak, used))
+        ;
+    return 0;
+}
+
+void job_mem_release(RunContext *run_context, int64_t size)
+{
+    atomic_fetch_sub(&run_context->mem_used, size);
+}
+
+int64_t job_mem_frame_size(const AVFrame *frame)
+{
+    int64_t size = 0;
+    int i;
+
+    for (i = 0; i < FF_ARRAY_ELEMS(frame->buf) && frame->buf[i]; i++)
+        size += frame->buf[i]->size;
+    for (i = 0; i < frame->nb_extended_buf; i++)
+        size += frame->extended_buf[i]->size;
+    return size;
+}
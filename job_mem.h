@@ -0,0 +1,30 @@
+//
+// Created by hexiufeng on 2026/10/19.
+//
+
+#ifndef RUN_FFMPEG_JOB_MEM_H
+#define RUN_FFMPEG_JOB_MEM_H
+
+#include "cmd_options.h"
+
+/*
+ * bytes a job holds outside of libav*'s own bookkeeping: frames waiting for a filter graph,
+ * packets in the muxing and input thread queues and the data of memory outputs.
+ * the input thread charges too, so the counters are atomic.
+ */
+
+/*
+ * returns AVERROR(ENOMEM) without charging anything when -job_mem_limit would be exceeded.
+ * the first refusal also sets mem_exceeded, so callers that can't report errors may ignore it
+ */
+int job_mem_charge(RunContext *run_context, int64_t size);
+void job_mem_release(RunContext *run_context, int64_t size);
+
+int64_t job_mem_frame_size(const AVFrame *frame);
+
+static inline int64_t job_mem_peak(RunContext *run_context)
+{
+    return atomic_load(&run_context->mem_peak);
+}
+
+#endif //RUN_FFMPEG_JOB_MEM_H
@@ -0,0 +1,158 @@
+//
+// Created by hexiufeng on 2026/10/19.
+//
+
+#include "job_stats.h"
+#include "job_mem.h"
+#include "config.h"
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <libavutil/common.h>
+#include <libavutil/time.h>
+#if HAVE_SYS_RESOURCE_H
+#include <sys/resource.h>
+#endif
+
+/* wall time histogram, 4 buckets per doubling of milliseconds */
+#define NB_BUCKETS 128
+#define BUCKETS_PER_OCTAVE 4
+
+typedef struct Stats {
+    uint64_t nb_jobs;
+    uint64_t nb_failed;
+    int64_t first_start;    // av_gettime_relative() when the first recorded job started
+    int64_t wall_us;
+    int64_t media_us;
+    int64_t mem_peak;
+    int input_queue_depth;
+    int64_t nb_input_send_stalls;
+    int64_t nb_input_recv_stalls;
+    uint64_t buckets[NB_BUCKETS];
+    LatencyHist latency;
+} Stats;
+
+/* not reset with the rest, jobs already running will still finish */
+static atomic_int nb_running;
+
+static pthread_mutex_t stats_lock = PTHREAD_MUTEX_INITIALIZER;
+static Stats stats;
+
+static int bucket_of(int64_t wall_us)
+{
+    int b = (int)(BUCKETS_PER_OCTAVE * log2(1.0 + wall_us / 1000.0));
+    return b < NB_BUCKETS ? b : NB_BUCKETS - 1;
+}
+
+/* upper bound in milliseconds of the bucket holding the q-quantile */
+static int64_t percentile(const Stats *s, double q)
+{
+    uint64_t rank = (uint64_t)ceil(q * s->nb_jobs), seen = 0;
+    int b;
+
+    for (b = 0; b < NB_BUCKETS; b++) {
+        seen += s->buckets[b];
+        if (seen >= rank && seen)
+            return (int64_t)ceil(exp2((b + 1.0) / BUCKETS_PER_OCTAVE) - 1.0);
+    }
+    return 0;
+}
+
+static int64_t peak_rss_kb(void)
+{
+#if HAVE_GETRUSAGE
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage))
+        return 0;
+#ifdef __APPLE__
+    return usage.ru_maxrss / 1024;
+#else
+    return usage.ru_maxrss;
+#endif
+#else
+    return 0;
+#endif
+}
+
+static int64_t current_rss_kb(void)
+{
+#ifdef __linux__
+    long pages = 0;
+    FILE *f = fopen("/proc/self/statm", "r");
+    if (!f)
+        return 0;
+    if (fscanf(f, "%*ld %ld", &pages) != 1)
+        pages = 0;
+    fclose(f);
+    return (int64_t)pages * (sysconf(_SC_PAGESIZE) / 1024);
+#else
+    return 0;
+#endif
+}
+
+void job_stats_start(void)
+{
+    atomic_fetch_add(&nb_running, 1);
+}
+
+void job_stats_record(RunContext *run_context, int64_t wall_us, int failed)
+{
+    int64_t now = av_gettime_relative();
+
+    atomic_fetch_sub(&nb_running, 1);
+
+    pthread_mutex_lock(&stats_lock);
+    if (!stats.nb_jobs || now - wall_us < stats.first_start)
+        stats.first_start = now - wall_us;
+    stats.nb_jobs++;
+    stats.nb_failed += !!failed;
+    stats.wall_us   += wall_us;
+    stats.media_us  += run_context->output_duration;
+    stats.mem_peak   = FFMAX(stats.mem_peak, job_mem_peak(run_context));
+    stats.input_queue_depth     = FFMAX(stats.input_queue_depth, run_context->input_queue_depth);
+    stats.nb_input_send_stalls += run_context->nb_input_send_stalls;
+    stats.nb_input_recv_stalls += run_context->nb_input_recv_stalls;
+    stats.buckets[bucket_of(wall_us)]++;
+    latency_hist_merge(&stats.latency, &run_context->latency);
+    pthread_mutex_unlock(&stats_lock);
+}
+
+void job_stats_get(JobStats *out)
+{
+    Stats s;
+    int64_t elapsed;
+
+    pthread_mutex_lock(&stats_lock);
+    s = stats;
+    pthread_mutex_unlock(&stats_lock);
+
+    memset(out, 0, sizeof(*out));
+    out->nb_jobs     = s.nb_jobs;
+    out->nb_failed   = s.nb_failed;
+    out->peak_rss_kb = peak_rss_kb();
+    out->rss_kb      = current_rss_kb();
+    out->nb_running  = atomic_load(&nb_running);
+    out->peak_job_mem = s.mem_peak;
+    out->max_input_queue_depth = s.input_queue_depth;
+    out->nb_input_send_stalls  = s.nb_input_send_stalls;
+    out->nb_input_recv_stalls  = s.nb_input_recv_stalls;
+    out->latency_p50_us        = latency_hist_percentile(&s.latency, 0.50);
+    out->latency_p99_us        = latency_hist_percentile(&s.latency, 0.99);
+    if (!s.nb_jobs)
+        return;
+    elapsed = av_gettime_relative() - s.first_start;
+    out->jobs_per_sec    = elapsed > 0 ? s.nb_jobs * 1000000.0 / elapsed : 0;
+    out->realtime_factor = s.wall_us > 0 ? (double)s.media_us / s.wall_us : 0;
+    out->p50_ms          = percentile(&s, 0.50);
+    out->p99_ms          = percentile(&s, 0.99);
+}
+
+void job_stats_reset(void)
+{
+    pthread_mutex_lock(&stats_lock);
+    memset(&stats, 0, sizeof(stats));
+    pthread_mutex_unlock(&stats_lock);
+}
@@ -0,0 +1,19 @@
+//
+// Created by hexiufeng on 2026/10/19.
+//
+
+#ifndef RUN_FFMPEG_JOB_STATS_H
+#define RUN_FFMPEG_JOB_STATS_H
+
+#include <stdint.h>
+#include "cmd_options.h"
+#include "run_ffmpeg.h"
+
+void job_stats_start(void);
+/* record one finished run_ffmpeg_cmd() after its cleanup */
+void job_stats_record(RunContext *run_context, int64_t wall_us, int failed);
+
+void job_stats_get(JobStats *stats);
+void job_stats_reset(void);
+
+#endif //RUN_FFMPEG_JOB_STATS_H
@@ -0,0 +1,62 @@
+//
+// Created by hexiufeng on 2026/10/19.
+//
+
+#include "latency.h"
+#include <math.h>
+#include <libavutil/avutil.h>
+
+#define BUCKETS_PER_OCTAVE 4
+#define BUCKET_UNIT_US 100.0
+
+void latency_track_in(LatencyTrack *t, int64_t ts, int64_t wall)
+{
+    t->ts[t->next]   = ts;
+    t->wall[t->next] = wall;
+    t->next = (t->next + 1) % LATENCY_TRACK_SIZE;
+    if (t->nb < LATENCY_TRACK_SIZE)
+        t->nb++;
+}
+
+int64_t latency_track_find(const LatencyTrack *t, int64_t ts)
+{
+    int i, idx;
+
+    // newest first, an output packet rarely lags more than a few input packets
+    for (i = 1; i <= t->nb; i++) {
+        idx = (t->next - i + LATENCY_TRACK_SIZE) % LATENCY_TRACK_SIZE;
+        if (t->ts[idx] <= ts)
+            return t->wall[idx];
+    }
+    return AV_NOPTS_VALUE;
+}
+
+void latency_hist_add(LatencyHist *h, int64_t delay_us)
+{
+    int b = (int)(BUCKETS_PER_OCTAVE * log2(1.0 + FFMAX(delay_us, 0) / BUCKET_UNIT_US));
+
+    h->buckets[FFMIN(b, LATENCY_BUCKETS - 1)]++;
+    h->nb++;
+}
+
+void latency_hist_merge(LatencyHist *dst, const LatencyHist *src)
+{
+    int b;
+
+    for (b = 0; b < LATENCY_BUCKETS; b++)
+        dst->buckets[b] += src->buckets[b];
+    dst->nb += src->nb;
+}
+
+int64_t latency_hist_percentile(const LatencyHist *h, double q)
+{
+    uint64_t rank = (uint64_t)ceil(q * h->nb), seen = 0;
+    int b;
+
+    for (b = 0; b < LATENCY_BUCKETS; b++) {
+        seen += h->buckets[b];
+        if (seen >= rank && seen)
+            return (int64_t)ceil((exp2((b + 1.0) / BUCKETS_PER_OCTAVE) - 1.0) * BUCKET_UNIT_US);
+    }
+    return 0;
+}
@@ -0,0 +1,43 @@
+//
+// Created by hexiufeng on 2026/10/19.
+//
+
+#ifndef RUN_FFMPEG_LATENCY_H
+#define RUN_FFMPEG_LATENCY_H
+
+#include <stdint.h>
+
+/*
+ * input-to-output delay of -low_latency jobs.
+ * each input stream remembers when its recent packets were taken from the demuxer, keyed by
+ * dts in AV_TIME_BASE. an output packet about to be muxed is matched by its pts to the
+ * newest input packet at or before it, so the delay covers decoding, filtering, encoding
+ * and the muxing queue, but not the interleaving inside libavformat.
+ */
+
+#define LATENCY_TRACK_SIZE 256
+/* 4 buckets per doubling of 100us, the last one is open ended */
+#define LATENCY_BUCKETS 96
+
+typedef struct LatencyTrack {
+    int64_t ts[LATENCY_TRACK_SIZE];
+    int64_t wall[LATENCY_TRACK_SIZE];
+    int nb;
+    int next;
+} LatencyTrack;
+
+typedef struct LatencyHist {
+    uint64_t nb;
+    uint64_t buckets[LATENCY_BUCKETS];
+} LatencyHist;
+
+void latency_track_in(LatencyTrack *t, int64_t ts, int64_t wall);
+/* wall time of the newest input packet at or before ts, AV_NOPTS_VALUE when it was forgotten */
+int64_t latency_track_find(const LatencyTrack *t, int64_t ts);
+
+void latency_hist_add(LatencyHist *h, int64_t delay_us);
+void latency_hist_merge(LatencyHist *dst, const LatencyHist *src);
+/* upper bound in microseconds of the bucket holding the q-quantile, 0 without samples */
+int64_t latency_hist_percentile(const LatencyHist *h, double q);
+
+#endif //RUN_FFMPEG_LATENCY_H
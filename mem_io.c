@@ -0,0 +1,283 @@
+//
+// Created by hexiufeng on 2026/10/19.
+//
+
+#include "mem_io.h"
+#include "base64.h"
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <libavutil/avstring.h>
+#include <libavutil/common.h>
+#include <libavutil/error.h>
+#include <libavutil/mem.h>
+
+#define B64MEM_IO_SIZE 32768
+
+typedef struct B64Mem {
+    mem_data *mem;
+    int64_t pos;            // position in the decoded data
+    int64_t len;            // size of the decoded data
+
+    /* input */
+    int64_t nb_groups;      // complete groups, the padded one excluded
+    int tail;               // bytes in the padded last group
+
+    /* output */
+    size_t capacity;        // allocated chars in mem->buffer
+    uint8_t carry[3];       // bytes not forming a whole group yet
+    int nb_carry;
+} B64Mem;
+
+int is_b64mem_url(const char *url)
+{
+    return av_strstart(url, B64MEM_PREFIX, NULL);
+}
+
+mem_data *mem_url_data(const char *url)
+{
+    const char *handle;
+
+    if (!av_strstart(url, "filemem:", &handle) && !av_strstart(url, B64MEM_PREFIX, &handle))
+        return NULL;
+    return (mem_data *)(intptr_t)strtoll(handle, NULL, 0);
+}
+
+static int decode_tail(B64Mem *b, uint8_t out[3])
+{
+    const char *src = b->mem->buffer + b->nb_groups * 4;
+    char group[4];
+
+    memcpy(group, src, 4);
+    group[3] = 'A';
+    if (b->tail == 1)
+        group[2] = 'A';
+    return base64_decode_groups(out, group, 1);
+}
+
+static int b64mem_read(void *opaque, uint8_t *buf, int size)
+{
+    B64Mem *b = opaque;
+    int done = 0;
+
+    if (b->pos >= b->len)
+        return AVERROR_EOF;
+    size = FFMIN(size, b->len - b->pos);
+
+    while (done < size) {
+        int64_t g = b->pos / 3;
+        int off = b->pos % 3;
+
+        if (off || size - done < 3 || g >= b->nb_groups) {
+            uint8_t tmp[3];
+            int n = g < b->nb_groups ? 3 : b->tail;
+            int ret = g < b->nb_groups ? base64_decode_groups(tmp, b->mem->buffer + g * 4, 1) : decode_tail(b, tmp);
+            int k = FFMIN(n - off, size - done);
+            if (ret < 0)
+                return AVERROR_INVALIDDATA;
+            memcpy(buf + done, tmp + off, k);
+            done   += k;
+            b->pos += k;
+        } else {
+            int64_t nb = FFMIN((size - done) / 3, b->nb_groups - g);
+            if (base64_decode_groups(buf + done, b->mem->buffer + g * 4, nb) < 0)
+                return AVERROR_INVALIDDATA;
+            done   += nb * 3;
+            b->pos += nb * 3;
+        }
+    }
+    return done;
+}
+
+static int reserve(B64Mem *b, size_t nb_chars)
+{
+    size_t need = (size_t)b->mem->size + nb_chars;
+    char *buf;
+
+    if (need <= b->capacity)
+        return 0;
+    if (need > INT_MAX)
+        return AVERROR(ENOMEM);
+    need = FFMIN(FFMAX(need, b->capacity * 2), INT_MAX);
+    buf = av_realloc(b->mem->buffer, need);
+    if (!buf)
+        return AVERROR(ENOMEM);
+    b->mem->buffer = buf;
+    b->capacity    = need;
+    return 0;
+}
+
+/* rewrite bytes already written, only happens for header fixups so one group at a time */
+static int overwrite(B64Mem *b, const uint8_t *buf, int size)
+{
+    int64_t g = b->pos / 3;
+    int off = b->pos % 3;
+    int k;
+
+    if (g < b->mem->size / 4) {
+        uint8_t tmp[3];
+        char *dst = b->mem->buffer + g * 4;
+        if (base64_decode_groups(tmp, dst, 1) < 0)
+            return AVERROR_BUG;
+        k = FFMIN(3 - off, size);
+        memcpy(tmp + off, buf, k);
+        base64_encode_groups(dst, tmp, 1);
+    } else {
+        k = FFMIN(b->nb_carry - off, size);
+        memcpy(b->carry + off, buf, k);
+    }
+    b->pos += k;
+    return k;
+}
+
+static int b64mem_write(void *opaque, uint8_t *buf, int size)
+{
+    B64Mem *b = opaque;
+    int done = 0, ret;
+
+    while (done < size && b->pos < b->len) {
+        if ((ret = overwrite(b, buf + done, size - done)) < 0)
+            return ret;
+        done += ret;
+    }
+    if (done == size)
+        return size;
+
+    if (b->nb_carry) {
+        int k = FFMIN(3 - b->nb_carry, size - done);
+        memcpy(b->carry + b->nb_carry, buf + done, k);
+        b->nb_carry += k;
+        done        += k;
+        if (b->nb_carry == 3) {
+            if ((ret = reserve(b, 4)) < 0)
+                return ret;
+            base64_encode_groups(b->mem->buffer + b->mem->size, b->carry, 1);
+            b->mem->size += 4;
+            b->nb_carry   = 0;
+        }
+    }
+    if (size - done >= 3) {
+        int nb = (size - done) / 3;
+        if ((ret = reserve(b, (size_t)nb * 4)) < 0)
+            return ret;
+        base64_encode_groups(b->mem->buffer + b->mem->size, buf + done, nb);
+        b->mem->size += nb * 4;
+        done         += nb * 3;
+    }
+    if (done < size) {
+        memcpy(b->carry + b->nb_carry, buf + done, size - done);
+        b->nb_carry += size - done;
+    }
+
+    b->len = (int64_t)b->mem->size / 4 * 3 + b->nb_carry;
+    b->pos = b->len;
+    return size;
+}
+
+static int64_t b64mem_seek(void *opaque, int64_t offset, int whence)
+{
+    B64Mem *b = opaque;
+    int64_t pos;
+
+    whence &= ~AVSEEK_FORCE;
+    switch (whence) {
+    case AVSEEK_SIZE: return b->len;
+    case SEEK_SET:    pos = offset;          break;
+    case SEEK_CUR:    pos = b->pos + offset; break;
+    case SEEK_END:    pos = b->len + offset; break;
+    default:          return AVERROR(EINVAL);
+    }
+    /* the gap of a seek past the end would have no defined content */
+    if (pos < 0 || pos > b->len)
+        return AVERROR(EINVAL);
+    b->pos = pos;
+    return pos;
+}
+
+static int open_input(B64Mem *b)
+{
+    const char *text = b->mem->buffer;
+    int n = b->mem->size, pad = 0;
+
+    while (n && (text[n - 1] == '\n' || text[n - 1] == '\r'))
+        n--;
+    if (n % 4)
+        return AVERROR_INVALIDDATA;
+    while (pad < 2 && n - pad > 0 && text[n - pad - 1] == '=')
+        pad++;
+
+    b->nb_groups = n / 4 - (pad ? 1 : 0);
+    b->tail      = pad ? 3 - pad : 0;
+    b->len       = b->nb_groups * 3 + b->tail;
+    return 0;
+}
+
+int b64mem_open(const char *url, int write, AVIOContext **pb)
+{
+    const char *handle;
+    uint8_t *io_buf;
+    B64Mem *b;
+    int ret;
+
+    *pb = NULL;
+    if (!av_strstart(url, B64MEM_PREFIX, &handle) || !*handle)
+        return AVERROR(EINVAL);
+
+    b = av_mallocz(sizeof(*b));
+    if (!b)
+        return AVERROR(ENOMEM);
+    b->mem = (mem_data *)(intptr_t)strtoll(handle, NULL, 0);
+    if (!b->mem) {
+        av_free(b);
+        return AVERROR(EINVAL);
+    }
+    if (write) {
+        // the handle of new_output_mem() may be reused, start over
+        av_freep(&b->mem->buffer);
+        b->mem->size = 0;
+    } else if ((ret = open_input(b)) < 0) {
+        av_free(b);
+        return ret;
+    }
+
+    io_buf = av_malloc(B64MEM_IO_SIZE);
+    if (!io_buf) {
+        av_free(b);
+        return AVERROR(ENOMEM);
+    }
+    *pb = avio_alloc_context(io_buf, B64MEM_IO_SIZE, write, b,
+                             write ? NULL : b64mem_read, write ? b64mem_write : NULL, b64mem_seek);
+    if (!*pb) {
+        av_free(io_buf);
+        av_free(b);
+        return AVERROR(ENOMEM);
+    }
+    return 0;
+}
+
+int b64mem_owns(AVIOContext *pb)
+{
+    return pb && pb->seek == b64mem_seek;
+}
+
+void b64mem_close(AVIOContext **pb)
+{
+    B64Mem *b;
+
+    if (!*pb)
+        return;
+    b = (*pb)->opaque;
+    if ((*pb)->write_flag) {
+        avio_flush(*pb);
+        if (b->nb_carry && reserve(b, 4) >= 0) {
+            char *dst = b->mem->buffer + b->mem->size;
+            memset(b->carry + b->nb_carry, 0, 3 - b->nb_carry);
+            base64_encode_groups(dst, b->carry, 1);
+            memset(dst + b->nb_carry + 1, '=', 3 - b->nb_carry);
+            b->mem->size += 4;
+        }
+    }
+    av_freep(&(*pb)->buffer);
+    avio_context_free(pb);
+    av_free(b);
+}
@@ -0,0 +1,31 @@
+//
+// Created by hexiufeng on 2026/10/19.
+//
+
+#ifndef RUN_FFMPEG_MEM_IO_H
+#define RUN_FFMPEG_MEM_IO_H
+
+#include <libavformat/avio.h>
+
+typedef struct _mem_data {
+    char * buffer;
+    int size;
+} mem_data;
+
+/*
+ * "b64mem:<handle>" takes the same handles as filemem: (new_input_mem/new_output_mem)
+ * but the memory holds base64 text. inputs are decoded while the demuxer reads,
+ * outputs are encoded while the muxer writes, both stay seekable.
+ */
+#define B64MEM_PREFIX "b64mem:"
+
+int is_b64mem_url(const char *url);
+int b64mem_open(const char *url, int write, AVIOContext **pb);
+/* the handle of a filemem:/b64mem: url, NULL for any other url */
+mem_data *mem_url_data(const char *url);
+/* whether pb was opened by b64mem_open() */
+int b64mem_owns(AVIOContext *pb);
+/* writes the final padded group of an output, frees pb but not the memory handle */
+void b64mem_close(AVIOContext **pb);
+
+#endif //RUN_FFMPEG_MEM_IO_H
@@ -0,0 +1,90 @@
+//
+// Created by hexiufeng on 2026/10/19.
+//
+
+#include "mux_queue.h"
+#include <pthread.h>
+#include <libavutil/common.h>
+
+/* shells kept around between jobs, enough for a few streams waiting on a slow encoder */
+#define MAX_FREE_PACKETS 4096
+
+static pthread_mutex_t queue_lock = PTHREAD_MUTEX_INITIALIZER;
+static AVPacket **free_packets;
+static int nb_free_packets;
+static int64_t budget;
+static MuxQueueStats stats;
+
+void mux_queue_set_budget(int64_t bytes)
+{
+    pthread_mutex_lock(&queue_lock);
+    budget = FFMAX(bytes, 0);
+    pthread_mutex_unlock(&queue_lock);
+}
+
+int mux_queue_over_budget(int size)
+{
+    int over;
+    pthread_mutex_lock(&queue_lock);
+    over = budget && stats.data_size + size > budget;
+    pthread_mutex_unlock(&queue_lock);
+    return over;
+}
+
+AVPacket *mux_queue_packet_get(AVPacket *pkt)
+{
+    AVPacket *out = NULL;
+
+    pthread_mutex_lock(&queue_lock);
+    if (nb_free_packets)
+        out = free_packets[--nb_free_packets];
+    else
+        stats.shells_allocated++;
+    pthread_mutex_unlock(&queue_lock);
+
+    if (!out && !(out = av_packet_alloc()))
+        return NULL;
+    av_packet_move_ref(out, pkt);
+    return out;
+}
+
+void mux_queue_packet_put(AVPacket **pkt)
+{
+    if (!*pkt)
+        return;
+    av_packet_unref(*pkt);
+    pthread_mutex_lock(&queue_lock);
+    if (!free_packets)
+        free_packets = av_malloc_array(MAX_FREE_PACKETS, sizeof(*free_packets));
+    if (free_packets && nb_free_packets < MAX_FREE_PACKETS) {
+        free_packets[nb_free_packets++] = *pkt;
+        *pkt = NULL;
+    }
+    pthread_mutex_unlock(&queue_lock);
+
+    av_packet_free(pkt);
+}
+
+void mux_queue_pushed(int pkt_size, int nb_packets, int64_t queue_data_size)
+{
+    pthread_mutex_lock(&queue_lock);
+    stats.packets_queued++;
+    stats.data_size     += pkt_size;
+    stats.peak_packets   = FFMAX(stats.peak_packets, nb_packets);
+    stats.peak_data_size = FFMAX(stats.peak_data_size, queue_data_size);
+    pthread_mutex_unlock(&queue_lock);
+}
+
+void mux_queue_popped(int pkt_size)
+{
+    pthread_mutex_lock(&queue_lock);
+    stats.data_size -= pkt_size;
+    pthread_mutex_unlock(&queue_lock);
+}
+
+void mux_queue_get_stats(MuxQueueStats *out)
+{
+    pthread_mutex_lock(&queue_lock);
+    *out = stats;
+    pthread_mutex_unlock(&queue_lock);
+}
@@ -0,0 +1,34 @@
+//
+// Created by hexiufeng on 2026/10/19.
+//
+
+#ifndef RUN_FFMPEG_MUX_QUEUE_H
+#define RUN_FFMPEG_MUX_QUEUE_H
+
+#include <stdint.h>
+#include <libavcodec/packet.h>
+#include "run_ffmpeg.h"
+
+/*
+ * packets buffered in OutputStream.muxing_queue until the muxer header is written.
+ * the AVPacket shells come from a process-wide free list shared by all streams and
+ * jobs, so a stream waiting for its siblings doesn't allocate one per packet.
+ */
+
+/* process-wide limit on packet data held by all muxing queues, 0 = unlimited */
+void mux_queue_set_budget(int64_t bytes);
+/* whether adding size bytes exceeds the process-wide budget */
+int mux_queue_over_budget(int size);
+
+/* take pkt's reference into a pooled packet */
+AVPacket *mux_queue_packet_get(AVPacket *pkt);
+/* unref *pkt and return it to the free list */
+void mux_queue_packet_put(AVPacket **pkt);
+
+/* account a packet of pkt_size bytes entering / leaving a stream queue */
+void mux_queue_pushed(int pkt_size, int nb_packets, int64_t queue_data_size);
+void mux_queue_popped(int pkt_size);
+
+void mux_queue_get_stats(MuxQueueStats *stats);
+
+#endif //RUN_FFMPEG_MUX_QUEUE_H
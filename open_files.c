@@ -10,6 +10,9 @@
 #include "cmd_util.h"
 #include "common.h"
 #include "filter.h"
+#include "mem_io.h"
+#include "file_io.h"
+#include "seek_index.h"
 
 #define DEFAULT_PASS_LOGFILENAME_PREFIX "ffmpeg2pass"
 
@@ -164,7 +167,8 @@ fail:
     return NULL;
 }
 
-static int add_input_streams(OptionsContext *o, AVFormatContext *ic)
+static int add_input_streams(OptionsContext *o, AVFormatContext *ic,
+                             StreamCodecOpts *stream_opts, int nb_stream_opts)
 {
     int i, ret;
 
@@ -223,7 +227,8 @@ static int add_input_streams(OptionsContext *o, AVFormatContext *ic)
         }
 
         ist->dec = choose_decoder(o, ic, st);
-        ist->decoder_opts = filter_codec_opts(o->g->codec_opts, ist->st->codecpar->codec_id, ic, st, ist->dec,&has_error);
+        ist->decoder_opts = take_stream_codec_opts(stream_opts, nb_stream_opts, o->g->codec_opts,
+                                                   ic, st, ist->dec, &has_error);
 
         if(has_error){
             goto fail;
@@ -458,6 +463,11 @@ static int open_input_file(OptionsContext *o, const char *filename) {
     char *subtitle_codec_name = NULL;
     char *data_codec_name = NULL;
     int scan_all_pmts_set = 0;
+    AVIOContext *b64_pb = NULL;
+    AVIOContext *file_pb = NULL;
+    enum FileReadMode read_mode;
+    StreamCodecOpts *stream_opts = NULL;
+    int nb_stream_opts = 0;
 
     char * trace_id = o->run_context_ref->trace_id;
 
@@ -569,6 +579,30 @@ static int open_input_file(OptionsContext *o, const char *filename) {
         av_dict_set(&o->g->format_opts, "scan_all_pmts", "1", AV_DICT_DONT_OVERWRITE);
         scan_all_pmts_set = 1;
     }
+    if (is_b64mem_url(filename)) {
+        if ((err = b64mem_open(filename, 0, &b64_pb)) < 0) {
+            print_error(filename, err);
+            goto fail;
+        }
+        ic->pb = b64_pb;
+        ic->flags |= AVFMT_FLAG_CUSTOM_IO;
+    }
+    if (file_io_parse_mode(o->file_read, &read_mode) < 0) {
+        av_log(NULL, AV_LOG_ERROR, "tid=%s,Unknown file_read mode %s, use mmap or block\n", trace_id, o->file_read);
+        goto fail;
+    }
+    if (!b64_pb && read_mode != FILE_READ_DEFAULT) {
+        err = file_io_open(filename, read_mode, &file_pb);
+        if (err >= 0) {
+            ic->pb = file_pb;
+            ic->flags |= AVFMT_FLAG_CUSTOM_IO;
+        } else if (err != AVERROR(ENOSYS)) {
+            print_error(filename, err);
+            goto fail;
+        } else {
+            av_log(NULL, AV_LOG_VERBOSE, "tid=%s,%s is not a local regular file, file_read ignored\n", trace_id, filename);
+        }
+    }
     /* open the input file with generic avformat function */
     err = avformat_open_input(&ic, filename, file_iformat, &o->g->format_opts);
     if (err < 0) {
@@ -590,20 +624,33 @@ static int open_input_file(OptionsContext *o, const char *filename) {
 
     if (o->run_context_ref->find_stream_info) {
         int error = 0;
-        AVDictionary **opts = setup_find_stream_info_opts(trace_id,ic, o->g->codec_opts,&error);
+        AVDictionary **opts = NULL;
+        stream_opts = resolve_stream_codec_opts(trace_id, ic, o->g->codec_opts, &error);
         if(error){
             av_log(NULL, AV_LOG_ERROR, "tid=%s,find codec error.\n",trace_id,filename);
             goto fail;
         }
         int orig_nb_streams = ic->nb_streams;
+        nb_stream_opts = orig_nb_streams;
+
+        /* find_stream_info takes away what it consumes, the decoders later want the full set */
+        if (orig_nb_streams && !(opts = av_mallocz_array(orig_nb_streams, sizeof(*opts))))
+            goto fail;
+        for (i = 0; i < orig_nb_streams; i++) {
+            if (av_dict_copy(&opts[i], stream_opts[i].opts, 0) < 0)
+                error = 1;
+        }
 
         /* If not enough info to get the stream parameters, we decode the
            first frames to get it. (used in mpeg case for example) */
-        ret = avformat_find_stream_info(ic, opts);
+        if (!error)
+            ret = avformat_find_stream_info(ic, opts);
 
         for (i = 0; i < orig_nb_streams; i++)
             av_dict_free(&opts[i]);
         av_freep(&opts);
+        if (error)
+            goto fail;
 
         if (ret < 0) {
             av_log(NULL, AV_LOG_FATAL, "tid=%s,%s: could not find codec parameters\n", trace_id,filename);
@@ -638,6 +685,12 @@ static int open_input_file(OptionsContext *o, const char *filename) {
     if (!o->seek_timestamp && ic->start_time != AV_NOPTS_VALUE)
         timestamp += ic->start_time;
 
+    if (o->seek_index) {
+        int nb = seek_index_apply(ic, filename);
+        if (nb)
+            av_log(NULL, AV_LOG_VERBOSE, "tid=%s,%d cached index entries for %s\n", trace_id, nb, filename);
+    }
+
     /* if seeking requested, we execute it */
     if (o->start_time != AV_NOPTS_VALUE) {
         int64_t seek_timestamp = timestamp;
@@ -663,7 +716,8 @@ static int open_input_file(OptionsContext *o, const char *filename) {
     }
 
     /* update the current parameters so that they match the one of the input stream */
-    add_input_streams(o, ic);
+    add_input_streams(o, ic, stream_opts, nb_stream_opts);
+    free_stream_codec_opts(&stream_opts, nb_stream_opts);
 
     /* dump the file content */
 //    av_dump_format(ic, nb_input_files, filename, 0);
@@ -679,6 +733,9 @@ static int open_input_file(OptionsContext *o, const char *filename) {
     o->run_context_ref->option_input.input_files[o->run_context_ref->option_input.nb_input_files - 1] = f;
 
     f->ctx = ic;
+    /* closed along with f->ctx from now on */
+    b64_pb = NULL;
+    file_pb = NULL;
     f->ist_index = o->run_context_ref->option_input.nb_input_streams - ic->nb_streams;
     f->start_time = o->start_time;
     f->recording_time = o->recording_time;
@@ -689,6 +746,7 @@ static int open_input_file(OptionsContext *o, const char *filename) {
     f->rate_emu = o->rate_emu;
     f->accurate_seek = o->accurate_seek;
     f->loop = o->loop;
+    f->seek_index = o->seek_index;
     f->duration = 0;
     f->time_base = (AVRational) {1, 1};
     f->pkt = av_packet_alloc();
@@ -756,6 +814,9 @@ static int open_input_file(OptionsContext *o, const char *filename) {
 fail:
     // destroy resource
     avformat_free_context(ic);
+    b64mem_close(&b64_pb);
+    file_io_close(&file_pb);
+    free_stream_codec_opts(&stream_opts, nb_stream_opts);
     return -1;
 }
 
@@ -800,7 +861,8 @@ static void init_options(ParsedOptionsContext *parent, OptionsContext *o)
     memset(o, 0, sizeof(*o));
 
     o->stop_time = INT64_MAX;
-    o->mux_max_delay  = 0.7;
+    // global options are parsed before any file, -muxdelay still wins
+    o->mux_max_delay  = parent->options_context.run_context_ref->low_latency ? 0 : 0.7;
     o->start_time     = AV_NOPTS_VALUE;
     o->start_time_eof = AV_NOPTS_VALUE;
     o->recording_time = INT64_MAX;
@@ -1880,6 +1942,7 @@ static int open_output_file(OptionsContext *o, const char *filename)
     }
 
     of->ctx = oc;
+    of->mem_output = mem_url_data(filename);
     if (o->recording_time != INT64_MAX)
         oc->duration = o->recording_time;
 //    不使用该功能
@@ -2337,7 +2400,13 @@ static int open_output_file(OptionsContext *o, const char *filename)
 //        assert_file_overwrite(filename);
 
         /* open the file */
-        if ((err = avio_open2(&oc->pb, filename, AVIO_FLAG_WRITE,
+        if (is_b64mem_url(filename)) {
+            if ((err = b64mem_open(filename, 1, &oc->pb)) < 0) {
+                print_error(filename, err);
+//                exit_program(1);
+                return -1;
+            }
+        } else if ((err = avio_open2(&oc->pb, filename, AVIO_FLAG_WRITE,
                               &oc->interrupt_callback,
                               &of->opts)) < 0) {
             print_error(filename, err);
@@ -2353,6 +2422,9 @@ static int open_output_file(OptionsContext *o, const char *filename)
         av_dict_set_int(&of->opts, "preload", o->mux_preload*AV_TIME_BASE, 0);
     }
     oc->max_delay = (int)(o->mux_max_delay * AV_TIME_BASE);
+    /* hand every packet to the protocol instead of waiting for a full avio buffer */
+    if (o->run_context_ref->low_latency && !av_dict_get(of->opts, "flush_packets", NULL, 0))
+        av_dict_set(&of->opts, "flush_packets", "1", 0);
 
     /* copy metadata */
     for (i = 0; i < o->nb_metadata_map; i++) {
@@ -0,0 +1,187 @@
+//
+// Created by hexiufeng on 2026/10/19.
+//
+
+#include "opt_route.h"
+#include "config.h"
+#include <pthread.h>
+#include <string.h>
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include <libavutil/avstring.h>
+#include <libavutil/mem.h>
+#include <libswscale/swscale.h>
+#include <libswresample/swresample.h>
+#if CONFIG_AVRESAMPLE
+#include <libavresample/avresample.h>
+#endif
+
+#define OPT_ROUTE_BUCKETS 256
+
+typedef struct RouteEntry {
+    char *name;
+    OptRoute route;
+    struct RouteEntry *next;
+} RouteEntry;
+
+static pthread_rwlock_t route_lock = PTHREAD_RWLOCK_INITIALIZER;
+static RouteEntry *buckets[OPT_ROUTE_BUCKETS];
+static int nb_entries;
+
+static pthread_once_t keys_once = PTHREAD_ONCE_INIT;
+static pthread_key_t sws_key;
+static pthread_key_t swr_key;
+
+static unsigned str_hash(const char *s)
+{
+    unsigned h = 5381;
+    while (*s)
+        h = h * 33 + (unsigned char)*s++;
+    return h;
+}
+
+static const AVOption *opt_find(void *obj, const char *name, const char *unit,
+                                int opt_flags, int search_flags) {
+    const AVOption *o = av_opt_find(obj, name, unit, opt_flags, search_flags);
+    if (o && !o->flags)
+        return NULL;
+    return o;
+}
+
+/* same order and precedence opt_default() always had */
+static void find_route(const char *opt, OptRoute *r)
+{
+    const AVClass *cc = avcodec_get_class(), *fc = avformat_get_class();
+#if CONFIG_SWSCALE
+    const AVClass *sc = sws_get_class();
+#endif
+#if CONFIG_SWRESAMPLE
+    const AVClass *swr_class = swr_get_class();
+#endif
+#if CONFIG_AVRESAMPLE
+    const AVClass *rc = avresample_get_class();
+#endif
+    char opt_stripped[128];
+    const char *p;
+
+    memset(r, 0, sizeof(*r));
+    if (!(p = strchr(opt, ':')))
+        p = opt + strlen(opt);
+    av_strlcpy(opt_stripped, opt, FFMIN(sizeof(opt_stripped), p - opt + 1));
+
+    if ((r->codec = opt_find(&cc, opt_stripped, NULL, 0,
+                             AV_OPT_SEARCH_CHILDREN | AV_OPT_SEARCH_FAKE_OBJ)) ||
+        ((opt[0] == 'v' || opt[0] == 'a' || opt[0] == 's') &&
+         (r->codec = opt_find(&cc, opt + 1, NULL, 0, AV_OPT_SEARCH_FAKE_OBJ))))
+        r->layers |= OPT_ROUTE_CODEC;
+    if ((r->format = opt_find(&fc, opt, NULL, 0,
+                              AV_OPT_SEARCH_CHILDREN | AV_OPT_SEARCH_FAKE_OBJ)))
+        r->layers |= OPT_ROUTE_FORMAT;
+#if CONFIG_SWSCALE
+    if (!r->layers && (r->sws = opt_find(&sc, opt, NULL, 0,
+                                         AV_OPT_SEARCH_CHILDREN | AV_OPT_SEARCH_FAKE_OBJ)))
+        r->layers |= OPT_ROUTE_SWS;
+#endif
+#if CONFIG_SWRESAMPLE
+    if (!r->layers && (r->swr = opt_find(&swr_class, opt, NULL, 0,
+                                         AV_OPT_SEARCH_CHILDREN | AV_OPT_SEARCH_FAKE_OBJ)))
+        r->layers |= OPT_ROUTE_SWR;
+#endif
+#if CONFIG_AVRESAMPLE
+    if ((r->avresample = opt_find(&rc, opt, NULL, 0,
+                                  AV_OPT_SEARCH_CHILDREN | AV_OPT_SEARCH_FAKE_OBJ)))
+        r->layers |= OPT_ROUTE_AVRESAMPLE;
+#endif
+}
+
+static RouteEntry *find_entry(const char *opt, unsigned b)
+{
+    RouteEntry *e;
+    for (e = buckets[b]; e; e = e->next) {
+        if (!strcmp(e->name, opt))
+            return e;
+    }
+    return NULL;
+}
+
+int opt_route_get(const char *opt, OptRoute *route)
+{
+    unsigned b = str_hash(opt) % OPT_ROUTE_BUCKETS;
+    RouteEntry *e;
+
+    pthread_rwlock_rdlock(&route_lock);
+    e = find_entry(opt, b);
+    if (e)
+        *route = e->route;
+    pthread_rwlock_unlock(&route_lock);
+    if (e)
+        return 0;
+
+    find_route(opt, route);
+
+    pthread_rwlock_wrlock(&route_lock);
+    // a full table still answers, just without remembering
+    if (nb_entries < OPT_ROUTE_MAX_ENTRIES && !find_entry(opt, b) && (e = av_mallocz(sizeof(*e)))) {
+        if ((e->name = av_strdup(opt))) {
+            e->route = *route;
+            e->next = buckets[b];
+            buckets[b] = e;
+            nb_entries++;
+        } else {
+            av_free(e);
+        }
+    }
+    pthread_rwlock_unlock(&route_lock);
+    return 0;
+}
+
+#if CONFIG_SWSCALE
+static void free_sws(void *obj)
+{
+    sws_freeContext(obj);
+}
+#endif
+
+#if CONFIG_SWRESAMPLE
+static void free_swr(void *obj)
+{
+    struct SwrContext *swr = obj;
+    swr_free(&swr);
+}
+#endif
+
+static void create_keys(void)
+{
+#if CONFIG_SWSCALE
+    pthread_key_create(&sws_key, free_sws);
+#endif
+#if CONFIG_SWRESAMPLE
+    pthread_key_create(&swr_key, free_swr);
+#endif
+}
+
+int opt_route_check(int layer, const char *opt, const char *arg)
+{
+    void *obj = NULL;
+
+    pthread_once(&keys_once, create_keys);
+    switch (layer) {
+#if CONFIG_SWSCALE
+    case OPT_ROUTE_SWS:
+        if (!(obj = pthread_getspecific(sws_key)) && (obj = sws_alloc_context()))
+            pthread_setspecific(sws_key, obj);
+        break;
+#endif
+#if CONFIG_SWRESAMPLE
+    case OPT_ROUTE_SWR:
+        if (!(obj = pthread_getspecific(swr_key)) && (obj = swr_alloc()))
+            pthread_setspecific(swr_key, obj);
+        break;
+#endif
+    default:
+        return AVERROR(EINVAL);
+    }
+    if (!obj)
+        return AVERROR(ENOMEM);
+    return av_opt_set(obj, opt, arg, 0);
+}
@@ -0,0 +1,44 @@
+//
+// Created by hexiufeng on 2026/10/19.
+//
+
+#ifndef RUN_FFMPEG_OPT_ROUTE_H
+#define RUN_FFMPEG_OPT_ROUTE_H
+
+#include <libavutil/opt.h>
+
+/*
+ * which layers an option unknown to options[] belongs to. finding out walks the private
+ * classes of every registered codec and muxer, so the answer for each option name
+ * ("b:a", "ar", "profile"...) is kept for the life of the process. the tables are
+ * static data of the libraries, the cached AVOption pointers never go stale.
+ */
+
+#define OPT_ROUTE_MAX_ENTRIES 4096
+
+enum {
+    OPT_ROUTE_CODEC      = 1 << 0,
+    OPT_ROUTE_FORMAT     = 1 << 1,
+    OPT_ROUTE_SWS        = 1 << 2,
+    OPT_ROUTE_SWR        = 1 << 3,
+    OPT_ROUTE_AVRESAMPLE = 1 << 4,
+};
+
+typedef struct OptRoute {
+    int layers;             // OPT_ROUTE_*, 0 when no layer knows the option
+    const AVOption *codec;  // the option found in each layer, its type decides AV_DICT_APPEND
+    const AVOption *format;
+    const AVOption *sws;
+    const AVOption *swr;
+    const AVOption *avresample;
+} OptRoute;
+
+int opt_route_get(const char *opt, OptRoute *route);
+
+/*
+ * av_opt_set() on a swscale/swresample context kept per thread, so a value can be
+ * validated without allocating a context for every option
+ */
+int opt_route_check(int layer, const char *opt, const char *arg);
+
+#endif //RUN_FFMPEG_OPT_ROUTE_H
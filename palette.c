@@ -0,0 +1,56 @@
+//
+// Created by hexiufeng on 2026/10/19.
+//
+
+#include <libavutil/cpu.h>
+#include "config.h"
+#include "palette.h"
+#if ARCH_X86_64 && HAVE_AVX2_INLINE && defined(__GNUC__)
+#include <immintrin.h>
+#define PALETTE_AVX2 1
+#endif
+
+void palette_expand_c(uint32_t *dst, const uint8_t *src, const uint32_t *pal, int w)
+{
+    int x;
+
+    for (x = 0; x + 4 <= w; x += 4) {
+        dst[x    ] = pal[src[x    ]];
+        dst[x + 1] = pal[src[x + 1]];
+        dst[x + 2] = pal[src[x + 2]];
+        dst[x + 3] = pal[src[x + 3]];
+    }
+    for (; x < w; x++)
+        dst[x] = pal[src[x]];
+}
+
+#if PALETTE_AVX2
+__attribute__((target("avx2")))
+static void palette_expand_avx2(uint32_t *dst, const uint8_t *src, const uint32_t *pal, int w)
+{
+    int x;
+
+    for (x = 0; x + 8 <= w; x += 8) {
+        __m256i idx = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(src + x)));
+        __m256i px  = _mm256_i32gather_epi32((const int *)pal, idx, 4);
+        _mm256_storeu_si256((__m256i *)(dst + x), px);
+    }
+    palette_expand_c(dst + x, src + x, pal, w - x);
+}
+#endif
+
+palette_expand_fn palette_expand_simd(void)
+{
+#if PALETTE_AVX2
+    if (av_get_cpu_flags() & AV_CPU_FLAG_AVX2)
+        return palette_expand_avx2;
+#endif
+    return NULL;
+}
+
+palette_expand_fn get_palette_expand(void)
+{
+    palette_expand_fn simd = palette_expand_simd();
+
+    return simd ? simd : palette_expand_c;
+}
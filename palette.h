@@ -0,0 +1,19 @@
+//
+// Created by hexiufeng on 2026/10/19.
+//
+
+#ifndef RUN_FFMPEG_PALETTE_H
+#define RUN_FFMPEG_PALETTE_H
+
+#include <stdint.h>
+
+/* one row of w PAL8 pixels to RGB32 through pal, which has 256 entries */
+typedef void (*palette_expand_fn)(uint32_t *dst, const uint8_t *src, const uint32_t *pal, int w);
+
+void palette_expand_c(uint32_t *dst, const uint8_t *src, const uint32_t *pal, int w);
+/* the AVX2 version, NULL when the build or the cpu does not have it */
+palette_expand_fn palette_expand_simd(void);
+/* the fastest version this cpu runs */
+palette_expand_fn get_palette_expand(void);
+
+#endif //RUN_FFMPEG_PALETTE_H
@@ -13,6 +13,18 @@
 #include "transcode.h"
 #include "open_files.h"
 #include "hw.h"
+#include "worker_pool.h"
+#include "codec_pool.h"
+#include "hw_registry.h"
+#include "mux_queue.h"
+#include "mem_io.h"
+#include "job_log.h"
+#include "job_stats.h"
+#include "job_mem.h"
+#include "segment_run.h"
+#include "seek_index.h"
+#include <libavutil/time.h>
+#include <libavutil/bprint.h>
 
 #define NANO_SIZE 1000000
 
@@ -217,6 +229,20 @@ const OptionDef options[] = {
           "create a complex filtergraph", "graph_description" },
         { "filter_complex_script", HAS_ARG | OPT_EXPERT,                 { .func_arg = opt_filter_complex_script },
           "read complex filtergraph description from a file", "filename" },
+        { "job_mem_limit", HAS_ARG | OPT_INT64 | OPT_EXPERT|OPT_RUN_OFFSET,             { .off = RUN_CTX_OFFSET(mem_limit) },
+          "fail the job once its queued frames/packets and memory outputs hold more bytes", "bytes" },
+        { "eager_init", OPT_BOOL | OPT_EXPERT|OPT_RUN_OFFSET,                           { .off = RUN_CTX_OFFSET(eager_init) },
+          "initialize encoders and write headers before the first frame when the output parameters are given" },
+        { "low_latency", OPT_BOOL | OPT_EXPERT|OPT_RUN_OFFSET,                          { .off = RUN_CTX_OFFSET(low_latency) },
+          "flush every packet and poll inputs often, for live relays" },
+        { "multi_clip", OPT_BOOL | OPT_EXPERT|OPT_RUN_OFFSET,                           { .off = RUN_CTX_OFFSET(multi_clip) },
+          "cut every output -ss/-t window from one pass over the input" },
+        { "audio_fast_path", OPT_BOOL | OPT_EXPERT|OPT_RUN_OFFSET,                      { .off = RUN_CTX_OFFSET(audio_fast_path) },
+          "convert and encode audio only jobs without a filtergraph" },
+        { "job_loglevel", HAS_ARG | OPT_INT | OPT_EXPERT|OPT_RUN_OFFSET,               { .off = RUN_CTX_OFFSET(log_level) },
+          "set the log level of this job (numeric AV_LOG_* value)", "level" },
+        { "shared_codec_threads", OPT_BOOL | OPT_EXPERT|OPT_RUN_OFFSET,                 { .off = RUN_CTX_OFFSET(shared_codec_threads) },
+          "run codecs left on auto threads on the shared worker pool" },
         { "auto_conversion_filters", OPT_BOOL | OPT_EXPERT|OPT_RUN_OFFSET,              { .off = RUN_CTX_OFFSET(auto_conversion_filters) },
           "enable automatic conversion filters globally" },
 //        { "stats",          OPT_BOOL,                                    { &print_stats },
@@ -244,6 +270,12 @@ const OptionDef options[] = {
         { "thread_queue_size", HAS_ARG | OPT_INT | OPT_OFFSET | OPT_EXPERT | OPT_INPUT,
           { .off = OFFSET(thread_queue_size) },
           "set the maximum number of queued packets from the demuxer" },
+        { "file_read", HAS_ARG | OPT_STRING | OPT_OFFSET | OPT_EXPERT | OPT_INPUT,
+          { .off = OFFSET(file_read) },
+          "read a local file through mmap or 1MB sequential blocks", "mmap|block" },
+        { "seek_index", OPT_BOOL | OPT_OFFSET | OPT_EXPERT | OPT_INPUT,
+          { .off = OFFSET(seek_index) },
+          "share the keyframe index of a local file with later jobs" },
         { "find_stream_info", OPT_BOOL | OPT_PERFILE | OPT_INPUT | OPT_EXPERT|OPT_RUN_OFFSET, { .off = RUN_CTX_OFFSET(find_stream_info) },
           "read and decode the streams to fill missing information with heuristics" },
 
@@ -396,6 +428,8 @@ const OptionDef options[] = {
           "fix subtitles duration" },
         { "canvas_size", OPT_SUBTITLE | HAS_ARG | OPT_STRING | OPT_SPEC | OPT_INPUT, { .off = OFFSET(canvas_sizes) },
           "set canvas size (WxH or abbreviation)", "size" },
+        { "sub2video_bypass", OPT_BOOL | OPT_EXPERT | OPT_SUBTITLE | OPT_RUN_OFFSET, { .off = RUN_CTX_OFFSET(sub2video_bypass) },
+          "disable the filter blending subtitles into video while no subtitle is shown" },
 
         /* grab options */
         { "vc", HAS_ARG | OPT_EXPERT | OPT_VIDEO, { .func_arg = opt_video_channel },
@@ -461,6 +495,8 @@ const OptionDef options[] = {
           "initialise hardware device", "args" },
         { "filter_hw_device", HAS_ARG | OPT_EXPERT, { .func_arg = opt_filter_hw_device },
           "set hardware device used when filtering", "device" },
+        { "hw_device_cache", OPT_BOOL | OPT_EXPERT|OPT_RUN_OFFSET, { .off = RUN_CTX_OFFSET(hw_device_cache) },
+          "share hardware devices with the other jobs of the process that set it" },
 
         { NULL, },
 };
@@ -932,7 +968,10 @@ static int opt_recording_timestamp(void *optctx, const char *opt, const char *ar
         return -1;
     }
 
-    struct tm time = *gmtime((time_t*)&recording_timestamp);
+    time_t t = recording_timestamp;
+    struct tm time;
+    if (!gmtime_r(&t, &time))
+        return -1;
     if (!strftime(buf, sizeof(buf), "creation_time=%Y-%m-%dT%H:%M:%S%z", &time))
         return -1;
 
@@ -1234,13 +1273,17 @@ static int opt_target(void *optctx, const char *opt, const char *arg)
 }
 
 
-int parse_command(char * cmd,char * argv[]){
+/* splits cmd in place into at most max_args tokens, AVERROR(E2BIG) when there are more */
+int parse_command(char * cmd,char * argv[],int max_args){
     char * p = cmd;
     TRIM(p)
     char * start = p;
     int count = 0;
     while(*p){
         if(*p == ' '){
+            if(count == max_args){
+                return AVERROR(E2BIG);
+            }
             *p++ = '\0';
             argv[count++] = start;
             TRIM(p)
@@ -1250,6 +1293,9 @@ int parse_command(char * cmd,char * argv[]){
         p++;
     }
     if(start){
+        if(count == max_args){
+            return AVERROR(E2BIG);
+        }
         argv[count++] = start;
     }
     return count;
@@ -1261,20 +1307,35 @@ int parse_cmd_options(char * cmd, ParsedOptionsContext *parent_context){
     int ret;
 
     int argc;
-    char * argv[256];
+    // no more tokens than words, a batch of clips easily has thousands. argv[argc] stays NULL
+    int max_args = 1;
+    for (const char * c = cmd; *c; c++) {
+        if (*c == ' ')
+            max_args++;
+    }
+    char ** argv = calloc(max_args + 1, sizeof(*argv));
 
     int cmd_len = strlen(cmd);
     char * recv = calloc(cmd_len + 1,1);
+    if (!argv || !recv) {
+        free(argv);
+        free(recv);
+        return AVERROR(ENOMEM);
+    }
     strcpy(recv,cmd);
 
 
-    argc = parse_command(recv,argv);
+    argc = parse_command(recv,argv,max_args);
 
     ParseContext *p_opctx = malloc(sizeof(ParseContext));
     memset(p_opctx, 0, sizeof(*p_opctx));
     parent_context->parse_context = p_opctx;
 
     p_opctx->copy_cmd = recv;
+    if (argc < 0) {
+        ret = argc;
+        goto fail;
+    }
 
     /* split the commandline into an internal representation */
     ret = split_commandline(p_opctx, argc, argv, options, parent_context);
@@ -1295,7 +1356,7 @@ int parse_cmd_options(char * cmd, ParsedOptionsContext *parent_context){
     for(int i = 0; i < input_list->nb_groups;i++){
         OptionGroup *g = &input_list->groups[i];
         const char * end;
-        if(!av_strstart(g->arg,"filemem:",&end)){
+        if(!av_strstart(g->arg,"filemem:",&end) && !is_b64mem_url(g->arg)){
             need_thread = 1;
             break;
         }
@@ -1304,6 +1365,7 @@ int parse_cmd_options(char * cmd, ParsedOptionsContext *parent_context){
 #endif
 
 fail:
+    free(argv);
     if (ret < 0) {
 //        uninit_parse_context(p_opctx);
 //        parent_context->parse_context = NULL;
@@ -1326,45 +1388,139 @@ int show_hwaccels()
     return 0;
 }
 
-void init_ffmpeg(){
+static pthread_once_t init_once = PTHREAD_ONCE_INIT;
+
+static void init_ffmpeg_once(){
 //    av_register_all();
 #if CONFIG_AVDEVICE
     avdevice_register_all();
 #endif
+    job_log_init();
+    init_option_index();
+}
+
+void init_ffmpeg(){
+    pthread_once(&init_once, init_ffmpeg_once);
+}
+
+void set_thread_budget(int nb_threads){
+    worker_pool_set_budget(nb_threads);
+}
+
+void set_codec_thread_cap(int nb_threads){
+    codec_pool_set_thread_cap(nb_threads);
+}
+
+int flush_seek_index_cache(){
+    return seek_index_flush();
+}
+
+int flush_hw_devices(int only_idle){
+    return hw_registry_flush(only_idle);
+}
+
+void set_hw_device_create_fn(HWDeviceCreateFn fn){
+    hw_registry_set_create_fn(fn);
+}
+
+void set_muxing_queue_budget(int64_t bytes){
+    mux_queue_set_budget(bytes);
+}
+
+void get_muxing_queue_stats(MuxQueueStats *stats){
+    mux_queue_get_stats(stats);
+}
+
+void set_job_log_sink(JobLogSink sink, void *opaque){
+    job_log_set_sink(sink, opaque);
+}
+
+void set_job_log_level(int level){
+    job_log_set_default_level(level);
+}
+
+void get_job_stats(JobStats *stats){
+    job_stats_get(stats);
+}
+
+void reset_job_stats(){
+    job_stats_reset();
+}
+
+int run_ffmpeg_segmented(char * trace_id,char * cmd,int nb_segments){
+    return segment_run(trace_id, cmd, nb_segments);
+}
+
+int run_ffmpeg_clips(char * trace_id,char * input_cmd,char ** clips,int nb_clips){
+    AVBPrint cmd;
+    int i, ret;
+
+    if (nb_clips <= 0)
+        return AVERROR(EINVAL);
+    av_bprint_init(&cmd, 0, AV_BPRINT_SIZE_UNLIMITED);
+    av_bprintf(&cmd, "%s -multi_clip", input_cmd);
+    for (i = 0; i < nb_clips; i++)
+        av_bprintf(&cmd, " %s", clips[i]);
+    if (!av_bprint_is_complete(&cmd)) {
+        av_bprint_finalize(&cmd, NULL);
+        return AVERROR(ENOMEM);
+    }
+    ret = run_ffmpeg_cmd(trace_id, cmd.str);
+    av_bprint_finalize(&cmd, NULL);
+    return ret;
 }
 
 int run_ffmpeg_cmd(char * trace_id,char * cmd){
     int64_t start_time = get_timestamp();
+    int64_t wall_start = av_gettime_relative();
+    int failed = 1;
+    job_stats_start();
     ParsedOptionsContext parent_context;
     memset(&parent_context, 0, sizeof(ParsedOptionsContext));
-    parent_context.raw_context.trace_id = trace_id;
+    RunContext *run_context = &parent_context.raw_context;
+    run_context->trace_id = trace_id;
+    run_context->log_level = job_log_default_level();
+    job_log_enter(run_context);
+
+    job_log_stage(run_context, "parse");
     int ret = parse_cmd_options(cmd, &parent_context);
-    av_log(NULL, AV_LOG_INFO, "tid=%s,parse_cmd_options ret:%d\n",trace_id, ret);
     if (ret < 0) {
-        ffmpegg_cleanup(&parent_context);
-        return 0;
+        job_log(run_context, AV_LOG_ERROR, -1, "parse_cmd_options ret:%d\n", ret);
+        ret = 0;
+        goto end;
     }
 
+    job_log_stage(run_context, "open");
     ret = open_stream(&parent_context);
-    av_log(NULL, AV_LOG_INFO, "tid=%s,open_stream ret:%d\n", trace_id,ret);
-
     if(ret < 0){
-        ffmpegg_cleanup(&parent_context);
-        return 0;
+        job_log(run_context, AV_LOG_ERROR, -1, "open_stream ret:%d\n", ret);
+        ret = 0;
+        goto end;
     }
 
-    if (parent_context.raw_context.option_output.nb_output_files <= 0 && parent_context.raw_context.option_input.nb_input_files == 0) {
-        av_log(NULL, AV_LOG_INFO, "tid=%s,参数错误\n",trace_id);
-        ffmpegg_cleanup(&parent_context);
-        return 0;
+    if (run_context->option_output.nb_output_files <= 0 && run_context->option_input.nb_input_files == 0) {
+        job_log(run_context, AV_LOG_ERROR, -1, "参数错误\n");
+        ret = 0;
+        goto end;
     }
 
+    job_log_stage(run_context, "transcode");
+    ret = transcode(run_context);
+    if (ret < 0)
+        job_log(run_context, AV_LOG_ERROR, -1, "transcode ret:%d\n", ret);
+    failed = ret < 0;
 
-    ret = transcode(&parent_context.raw_context);
-    av_log(NULL, AV_LOG_INFO, "tid=%s,transcode ret:%d\n", trace_id,ret);
+end:
+    job_log_stage(run_context, "cleanup");
     ffmpegg_cleanup(&parent_context);
-    int64_t end_time = get_timestamp();
-    av_log(NULL, AV_LOG_INFO, "tid=%s,cost %ld ms\n",trace_id,end_time - start_time);
+    job_stats_record(run_context, av_gettime_relative() - wall_start, failed);
+    job_log(run_context, AV_LOG_VERBOSE, -1, "cost %ld ms, peak memory %"PRId64" bytes\n",
+            get_timestamp() - start_time, job_mem_peak(run_context));
+    if (run_context->latency.nb)
+        job_log(run_context, AV_LOG_VERBOSE, -1, "packet latency p50 %"PRId64" us, p99 %"PRId64" us\n",
+                latency_hist_percentile(&run_context->latency, 0.50),
+                latency_hist_percentile(&run_context->latency, 0.99));
+    job_log_leave();
     return ret;
 }
 
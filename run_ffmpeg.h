@@ -7,11 +7,58 @@
 
 #include <stdint.h>
 
+typedef struct MuxQueueStats {
+    uint64_t packets_queued;    // packets that went through a muxing queue
+    uint64_t shells_allocated;  // AVPacket shells allocated because the free list was empty
+    int peak_packets;           // most packets held by a single stream queue
+    int64_t peak_data_size;     // most packet data held by a single stream queue
+    int64_t data_size;          // packet data currently held by all queues
+} MuxQueueStats;
 
 
+typedef struct JobStats {
+    uint64_t nb_jobs;
+    uint64_t nb_failed;
+    double jobs_per_sec;        // jobs finished per second since the first recorded job started
+    double realtime_factor;     // output media time / wall time, summed over jobs
+    int64_t p50_ms;             // wall time percentiles of run_ffmpeg_cmd, bucketed
+    int64_t p99_ms;
+    int64_t peak_rss_kb;        // of the whole process
+    int64_t rss_kb;             // current, linux only. sample it every N jobs to spot leaks
+    int64_t peak_job_mem;       // largest bytes one job held in its queues and memory outputs
+    int max_input_queue_depth;  // deepest input thread queue a job ended with
+    int64_t nb_input_send_stalls;   // input threads found their queue full
+    int64_t nb_input_recv_stalls;   // transcode loops found an input queue empty
+    int64_t latency_p50_us;     // input-to-output delay of the packets of -low_latency jobs, bucketed
+    int64_t latency_p99_us;
+    int nb_running;             // jobs inside run_ffmpeg_cmd right now
+} JobStats;
+
+struct AVBufferRef;
+struct AVDictionary;
+/* same arguments as av_hwdevice_ctx_create, type is an enum AVHWDeviceType */
+typedef int (*HWDeviceCreateFn)(struct AVBufferRef **device_ref, int type, const char *device,
+                                struct AVDictionary *opts, int flags);
+
+typedef void (*JobLogSink)(void *opaque, int level, const char *trace_id, const char *stage,
+                           int stream_index, const char *line);
+
 int show_hwaccels();
 void init_ffmpeg();
+void set_thread_budget(int nb_threads);
+void set_codec_thread_cap(int nb_threads);
+int flush_hw_devices(int only_idle);
+void set_hw_device_create_fn(HWDeviceCreateFn fn);
+int flush_seek_index_cache();
+void set_muxing_queue_budget(int64_t bytes);
+void get_muxing_queue_stats(MuxQueueStats *stats);
+void set_job_log_sink(JobLogSink sink, void *opaque);
+void set_job_log_level(int level);
+void get_job_stats(JobStats *stats);
+void reset_job_stats();
 int run_ffmpeg_cmd(char * trace_id,char * cmd);
+int run_ffmpeg_segmented(char * trace_id,char * cmd,int nb_segments);
+int run_ffmpeg_clips(char * trace_id,char * input_cmd,char ** clips,int nb_clips);
 
 int quick_duration(char * trace_id,char *cmd, int64_t * p_duration);
 
@@ -0,0 +1,248 @@
+//
+// Created by hexiufeng on 2026/10/19.
+//
+
+#include "seek_index.h"
+#include <pthread.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <libavutil/avstring.h>
+#include <libavutil/mem.h>
+#include <libavutil/time.h>
+
+#define SEEK_INDEX_BUCKETS 64
+
+typedef struct CachedStream {
+    enum AVMediaType type;
+    AVRational time_base;
+    AVIndexEntry *entries;
+    int nb_entries;
+} CachedStream;
+
+typedef struct SeekIndex {
+    char *url;
+    const AVInputFormat *format;
+    int64_t size;
+    int64_t mtime;
+    int nb_streams;
+    CachedStream *streams;
+    int64_t last_used;
+    struct SeekIndex *next;
+} SeekIndex;
+
+static pthread_mutex_t index_lock = PTHREAD_MUTEX_INITIALIZER;
+static SeekIndex *buckets[SEEK_INDEX_BUCKETS];
+static int nb_files;
+
+static unsigned str_hash(const char *s)
+{
+    unsigned h = 5381;
+    while (*s)
+        h = h * 33 + (unsigned char)*s++;
+    return h;
+}
+
+static int nb_index_entries(AVStream *st)
+{
+#if LIBAVFORMAT_VERSION_MAJOR < 59
+    return st->nb_index_entries;
+#else
+    return avformat_index_get_entries_count(st);
+#endif
+}
+
+static const AVIndexEntry *index_entry(AVStream *st, int idx)
+{
+#if LIBAVFORMAT_VERSION_MAJOR < 59
+    return &st->index_entries[idx];
+#else
+    return avformat_index_get_entry(st, idx);
+#endif
+}
+
+/* only local files can be told apart from a changed copy */
+static int file_identity(AVFormatContext *ic, const char *url, int64_t *size, int64_t *mtime)
+{
+    const char *proto = avio_find_protocol_name(url);
+    const char *path = url;
+    struct stat st;
+
+    // demuxers with an index of their own keep their own meaning in the entries
+    if (!(ic->iformat->flags & AVFMT_GENERIC_INDEX) || !proto || strcmp(proto, "file"))
+        return 0;
+    av_strstart(url, "file:", &path);
+    if (stat(path, &st) || !S_ISREG(st.st_mode))
+        return 0;
+    *size  = st.st_size;
+    *mtime = st.st_mtime;
+    return 1;
+}
+
+static SeekIndex *find_index(const char *url, const AVInputFormat *format, unsigned b)
+{
+    SeekIndex *si;
+    for (si = buckets[b]; si; si = si->next) {
+        if (si->format == format && !strcmp(si->url, url))
+            return si;
+    }
+    return NULL;
+}
+
+static void free_streams(CachedStream *streams, int nb_streams)
+{
+    int i;
+    for (i = 0; i < nb_streams; i++)
+        av_free(streams[i].entries);
+    av_free(streams);
+}
+
+static void unlink_index(SeekIndex *si)
+{
+    SeekIndex **p = &buckets[str_hash(si->url) % SEEK_INDEX_BUCKETS];
+    while (*p != si)
+        p = &(*p)->next;
+    *p = si->next;
+    free_streams(si->streams, si->nb_streams);
+    av_free(si->url);
+    av_free(si);
+    nb_files--;
+}
+
+static void evict_oldest(void)
+{
+    SeekIndex *si, *oldest = NULL;
+    int b;
+
+    for (b = 0; b < SEEK_INDEX_BUCKETS; b++) {
+        for (si = buckets[b]; si; si = si->next) {
+            if (!oldest || si->last_used < oldest->last_used)
+                oldest = si;
+        }
+    }
+    if (oldest)
+        unlink_index(oldest);
+}
+
+int seek_index_apply(AVFormatContext *ic, const char *url)
+{
+    unsigned b = str_hash(url) % SEEK_INDEX_BUCKETS;
+    int64_t size, mtime;
+    SeekIndex *si;
+    int i, j, added = 0;
+
+    if (!file_identity(ic, url, &size, &mtime))
+        return 0;
+
+    pthread_mutex_lock(&index_lock);
+    si = find_index(url, ic->iformat, b);
+    if (si && (si->size != size || si->mtime != mtime)) {
+        unlink_index(si);
+        si = NULL;
+    }
+    if (si && si->nb_streams == ic->nb_streams) {
+        si->last_used = av_gettime_relative();
+        for (i = 0; i < ic->nb_streams; i++) {
+            AVStream *st = ic->streams[i];
+            const CachedStream *cs = &si->streams[i];
+            if (cs->type != st->codecpar->codec_type || av_cmp_q(cs->time_base, st->time_base))
+                continue;
+            for (j = 0; j < cs->nb_entries; j++) {
+                const AVIndexEntry *e = &cs->entries[j];
+                if (av_add_index_entry(st, e->pos, e->timestamp, e->size, e->min_distance, e->flags) >= 0)
+                    added++;
+            }
+        }
+    }
+    pthread_mutex_unlock(&index_lock);
+    return added;
+}
+
+void seek_index_save(AVFormatContext *ic, const char *url)
+{
+    unsigned b = str_hash(url) % SEEK_INDEX_BUCKETS;
+    CachedStream *streams;
+    int64_t size, mtime;
+    int64_t total = 0, cached = 0;
+    SeekIndex *si;
+    int i, j;
+
+    if (!ic->nb_streams || !file_identity(ic, url, &size, &mtime))
+        return;
+
+    streams = av_mallocz_array(ic->nb_streams, sizeof(*streams));
+    if (!streams)
+        return;
+    for (i = 0; i < ic->nb_streams; i++) {
+        AVStream *st = ic->streams[i];
+        CachedStream *cs = &streams[i];
+        int nb = nb_index_entries(st);
+
+        cs->type      = st->codecpar->codec_type;
+        cs->time_base = st->time_base;
+        if (!nb)
+            continue;
+        cs->entries = av_malloc_array(nb, sizeof(*cs->entries));
+        if (!cs->entries) {
+            free_streams(streams, ic->nb_streams);
+            return;
+        }
+        for (j = 0; j < nb; j++)
+            cs->entries[j] = *index_entry(st, j);
+        cs->nb_entries = nb;
+        total += nb;
+    }
+
+    pthread_mutex_lock(&index_lock);
+    si = find_index(url, ic->iformat, b);
+    if (si && si->size == size && si->mtime == mtime && si->nb_streams == ic->nb_streams) {
+        for (i = 0; i < si->nb_streams; i++)
+            cached += si->streams[i].nb_entries;
+    } else if (si) {
+        unlink_index(si);
+        si = NULL;
+    }
+    // a job that read less than the ones before it knows nothing new
+    if (si && total <= cached) {
+        si->last_used = av_gettime_relative();
+        pthread_mutex_unlock(&index_lock);
+        free_streams(streams, ic->nb_streams);
+        return;
+    }
+    if (!si) {
+        if (nb_files >= SEEK_INDEX_MAX_FILES)
+            evict_oldest();
+        if (!(si = av_mallocz(sizeof(*si))) || !(si->url = av_strdup(url))) {
+            av_free(si);
+            pthread_mutex_unlock(&index_lock);
+            free_streams(streams, ic->nb_streams);
+            return;
+        }
+        si->format = ic->iformat;
+        si->size   = size;
+        si->mtime  = mtime;
+        si->next   = buckets[b];
+        buckets[b] = si;
+        nb_files++;
+    } else {
+        free_streams(si->streams, si->nb_streams);
+    }
+    si->nb_streams = ic->nb_streams;
+    si->streams    = streams;
+    si->last_used  = av_gettime_relative();
+    pthread_mutex_unlock(&index_lock);
+}
+
+int seek_index_flush(void)
+{
+    int nb = 0, b;
+
+    pthread_mutex_lock(&index_lock);
+    for (b = 0; b < SEEK_INDEX_BUCKETS; b++) {
+        while (buckets[b]) {
+            unlink_index(buckets[b]);
+            nb++;
+        }
+    }
+    pthread_mutex_unlock(&index_lock);
+    return nb;
+}
@@ -0,0 +1,28 @@
+//
+// Created by hexiufeng on 2026/10/19.
+//
+
+#ifndef RUN_FFMPEG_SEEK_INDEX_H
+#define RUN_FFMPEG_SEEK_INDEX_H
+
+#include <libavformat/avformat.h>
+
+/*
+ * process-wide cache of the keyframe index libavformat builds while reading formats
+ * without an index of their own (AVFMT_GENERIC_INDEX: mp3, adts, raw streams...).
+ * a job saves the index of its input when it closes it, the next job on the same local
+ * file gets the entries before seeking, so -ss jumps to the nearest known keyframe
+ * instead of scanning from the start. the index grows with every job that reads further.
+ * entries are keyed by url, format, size and mtime, a changed file is indexed again.
+ */
+
+#define SEEK_INDEX_MAX_FILES 128
+
+/* returns the number of entries added to ic */
+int seek_index_apply(AVFormatContext *ic, const char *url);
+void seek_index_save(AVFormatContext *ic, const char *url);
+
+/* returns the number of files dropped */
+int seek_index_flush(void);
+
+#endif //RUN_FFMPEG_SEEK_INDEX_H
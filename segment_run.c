@@ -0,0 +1,587 @@
+//
+// Created by hexiufeng on 2026/10/19.
+//
+
+#include "segment_run.h"
+#include "run_ffmpeg.h"
+#include "mem_io.h"
+#include "opt_route.h"
+#include <ctype.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include <libavutil/avstring.h>
+#include <libavutil/bprint.h>
+#include <libavutil/channel_layout.h>
+#include <libavutil/cpu.h>
+#include <libavutil/mathematics.h>
+
+#define SEGMENT_MAX_ARGS 256
+#define SEGMENT_MAX 32
+#define SEGMENT_MIN_DURATION (30 * (int64_t)AV_TIME_BASE)
+/* encoder frames every audio piece also covers before and after its window */
+#define SEGMENT_OVERLAP_FRAMES 8
+/*
+ * added to every piece timestamp by its muxer. nut can't store negative timestamps and would
+ * otherwise shift each piece by its own b-frame delay or audio priming, which the stitch can't
+ * tell apart from the window start. with the offset nothing is negative and nothing moves.
+ */
+#define SEGMENT_TS_OFFSET (10 * (int64_t)AV_TIME_BASE)
+
+typedef struct SegmentPlan {
+    char *buf;                  // the split command line, argv points into it
+    char *argv[SEGMENT_MAX_ARGS];
+    int argc;
+    int input;                  // index of the input url in argv
+    const char *in_format;
+    const char *out_format;
+    const char *audio_codec;
+    int sample_rate;
+    int channels;
+    int no_video;
+    int no_audio;
+
+    int nb;
+    int64_t bounds[SEGMENT_MAX + 1];    // windows on the input timeline, AV_TIME_BASE
+    int64_t cuts[SEGMENT_MAX + 1];      // where audio packets switch piece, between two frames
+    int64_t overlap;
+    int64_t duration;
+} SegmentPlan;
+
+/* numbers the calls of the process, so concurrent calls for the same output use their own pieces */
+static atomic_uint segment_calls;
+
+typedef struct SegmentJob {
+    char trace_id[128];
+    char *cmd;
+    char path[1024];
+    int ret;
+} SegmentJob;
+
+static const char *const unsupported_opts[] = {
+    "ss", "t", "to", "sseof", "re", "stream_loop", "itsoffset", "filter_complex", "lavfi",
+    "filter_complex_script", "frames", "vframes", "aframes", "dframes", "fs", "shortest", NULL
+};
+
+static int is_option_name(const char *arg)
+{
+    return arg[0] == '-' && arg[1] && !isdigit((unsigned char)arg[1]) && arg[1] != '.';
+}
+
+/* "-name" or "-name:<stream specifier>" */
+static int option_is(const char *arg, const char *name)
+{
+    size_t len = strlen(name);
+    return arg[0] == '-' && !strncmp(arg + 1, name, len) && (!arg[len + 1] || arg[len + 1] == ':');
+}
+
+static int is_muxer_option(const char *arg)
+{
+    OptRoute route;
+    if (opt_route_get(arg + 1, &route) < 0)
+        return 0;
+    return route.layers == OPT_ROUTE_FORMAT;
+}
+
+/* index of the value of the option at i in the output options, 0 for a flag */
+static int option_value(const SegmentPlan *plan, int i)
+{
+    return i + 1 < plan->argc - 1 && !is_option_name(plan->argv[i + 1]) ? i + 1 : 0;
+}
+
+static int parse_plan(const char *trace_id, const char *cmd, SegmentPlan *plan)
+{
+    char *saveptr = NULL, *tok;
+    int i, j, v;
+
+    plan->buf = av_strdup(cmd);
+    if (!plan->buf)
+        return AVERROR(ENOMEM);
+    for (tok = av_strtok(plan->buf, " ", &saveptr); tok; tok = av_strtok(NULL, " ", &saveptr)) {
+        if (plan->argc == SEGMENT_MAX_ARGS)
+            return AVERROR(ENOSYS);
+        plan->argv[plan->argc++] = tok;
+    }
+
+    for (i = 1; i < plan->argc; i++) {
+        if (!strcmp(plan->argv[i], "-i")) {
+            if (plan->input || i + 1 >= plan->argc)
+                return AVERROR(ENOSYS);
+            plan->input = ++i;
+            continue;
+        }
+        for (j = 0; unsupported_opts[j]; j++) {
+            if (option_is(plan->argv[i], unsupported_opts[j])) {
+                av_log(NULL, AV_LOG_VERBOSE, "tid=%s,%s is not split into segments\n",
+                       trace_id, plan->argv[i]);
+                return AVERROR(ENOSYS);
+            }
+        }
+    }
+    // one input, then output options, then the output
+    if (!plan->input || plan->input + 1 >= plan->argc || is_option_name(plan->argv[plan->argc - 1]))
+        return AVERROR(ENOSYS);
+
+    for (i = 1; i < plan->input - 1; i++) {
+        if (!strcmp(plan->argv[i], "-f"))
+            plan->in_format = plan->argv[i + 1];
+    }
+
+    for (i = plan->input + 1; i < plan->argc - 1; i++) {
+        const char *arg = plan->argv[i];
+        if (!is_option_name(arg))
+            continue;
+        v = option_value(plan, i);
+        if (!strcmp(arg, "-vn")) {
+            plan->no_video = 1;
+        } else if (!strcmp(arg, "-an")) {
+            plan->no_audio = 1;
+        } else if (v && !strcmp(arg, "-f")) {
+            plan->out_format = plan->argv[v];
+        } else if (v && (option_is(arg, "c") || option_is(arg, "codec") || option_is(arg, "acodec") ||
+                         option_is(arg, "vcodec") || option_is(arg, "scodec"))) {
+            // pieces of a stream copy would just be cut at other packets
+            if (!strcmp(plan->argv[v], "copy"))
+                return AVERROR(ENOSYS);
+            if (!strcmp(arg, "-acodec") || !strcmp(arg, "-c:a") || !strcmp(arg, "-codec:a") ||
+                (!plan->audio_codec && (!strcmp(arg, "-c") || !strcmp(arg, "-codec"))))
+                plan->audio_codec = plan->argv[v];
+        } else if (v && (!strcmp(arg, "-ar") || !strcmp(arg, "-ar:a"))) {
+            plan->sample_rate = atoi(plan->argv[v]);
+        } else if (v && (!strcmp(arg, "-ac") || !strcmp(arg, "-ac:a"))) {
+            plan->channels = atoi(plan->argv[v]);
+        }
+        if (v)
+            i = v;
+    }
+    return 0;
+}
+
+/* frame size and rate the output audio encoder will run with, 0 when frames may have any size */
+static int probe_audio_frame(const SegmentPlan *plan, const AVStream *st, int *frame_size, int *sample_rate)
+{
+    const char *out = plan->argv[plan->argc - 1];
+    const AVCodec *enc = NULL;
+    AVCodecContext *ctx;
+    int ret, i;
+
+    *frame_size = 0;
+    if (plan->audio_codec) {
+        enc = avcodec_find_encoder_by_name(plan->audio_codec);
+    } else {
+        const AVOutputFormat *ofmt = av_guess_format(plan->out_format, out, NULL);
+        if (ofmt)
+            enc = avcodec_find_encoder(av_guess_codec((AVOutputFormat *)ofmt, NULL, out, NULL,
+                                                      AVMEDIA_TYPE_AUDIO));
+    }
+    if (!enc)
+        return AVERROR_ENCODER_NOT_FOUND;
+
+    ctx = avcodec_alloc_context3(enc);
+    if (!ctx)
+        return AVERROR(ENOMEM);
+    ctx->sample_rate = plan->sample_rate ? plan->sample_rate : st->codecpar->sample_rate;
+    if (!ctx->sample_rate) {
+        avcodec_free_context(&ctx);
+        return AVERROR(EINVAL);
+    }
+    if (enc->supported_samplerates) {
+        int best = enc->supported_samplerates[0];
+        for (i = 0; enc->supported_samplerates[i]; i++) {
+            if (FFABS(enc->supported_samplerates[i] - ctx->sample_rate) < FFABS(best - ctx->sample_rate))
+                best = enc->supported_samplerates[i];
+        }
+        ctx->sample_rate = best;
+    }
+    ctx->channels = plan->channels ? plan->channels :
+                    st->codecpar->channels ? st->codecpar->channels : 2;
+    ctx->channel_layout = av_get_default_channel_layout(ctx->channels);
+    if (enc->channel_layouts) {
+        for (i = 0; enc->channel_layouts[i] && enc->channel_layouts[i] != ctx->channel_layout; i++)
+            ;
+        if (!enc->channel_layouts[i]) {
+            ctx->channel_layout = enc->channel_layouts[0];
+            ctx->channels = av_get_channel_layout_nb_channels(ctx->channel_layout);
+        }
+    }
+    ctx->sample_fmt = enc->sample_fmts ? enc->sample_fmts[0] : AV_SAMPLE_FMT_S16;
+    ctx->time_base = (AVRational){ 1, ctx->sample_rate };
+
+    ret = avcodec_open2(ctx, enc, NULL);
+    if (ret >= 0 && !(enc->capabilities & AV_CODEC_CAP_VARIABLE_FRAME_SIZE)) {
+        *frame_size  = ctx->frame_size;
+        *sample_rate = ctx->sample_rate;
+    }
+    avcodec_free_context(&ctx);
+    return ret;
+}
+
+static int64_t keyframe_before(AVFormatContext *ic, AVStream *st, int64_t t)
+{
+    int64_t start = ic->start_time != AV_NOPTS_VALUE ? ic->start_time : 0;
+    int64_t ts = av_rescale_q(t + start, AV_TIME_BASE_Q, st->time_base);
+    int idx = av_index_search_timestamp(st, ts, AVSEEK_FLAG_BACKWARD);
+
+    if (idx < 0)
+        return t;
+#if LIBAVFORMAT_VERSION_MAJOR < 59
+    ts = st->index_entries[idx].timestamp;
+#else
+    ts = avformat_index_get_entry(st, idx)->timestamp;
+#endif
+    return av_rescale_q(ts, st->time_base, AV_TIME_BASE_Q) - start;
+}
+
+/* opens the input header only, a container index is enough to place the cuts */
+static int plan_segments(const char *trace_id, SegmentPlan *plan, int nb_segments)
+{
+    const char *in = plan->argv[plan->input];
+    AVFormatContext *ic = NULL;
+    AVStream *video = NULL, *audio = NULL;
+    int frame_size = 0, sample_rate = 0;
+    int ret, i, k;
+
+    ret = avformat_open_input(&ic, in, plan->in_format ? av_find_input_format(plan->in_format) : NULL, NULL);
+    if (ret < 0)
+        return ret;
+    if (ic->duration == AV_NOPTS_VALUE && (ret = avformat_find_stream_info(ic, NULL)) < 0)
+        goto end;
+    if (ic->duration == AV_NOPTS_VALUE) {
+        ret = AVERROR(ENOSYS);
+        goto end;
+    }
+    plan->duration = ic->duration;
+
+    for (i = 0; i < ic->nb_streams; i++) {
+        AVStream *st = ic->streams[i];
+        if (!video && st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO &&
+            !(st->disposition & AV_DISPOSITION_ATTACHED_PIC))
+            video = st;
+        if (!audio && st->codecpar->codec_type == AVMEDIA_TYPE_AUDIO)
+            audio = st;
+    }
+    if (plan->no_video)
+        video = NULL;
+    if (plan->no_audio)
+        audio = NULL;
+
+    /*
+     * pieces cut on video keyframes can't overlap their audio, so an encoder with priming or a
+     * padded last frame would leave a gap at every cut. only variable frame size audio
+     * (pcm and the like) is split together with video.
+     */
+    if (video && audio && (probe_audio_frame(plan, audio, &frame_size, &sample_rate) < 0 || frame_size > 0)) {
+        av_log(NULL, AV_LOG_VERBOSE, "tid=%s,audio with video is not split into segments\n", trace_id);
+        ret = AVERROR(ENOSYS);
+        goto end;
+    }
+
+    plan->nb = nb_segments > 0 ? nb_segments : av_cpu_count();
+    plan->nb = FFMIN(plan->nb, SEGMENT_MAX);
+    plan->nb = (int)FFMIN(plan->nb, plan->duration / SEGMENT_MIN_DURATION);
+    if (plan->nb < 2) {
+        ret = AVERROR(ENOSYS);
+        goto end;
+    }
+
+    // overlapping pieces only stitch without a gap when every cut is on the encoder frame grid
+    if (!video && audio && probe_audio_frame(plan, audio, &frame_size, &sample_rate) >= 0 && frame_size > 0)
+        plan->overlap = av_rescale(SEGMENT_OVERLAP_FRAMES * frame_size, AV_TIME_BASE, sample_rate);
+
+    plan->bounds[0] = 0;
+    plan->bounds[plan->nb] = plan->duration;
+    for (k = 1; k < plan->nb; k++) {
+        int64_t t = plan->duration * k / plan->nb;
+        if (video) {
+            int64_t key = keyframe_before(ic, video, t);
+            if (key > plan->bounds[k - 1] + SEGMENT_MIN_DURATION / 2)
+                t = key;
+        } else if (plan->overlap) {
+            int64_t frames = av_rescale_rnd(t, sample_rate, (int64_t)AV_TIME_BASE * frame_size, AV_ROUND_NEAR_INF);
+            t = av_rescale(frames * frame_size, AV_TIME_BASE, sample_rate);
+        }
+        plan->bounds[k] = t;
+    }
+    for (k = 0; k <= plan->nb; k++) {
+        plan->cuts[k] = plan->bounds[k];
+        // half a frame early, clear of the rounding of packet timestamps on either piece
+        if (plan->overlap && k && k < plan->nb)
+            plan->cuts[k] -= av_rescale(frame_size, AV_TIME_BASE, 2 * sample_rate);
+    }
+
+    av_log(NULL, AV_LOG_INFO, "tid=%s,%d segments of %"PRId64" us, overlap %"PRId64" us\n",
+           trace_id, plan->nb, plan->duration / plan->nb, plan->overlap);
+    ret = 0;
+end:
+    avformat_close_input(&ic);
+    return ret;
+}
+
+static int64_t segment_start(const SegmentPlan *plan, int k)
+{
+    return k ? FFMAX(plan->bounds[k] - plan->overlap, 0) : 0;
+}
+
+static void print_time(AVBPrint *bp, int64_t t)
+{
+    av_bprintf(bp, "%"PRId64".%06d", t / AV_TIME_BASE, (int)(t % AV_TIME_BASE));
+}
+
+/* same command with the window as input options, the muxer and its options left to the stitch */
+static int build_segment_cmd(const SegmentPlan *plan, int k, const char *path, char **cmd)
+{
+    int64_t start = segment_start(plan, k);
+    AVBPrint bp;
+    int i, v;
+
+    av_bprint_init(&bp, 0, AV_BPRINT_SIZE_UNLIMITED);
+    for (i = 0; i < plan->input - 1; i++)
+        av_bprintf(&bp, "%s ", plan->argv[i]);
+    // a piece left by a crashed process with the same pid is overwritten
+    av_bprintf(&bp, "-y -ss ");
+    print_time(&bp, start);
+    if (k < plan->nb - 1) {
+        av_bprintf(&bp, " -t ");
+        print_time(&bp, FFMIN(plan->bounds[k + 1] + plan->overlap, plan->duration) - start);
+    }
+    av_bprintf(&bp, " -i %s ", plan->argv[plan->input]);
+    for (i = plan->input + 1; i < plan->argc - 1; i++) {
+        const char *arg = plan->argv[i];
+        v = is_option_name(arg) ? option_value(plan, i) : 0;
+        if (v && (!strcmp(arg, "-f") || is_muxer_option(arg))) {
+            i = v;
+            continue;
+        }
+        av_bprintf(&bp, "%s ", arg);
+    }
+    av_bprintf(&bp, "-output_ts_offset ");
+    print_time(&bp, SEGMENT_TS_OFFSET);
+    av_bprintf(&bp, " -f nut %s", path);
+    return av_bprint_finalize(&bp, cmd);
+}
+
+static void *segment_thread(void *arg)
+{
+    SegmentJob *job = arg;
+    job->ret = run_ffmpeg_cmd(job->trace_id, job->cmd);
+    return NULL;
+}
+
+static int open_output(const SegmentPlan *plan, AVFormatContext *ic, AVFormatContext **poc)
+{
+    const char *out = plan->argv[plan->argc - 1];
+    AVDictionary *opts = NULL;
+    AVDictionaryEntry *e = NULL;
+    AVFormatContext *oc;
+    int ret, i, v;
+
+    ret = avformat_alloc_output_context2(poc, NULL, plan->out_format, out);
+    if (ret < 0)
+        return ret;
+    oc = *poc;
+
+    for (i = 0; i < ic->nb_streams; i++) {
+        AVStream *ist = ic->streams[i], *ost = avformat_new_stream(oc, NULL);
+        if (!ost)
+            return AVERROR(ENOMEM);
+        if ((ret = avcodec_parameters_copy(ost->codecpar, ist->codecpar)) < 0)
+            return ret;
+        ost->codecpar->codec_tag = 0;
+        ost->time_base           = ist->time_base;
+        ost->avg_frame_rate      = ist->avg_frame_rate;
+        ost->r_frame_rate        = ist->r_frame_rate;
+        ost->sample_aspect_ratio = ist->sample_aspect_ratio;
+        ost->disposition         = ist->disposition;
+        av_dict_copy(&ost->metadata, ist->metadata, 0);
+    }
+    av_dict_copy(&oc->metadata, ic->metadata, 0);
+
+    for (i = plan->input + 1; i < plan->argc - 1; i++) {
+        const char *arg = plan->argv[i];
+        v = is_option_name(arg) ? option_value(plan, i) : 0;
+        if (v && strcmp(arg, "-f") && is_muxer_option(arg))
+            av_dict_set(&opts, arg + 1, plan->argv[v], 0);
+        if (v)
+            i = v;
+    }
+
+    if (!(oc->oformat->flags & AVFMT_NOFILE) &&
+        (ret = avio_open(&oc->pb, out, AVIO_FLAG_WRITE)) < 0) {
+        av_dict_free(&opts);
+        return ret;
+    }
+    ret = avformat_write_header(oc, &opts);
+    while ((e = av_dict_get(opts, "", e, AV_DICT_IGNORE_SUFFIX)))
+        av_log(NULL, AV_LOG_WARNING, "Option %s not used by the %s muxer\n", e->key, oc->oformat->name);
+    av_dict_free(&opts);
+    return ret;
+}
+
+static int stitch(const char *trace_id, const SegmentPlan *plan, const SegmentJob *jobs)
+{
+    AVFormatContext *ic = NULL, *oc = NULL;
+    AVPacket *pkt;
+    int ret = 0, k;
+
+    pkt = av_packet_alloc();
+    if (!pkt)
+        return AVERROR(ENOMEM);
+
+    for (k = 0; k < plan->nb; k++) {
+        // piece timestamps count from the window start, plus the offset their muxer added
+        int64_t start = segment_start(plan, k) - SEGMENT_TS_OFFSET;
+
+        if ((ret = avformat_open_input(&ic, jobs[k].path, NULL, NULL)) < 0) {
+            av_log(NULL, AV_LOG_ERROR, "tid=%s,segment %d missing: %s\n", trace_id, k, av_err2str(ret));
+            goto end;
+        }
+        if (!oc) {
+            if ((ret = open_output(plan, ic, &oc)) < 0)
+                goto end;
+        } else if (ic->nb_streams != oc->nb_streams) {
+            av_log(NULL, AV_LOG_ERROR, "tid=%s,segment %d has %d streams, expected %d\n",
+                   trace_id, k, ic->nb_streams, oc->nb_streams);
+            ret = AVERROR(EINVAL);
+            goto end;
+        }
+
+        while ((ret = av_read_frame(ic, pkt)) >= 0) {
+            AVStream *ist = ic->streams[pkt->stream_index];
+            int64_t ts = pkt->pts != AV_NOPTS_VALUE ? pkt->pts : pkt->dts;
+            int64_t offset = av_rescale_q(start, AV_TIME_BASE_Q, ist->time_base);
+
+            // audio is encoded past both ends of the window, keep only its own frames
+            if (ist->codecpar->codec_type == AVMEDIA_TYPE_AUDIO && ts != AV_NOPTS_VALUE) {
+                int64_t t = av_rescale_q(ts, ist->time_base, AV_TIME_BASE_Q) + start;
+                if ((k && t < plan->cuts[k]) || (k < plan->nb - 1 && t >= plan->cuts[k + 1])) {
+                    av_packet_unref(pkt);
+                    continue;
+                }
+            }
+            if (pkt->pts != AV_NOPTS_VALUE)
+                pkt->pts += offset;
+            if (pkt->dts != AV_NOPTS_VALUE)
+                pkt->dts += offset;
+            av_packet_rescale_ts(pkt, ist->time_base, oc->streams[pkt->stream_index]->time_base);
+            pkt->pos = -1;
+            if ((ret = av_interleaved_write_frame(oc, pkt)) < 0)
+                goto end;
+        }
+        if (ret != AVERROR_EOF)
+            goto end;
+        avformat_close_input(&ic);
+    }
+    ret = av_write_trailer(oc);
+
+end:
+    if (ret < 0)
+        av_log(NULL, AV_LOG_ERROR, "tid=%s,stitching segments failed: %s\n", trace_id, av_err2str(ret));
+    av_packet_free(&pkt);
+    avformat_close_input(&ic);
+    if (oc && !(oc->oformat->flags & AVFMT_NOFILE))
+        avio_closep(&oc->pb);
+    avformat_free_context(oc);
+    return ret;
+}
+
+static int run_plain(const char *trace_id, const char *cmd)
+{
+    char *tid = av_strdup(trace_id), *copy = av_strdup(cmd);
+    int ret = AVERROR(ENOMEM);
+
+    if (tid && copy)
+        ret = run_ffmpeg_cmd(tid, copy);
+    av_free(tid);
+    av_free(copy);
+    return ret;
+}
+
+int segment_run(const char *trace_id, const char *cmd, int nb_segments)
+{
+    SegmentPlan plan = { 0 };
+    SegmentJob *jobs = NULL;
+    pthread_t threads[SEGMENT_MAX];
+    int started[SEGMENT_MAX] = { 0 };
+    const char *in, *out, *path;
+    unsigned call;
+    int ret, k;
+
+    ret = parse_plan(trace_id, cmd, &plan);
+    if (ret < 0)
+        goto plain;
+    in  = plan.argv[plan.input];
+    out = plan.argv[plan.argc - 1];
+    // the pieces are written next to the output, memory inputs/outputs stay in one job
+    if (mem_url_data(in) || is_b64mem_url(in) || mem_url_data(out) || is_b64mem_url(out) ||
+        !avio_find_protocol_name(out) || strcmp(avio_find_protocol_name(out), "file")) {
+        ret = AVERROR(ENOSYS);
+        goto plain;
+    }
+    if ((ret = plan_segments(trace_id, &plan, nb_segments)) < 0)
+        goto plain;
+
+    jobs = av_calloc(plan.nb, sizeof(*jobs));
+    if (!jobs) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    path = out;
+    av_strstart(out, "file:", &path);
+    call = atomic_fetch_add(&segment_calls, 1);
+    for (k = 0; k < plan.nb; k++) {
+        snprintf(jobs[k].trace_id, sizeof(jobs[k].trace_id), "%s-seg%d", trace_id, k);
+        snprintf(jobs[k].path, sizeof(jobs[k].path), "%s.%d-%u.seg%d.nut", path, (int)getpid(), call, k);
+        if ((ret = build_segment_cmd(&plan, k, jobs[k].path, &jobs[k].cmd)) < 0)
+            goto end;
+    }
+    for (k = 0; k < plan.nb; k++) {
+        started[k] = !pthread_create(&threads[k], NULL, segment_thread, &jobs[k]);
+        if (!started[k])
+            segment_thread(&jobs[k]);
+    }
+    for (k = 0; k < plan.nb; k++) {
+        if (started[k])
+            pthread_join(threads[k], NULL);
+    }
+    for (k = 0; k < plan.nb; k++) {
+        struct stat st;
+
+        if (jobs[k].ret < 0) {
+            av_log(NULL, AV_LOG_ERROR, "tid=%s,segment %d failed: %d\n", trace_id, k, jobs[k].ret);
+            ret = jobs[k].ret;
+            goto end;
+        }
+        // run_ffmpeg_cmd returns 0 when the command did not even parse, the piece tells
+        if (stat(jobs[k].path, &st) < 0 || !st.st_size) {
+            av_log(NULL, AV_LOG_ERROR, "tid=%s,segment %d wrote no output\n", trace_id, k);
+            ret = AVERROR(EIO);
+            goto end;
+        }
+    }
+    ret = stitch(trace_id, &plan, jobs);
+
+end:
+    if (jobs) {
+        for (k = 0; k < plan.nb; k++) {
+            if (jobs[k].path[0])
+                unlink(jobs[k].path);
+            av_free(jobs[k].cmd);
+        }
+        av_free(jobs);
+    }
+    av_free(plan.buf);
+    return ret;
+
+plain:
+    av_free(plan.buf);
+    if (ret != AVERROR(ENOSYS))
+        av_log(NULL, AV_LOG_WARNING, "tid=%s,can't plan segments: %s\n", trace_id, av_err2str(ret));
+    return run_plain(trace_id, cmd);
+}
@@ -0,0 +1,27 @@
+//
+// Created by hexiufeng on 2026/10/19.
+//
+
+#ifndef RUN_FFMPEG_SEGMENT_RUN_H
+#define RUN_FFMPEG_SEGMENT_RUN_H
+
+/*
+ * split-and-stitch for one long input: the input timeline is cut into nb_segments windows,
+ * each is transcoded by its own run_ffmpeg_cmd() with -ss/-t on the same input into a nut
+ * file next to the output, named after the pid and a per call number, and the pieces are
+ * copied into the output with their timestamps moved back to the input timeline. the pieces
+ * are removed whether the call succeeds or not.
+ *
+ * for audio only outputs the windows lie on the encoder frame grid and every piece is encoded
+ * with a few frames of overlap on both sides, so priming and the final padded frame fall
+ * outside the window and the stitched stream has no gap. with video the cuts are moved to
+ * keyframes of the input index, and an output that also encodes audio in frames of a fixed
+ * size (aac, mp3, opus...) runs as one job, as its pieces can't overlap.
+ *
+ * commands it can't split (one input and one local file output, no -ss/-t/-to, filter_complex,
+ * stream copy...) or inputs too short for two segments run as a plain run_ffmpeg_cmd().
+ * nb_segments <= 0 uses the number of cpus.
+ */
+int segment_run(const char *trace_id, const char *cmd, int nb_segments);
+
+#endif //RUN_FFMPEG_SEGMENT_RUN_H
@@ -0,0 +1,180 @@
+//
+// Created by hexiufeng on 2026/10/19.
+//
+
+#include <stdio.h>
+#include <libavutil/channel_layout.h>
+#include <libavutil/error.h>
+#include <libavutil/samplefmt.h>
+#include "audio_convert.h"
+
+static int failures;
+
+#define CHECK(cond, ...) do {                                       \
+    if (!(cond)) {                                                  \
+        fprintf(stderr, "%s:%d: ", __FILE__, __LINE__);             \
+        fprintf(stderr, __VA_ARGS__);                               \
+        fprintf(stderr, "\n");                                      \
+        failures++;                                                 \
+    }                                                               \
+} while (0)
+
+/* the expected picks are what the aformat negotiation of lavfi ends with */
+static void test_pick_format(void)
+{
+    static const int planar[] = { AV_SAMPLE_FMT_FLTP, AV_SAMPLE_FMT_S16P, AV_SAMPLE_FMT_NONE };
+    static const int wide[]   = { AV_SAMPLE_FMT_S16, AV_SAMPLE_FMT_DBL, AV_SAMPLE_FMT_NONE };
+    static const int narrow[] = { AV_SAMPLE_FMT_U8, AV_SAMPLE_FMT_S32, AV_SAMPLE_FMT_NONE };
+
+    CHECK(audio_convert_pick_format(NULL, AV_SAMPLE_FMT_S16) == AV_SAMPLE_FMT_S16, "no list");
+    CHECK(audio_convert_pick_format(planar, AV_SAMPLE_FMT_FLTP) == AV_SAMPLE_FMT_FLTP, "exact");
+    CHECK(audio_convert_pick_format(planar, AV_SAMPLE_FMT_S16) == AV_SAMPLE_FMT_S16P, "planar of s16");
+    CHECK(audio_convert_pick_format(wide, AV_SAMPLE_FMT_FLT) == AV_SAMPLE_FMT_DBL, "float to double");
+    CHECK(audio_convert_pick_format(narrow, AV_SAMPLE_FMT_S16) == AV_SAMPLE_FMT_S32, "higher bps first");
+    CHECK(audio_convert_pick_format(narrow, AV_SAMPLE_FMT_DBL) == AV_SAMPLE_FMT_S32, "closest lower bps");
+}
+
+static void test_pick_rate(void)
+{
+    static const int rates[] = { 44100, 48000, 32000, 0 };
+
+    CHECK(audio_convert_pick_rate(NULL, 22050) == 22050, "no list");
+    CHECK(audio_convert_pick_rate(rates, 48000) == 48000, "exact");
+    CHECK(audio_convert_pick_rate(rates, 47000) == 48000, "nearest above");
+    CHECK(audio_convert_pick_rate(rates, 8000) == 32000, "nearest below");
+    CHECK(audio_convert_pick_rate(rates, 46050) == 44100, "tie keeps the first");
+}
+
+static void test_pick_layout(void)
+{
+    static const uint64_t mp3[]      = { AV_CH_LAYOUT_MONO, AV_CH_LAYOUT_STEREO, 0 };
+    static const uint64_t surround[] = { AV_CH_LAYOUT_STEREO, AV_CH_LAYOUT_5POINT1, AV_CH_LAYOUT_5POINT1_BACK, 0 };
+    static const uint64_t wide[]     = { AV_CH_LAYOUT_5POINT1, AV_CH_LAYOUT_STEREO, 0 };
+
+    CHECK(audio_convert_pick_layout(NULL, AV_CH_LAYOUT_STEREO) == AV_CH_LAYOUT_STEREO, "no list");
+    CHECK(audio_convert_pick_layout(mp3, AV_CH_LAYOUT_STEREO) == AV_CH_LAYOUT_STEREO, "exact");
+    // no layout with 6 channels, the shared front pair wins over the channel count
+    CHECK(audio_convert_pick_layout(mp3, AV_CH_LAYOUT_5POINT1) == AV_CH_LAYOUT_STEREO, "5.1 into mp3");
+    CHECK(audio_convert_pick_layout(mp3, AV_CH_LAYOUT_QUAD) == AV_CH_LAYOUT_STEREO, "quad into mp3");
+    // a center substitutes the front pair, cheaper than three extra channels
+    CHECK(audio_convert_pick_layout(surround, AV_CH_LAYOUT_MONO) == AV_CH_LAYOUT_STEREO, "mono upmix");
+    // the exact layout beats 5.1 with its side pair standing in for the back pair
+    CHECK(audio_convert_pick_layout(surround, AV_CH_LAYOUT_5POINT1_BACK) == AV_CH_LAYOUT_5POINT1_BACK, "exact back");
+    CHECK(audio_convert_pick_layout(wide, AV_CH_LAYOUT_7POINT1) == AV_CH_LAYOUT_5POINT1, "7.1 into 5.1");
+}
+
+static AVFrame *make_frame(int format, int rate, uint64_t layout, int nb_samples, int64_t pts)
+{
+    AVFrame *f = av_frame_alloc();
+
+    f->format         = format;
+    f->sample_rate    = rate;
+    f->channel_layout = layout;
+    f->channels       = av_get_channel_layout_nb_channels(layout);
+    f->nb_samples     = nb_samples;
+    f->pts            = pts;
+    if (av_frame_get_buffer(f, 0) < 0) {
+        av_frame_free(&f);
+        return NULL;
+    }
+    av_samples_set_silence(f->extended_data, 0, nb_samples, f->channels, format);
+    return f;
+}
+
+static void send(AudioConvert *c, int nb_samples, int64_t pts)
+{
+    AVFrame *f = make_frame(AV_SAMPLE_FMT_S16, 48000, AV_CH_LAYOUT_STEREO, nb_samples, pts);
+
+    CHECK(f && audio_convert_send(c, f) == 0, "send %d samples at %lld", nb_samples, (long long)pts);
+    av_frame_free(&f);
+}
+
+/* frames of exactly frame_size, the rest as a short frame at eof, timestamps follow the input */
+static void test_framing(void)
+{
+    AudioConvert *c;
+    AVFrame *out = av_frame_alloc();
+    int64_t expected_pts[] = { 0, 256, 1212, 1468 };
+    int i, total = 0;
+
+    CHECK(audio_convert_alloc(&c, AV_SAMPLE_FMT_S16, 48000, AV_CH_LAYOUT_STEREO, NULL) == 0, "alloc");
+    CHECK(audio_convert_set_frame_size(c, 256) == 0, "frame size");
+
+    send(c, 300, 0);
+    // 700 samples missing in the input, the frame that starts after them shows the jump
+    send(c, 300, 1000);
+    send(c, 300, 1300);
+
+    for (i = 0; i < 2; i++) {
+        CHECK(audio_convert_receive(c, out, 0) == 0, "frame %d", i);
+        CHECK(out->nb_samples == 256, "frame %d has %d samples", i, out->nb_samples);
+        CHECK(out->pts == expected_pts[i], "frame %d pts %lld", i, (long long)out->pts);
+        total += out->nb_samples;
+        av_frame_unref(out);
+    }
+    CHECK(audio_convert_receive(c, out, 0) == 0 && out->pts == expected_pts[2], "frame 2 pts %lld",
+          (long long)out->pts);
+    total += out->nb_samples;
+    av_frame_unref(out);
+    CHECK(audio_convert_receive(c, out, 0) == AVERROR(EAGAIN), "short frame before eof");
+
+    CHECK(audio_convert_send(c, NULL) == 0, "drain");
+    CHECK(audio_convert_receive(c, out, 1) == 0, "last frame");
+    CHECK(out->nb_samples == 900 - 3 * 256, "last frame has %d samples", out->nb_samples);
+    CHECK(out->pts == expected_pts[3], "last frame pts %lld", (long long)out->pts);
+    total += out->nb_samples;
+    av_frame_unref(out);
+    CHECK(audio_convert_receive(c, out, 1) == AVERROR_EOF, "eof");
+    CHECK(total == 900, "%d samples out of 900", total);
+
+    av_frame_free(&out);
+    audio_convert_free(&c);
+    CHECK(!c, "not freed");
+}
+
+/* through swr, all samples come out resampled and in the output format */
+static void test_resample(void)
+{
+    AudioConvert *c;
+    AVFrame *in, *out = av_frame_alloc();
+    int i, ret, total = 0;
+
+    CHECK(audio_convert_alloc(&c, AV_SAMPLE_FMT_FLTP, 44100, AV_CH_LAYOUT_MONO, NULL) == 0, "alloc");
+    CHECK(audio_convert_set_frame_size(c, 1024) == 0, "frame size");
+    for (i = 0; i < 10; i++) {
+        in = make_frame(AV_SAMPLE_FMT_S16, 48000, AV_CH_LAYOUT_STEREO, 4800, i * 4800);
+        CHECK(in && audio_convert_send(c, in) == 0, "send %d", i);
+        av_frame_free(&in);
+        while (audio_convert_receive(c, out, 0) == 0) {
+            CHECK(out->format == AV_SAMPLE_FMT_FLTP && out->sample_rate == 44100 && out->channels == 1,
+                  "output parameters");
+            CHECK(out->nb_samples == 1024, "frame of %d samples", out->nb_samples);
+            total += out->nb_samples;
+            av_frame_unref(out);
+        }
+    }
+    CHECK(audio_convert_send(c, NULL) == 0, "drain");
+    while ((ret = audio_convert_receive(c, out, 1)) == 0) {
+        total += out->nb_samples;
+        av_frame_unref(out);
+    }
+    CHECK(ret == AVERROR_EOF, "eof");
+    // one second in, one second out, give or take the resampler's rounding
+    CHECK(total >= 44100 - 64 && total <= 44100 + 64, "%d samples out of 44100", total);
+
+    av_frame_free(&out);
+    audio_convert_free(&c);
+}
+
+int main(void)
+{
+    test_pick_format();
+    test_pick_rate();
+    test_pick_layout();
+    test_framing();
+    test_resample();
+
+    if (failures)
+        fprintf(stderr, "test_audio_convert: %d failures\n", failures);
+    return failures ? 1 : 0;
+}
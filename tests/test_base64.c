@@ -0,0 +1,84 @@
+//
+// Created by hexiufeng on 2026/10/19.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "base64.h"
+
+#define MAX_GROUPS 64
+#define CANARY 0xA5
+#define CANARY_SIZE 32
+
+static int failures;
+
+#define CHECK(cond, ...) do {                                       \
+    if (!(cond)) {                                                  \
+        fprintf(stderr, "%s:%d: ", __FILE__, __LINE__);             \
+        fprintf(stderr, __VA_ARGS__);                               \
+        fprintf(stderr, "\n");                                      \
+        failures++;                                                 \
+    }                                                               \
+} while (0)
+
+static int canary_intact(const uint8_t *p)
+{
+    int i;
+    for (i = 0; i < CANARY_SIZE; i++) {
+        if (p[i] != CANARY)
+            return 0;
+    }
+    return 1;
+}
+
+/* round trip of nb_groups, nothing may be written past either output */
+static void test_round_trip(size_t nb_groups)
+{
+    uint8_t plain[MAX_GROUPS * 3];
+    char coded[MAX_GROUPS * 4 + CANARY_SIZE];
+    uint8_t decoded[MAX_GROUPS * 3 + CANARY_SIZE];
+    size_t i;
+
+    for (i = 0; i < nb_groups * 3; i++)
+        plain[i] = (uint8_t)rand();
+    memset(coded, CANARY, sizeof(coded));
+    memset(decoded, CANARY, sizeof(decoded));
+
+    base64_encode_groups(coded, plain, nb_groups);
+    CHECK(canary_intact((uint8_t *)coded + nb_groups * 4), "encode of %zu groups wrote past the end", nb_groups);
+
+    CHECK(base64_decode_groups(decoded, coded, nb_groups) == 0, "decode of %zu groups failed", nb_groups);
+    CHECK(!memcmp(decoded, plain, nb_groups * 3), "decode of %zu groups differs", nb_groups);
+    CHECK(canary_intact(decoded + nb_groups * 3), "decode of %zu groups wrote past the end", nb_groups);
+}
+
+static void test_invalid_char(void)
+{
+    char coded[MAX_GROUPS * 4];
+    uint8_t decoded[MAX_GROUPS * 3 + CANARY_SIZE];
+    size_t pos;
+
+    for (pos = 0; pos < sizeof(coded); pos += 7) {
+        memset(coded, 'A', sizeof(coded));
+        coded[pos] = '*';
+        CHECK(base64_decode_groups(decoded, coded, MAX_GROUPS) < 0, "'*' at %zu was accepted", pos);
+    }
+}
+
+int main(void)
+{
+    size_t n;
+
+    srand(1);
+    // 5 and 9 leave exactly 5 groups after whole 16 char steps
+    test_round_trip(5);
+    test_round_trip(9);
+    for (n = 0; n <= MAX_GROUPS; n++)
+        test_round_trip(n);
+    test_invalid_char();
+
+    if (failures)
+        fprintf(stderr, "test_base64: %d failures\n", failures);
+    return failures ? 1 : 0;
+}
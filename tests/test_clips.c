@@ -0,0 +1,80 @@
+//
+// Created by hexiufeng on 2026/10/19.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "run_ffmpeg.h"
+
+#define NB_CLIPS 400
+
+static int failures;
+
+#define CHECK(cond, ...) do {                                       \
+    if (!(cond)) {                                                  \
+        fprintf(stderr, "%s:%d: ", __FILE__, __LINE__);             \
+        fprintf(stderr, __VA_ARGS__);                               \
+        fprintf(stderr, "\n");                                      \
+        failures++;                                                 \
+    }                                                               \
+} while (0)
+
+/* hundreds of clips make one command line of thousands of tokens, it has to parse and run */
+static void test_many_clips(const char *dir)
+{
+    char cmd[1024], path[1024];
+    char **clips = calloc(NB_CLIPS, sizeof(*clips));
+    struct stat st;
+    int i, nb_written = 0;
+
+    snprintf(cmd, sizeof(cmd), "ffmpeg -y -f lavfi -i sine=frequency=440:sample_rate=8000:duration=%d "
+             "-c:a pcm_s16le %s/in.wav", NB_CLIPS / 10 + 2, dir);
+    run_ffmpeg_cmd("test-clips-input", cmd);
+    snprintf(path, sizeof(path), "%s/in.wav", dir);
+    CHECK(!stat(path, &st) && st.st_size > 0, "could not generate %s, is lavfi available?", path);
+    if (failures)
+        goto end;
+
+    for (i = 0; i < NB_CLIPS; i++) {
+        clips[i] = malloc(256);
+        snprintf(clips[i], 256, "-ss %d.%d -t 0.05 -c:a pcm_s16le %s/clip%03d.wav", i / 10, i % 10, dir, i);
+    }
+    snprintf(cmd, sizeof(cmd), "ffmpeg -i %s/in.wav", dir);
+    CHECK(run_ffmpeg_clips("test-clips", cmd, clips, NB_CLIPS) >= 0, "run_ffmpeg_clips failed");
+
+    for (i = 0; i < NB_CLIPS; i++) {
+        snprintf(path, sizeof(path), "%s/clip%03d.wav", dir, i);
+        // more than the 44 byte wav header
+        if (!stat(path, &st) && st.st_size > 44)
+            nb_written++;
+        unlink(path);
+    }
+    CHECK(nb_written == NB_CLIPS, "%d of %d clips written", nb_written, NB_CLIPS);
+
+end:
+    for (i = 0; i < NB_CLIPS; i++)
+        free(clips[i]);
+    free(clips);
+    snprintf(path, sizeof(path), "%s/in.wav", dir);
+    unlink(path);
+}
+
+int main(void)
+{
+    char dir[] = "/tmp/test_clips_XXXXXX";
+
+    if (!mkdtemp(dir)) {
+        perror("mkdtemp");
+        return 1;
+    }
+    init_ffmpeg();
+    test_many_clips(dir);
+    rmdir(dir);
+
+    if (failures)
+        fprintf(stderr, "test_clips: %d failures\n", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,79 @@
+//
+// Created by hexiufeng on 2026/10/19.
+//
+
+#include <stdio.h>
+#include <libavutil/frame.h>
+#include "download_pool.h"
+
+static int failures;
+
+#define CHECK(cond, ...) do {                                       \
+    if (!(cond)) {                                                  \
+        fprintf(stderr, "%s:%d: ", __FILE__, __LINE__);             \
+        fprintf(stderr, __VA_ARGS__);                               \
+        fprintf(stderr, "\n");                                      \
+        failures++;                                                 \
+    }                                                               \
+} while (0)
+
+/* a frame handed back to the pool is the one the next download gets */
+static void test_reuse(void)
+{
+    DownloadPool p = { 0 };
+    AVFrame *f = av_frame_alloc();
+    uint8_t *first;
+    AVBufferPool *pool;
+    int i;
+
+    CHECK(download_pool_get(&p, f, AV_PIX_FMT_NV12, 1920, 1088) == 1, "nv12 not pooled");
+    CHECK(f->format == AV_PIX_FMT_NV12 && f->width == 1920 && f->height == 1088, "frame not set up");
+    CHECK(f->data[0] && f->data[1] && f->linesize[0] >= 1920, "planes not filled");
+    first = f->buf[0]->data;
+    pool = p.pool;
+    av_frame_unref(f);
+
+    for (i = 0; i < 8; i++) {
+        CHECK(download_pool_get(&p, f, AV_PIX_FMT_NV12, 1920, 1088) == 1, "frame %d not pooled", i);
+        CHECK(f->buf[0]->data == first, "frame %d got a new buffer", i);
+        av_frame_unref(f);
+    }
+    CHECK(p.pool == pool, "pool rebuilt for the same size");
+
+    // a new surface size replaces the pool
+    CHECK(download_pool_get(&p, f, AV_PIX_FMT_NV12, 1280, 720) == 1, "resized frame not pooled");
+    CHECK(p.pool && f->width == 1280 && f->buf[0]->size >= p.size, "pool not rebuilt for the new size");
+    av_frame_unref(f);
+
+    av_frame_free(&f);
+    download_pool_uninit(&p);
+    CHECK(!p.pool, "pool left after uninit");
+}
+
+/* the caller allocates when no image size can be computed or the stream went unpooled */
+static void test_fallback(void)
+{
+    DownloadPool p = { 0 };
+    AVFrame *f = av_frame_alloc();
+
+    CHECK(download_pool_get(&p, f, AV_PIX_FMT_NONE, 1920, 1080) == 0, "invalid format pooled");
+    CHECK(download_pool_get(&p, f, AV_PIX_FMT_NV12, 0, 1080) == 0, "zero width pooled");
+    CHECK(!f->buf[0] && !p.pool, "fallback touched the frame or the pool");
+
+    p.unpooled = 1;
+    CHECK(download_pool_get(&p, f, AV_PIX_FMT_NV12, 1920, 1080) == 0, "unpooled stream pooled");
+    CHECK(!f->buf[0] && !p.pool, "unpooled stream touched the frame or the pool");
+
+    av_frame_free(&f);
+    download_pool_uninit(&p);
+}
+
+int main(void)
+{
+    test_reuse();
+    test_fallback();
+
+    if (failures)
+        fprintf(stderr, "test_download_pool: %d failures\n", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,93 @@
+//
+// Created by hexiufeng on 2026/10/19.
+//
+
+#include <stdio.h>
+#include <libavutil/buffer.h>
+#include <libavutil/dict.h>
+#include <libavutil/error.h>
+#include "hw_registry.h"
+
+static int failures;
+static int nb_created;
+
+#define CHECK(cond, ...) do {                                       \
+    if (!(cond)) {                                                  \
+        fprintf(stderr, "%s:%d: ", __FILE__, __LINE__);             \
+        fprintf(stderr, __VA_ARGS__);                               \
+        fprintf(stderr, "\n");                                      \
+        failures++;                                                 \
+    }                                                               \
+} while (0)
+
+/* stands in for av_hwdevice_ctx_create, any buffer will do as the registry never looks inside */
+static int stub_create(AVBufferRef **device_ref, int type, const char *device,
+                       AVDictionary *opts, int flags)
+{
+    if (device && !*device)
+        return AVERROR(EINVAL);
+    if (!(*device_ref = av_buffer_allocz(1)))
+        return AVERROR(ENOMEM);
+    nb_created++;
+    return 0;
+}
+
+static void test_reuse(void)
+{
+    AVBufferRef *a = NULL, *b = NULL, *c = NULL, *d = NULL;
+    AVDictionary *opts = NULL;
+
+    CHECK(hw_registry_acquire(AV_HWDEVICE_TYPE_VAAPI, "/dev/dri/renderD128", NULL, &a) == 0, "acquire a");
+    CHECK(hw_registry_acquire(AV_HWDEVICE_TYPE_VAAPI, "/dev/dri/renderD128", NULL, &b) == 0, "acquire b");
+    CHECK(nb_created == 1, "same key opened %d devices", nb_created);
+    CHECK(a && b && a->data == b->data, "same key got different devices");
+
+    CHECK(hw_registry_acquire(AV_HWDEVICE_TYPE_VAAPI, "/dev/dri/renderD129", NULL, &c) == 0, "acquire c");
+    CHECK(nb_created == 2, "other device opened %d devices", nb_created);
+    CHECK(c && c->data != a->data, "other device shared the first one");
+
+    av_dict_set(&opts, "driver", "iHD", 0);
+    CHECK(hw_registry_acquire(AV_HWDEVICE_TYPE_VAAPI, "/dev/dri/renderD128", opts, &d) == 0, "acquire d");
+    CHECK(nb_created == 3, "other options opened %d devices", nb_created);
+    av_dict_free(&opts);
+
+    // a held: a, b and c, d are still in use
+    av_buffer_unref(&c);
+    av_buffer_unref(&d);
+    CHECK(hw_registry_flush(1) == 2, "idle flush should close the two released devices");
+    CHECK(hw_registry_flush(1) == 0, "device in use closed by idle flush");
+
+    // a forced flush drops the registry's reference, the job keeps its own
+    CHECK(hw_registry_flush(0) == 1, "forced flush should close the last device");
+    CHECK(av_buffer_get_ref_count(a) == 2, "job reference lost by flush");
+    av_buffer_unref(&a);
+    av_buffer_unref(&b);
+
+    CHECK(hw_registry_acquire(AV_HWDEVICE_TYPE_VAAPI, "/dev/dri/renderD128", NULL, &a) == 0, "acquire after flush");
+    CHECK(nb_created == 4, "flushed device was not opened again");
+    av_buffer_unref(&a);
+    hw_registry_flush(0);
+}
+
+static void test_create_error(void)
+{
+    AVBufferRef dummy, *a = &dummy;
+    int created = nb_created;
+
+    CHECK(hw_registry_acquire(AV_HWDEVICE_TYPE_VAAPI, "", NULL, &a) == AVERROR(EINVAL), "error not passed on");
+    CHECK(!a, "device_ref set on error");
+    CHECK(nb_created == created, "failed open counted");
+    CHECK(hw_registry_flush(0) == 0, "failed open was cached");
+}
+
+int main(void)
+{
+    hw_registry_set_create_fn(stub_create);
+    test_reuse();
+    test_create_error();
+    hw_registry_set_create_fn(NULL);
+
+    if (failures)
+        fprintf(stderr, "test_hw_registry: %d failures\n", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,310 @@
+//
+// Created by hexiufeng on 2026/10/19.
+//
+
+#include <pthread.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <libavutil/error.h>
+#include "input_queue.h"
+
+/* received packets between two depth decisions, as in input_queue.c */
+#define WINDOW 32
+
+static int failures;
+
+#define CHECK(cond, ...) do {                                       \
+    if (!(cond)) {                                                  \
+        fprintf(stderr, "%s:%d: ", __FILE__, __LINE__);             \
+        fprintf(stderr, __VA_ARGS__);                               \
+        fprintf(stderr, "\n");                                      \
+        failures++;                                                 \
+    }                                                               \
+} while (0)
+
+static AVPacket *new_packet(int size)
+{
+    AVPacket *pkt = av_packet_alloc();
+
+    if (pkt && av_new_packet(pkt, size) < 0)
+        av_packet_free(&pkt);
+    return pkt;
+}
+
+static int send_new(InputQueue *q, int size, int nonblock)
+{
+    AVPacket *pkt = new_packet(size);
+    int ret = input_queue_send(q, pkt, nonblock);
+
+    // the queue only owns the packet when it took it
+    if (ret < 0)
+        av_packet_free(&pkt);
+    return ret;
+}
+
+static int recv_free(InputQueue *q, int nonblock)
+{
+    AVPacket *pkt = NULL;
+    int ret = input_queue_recv(q, &pkt, nonblock);
+
+    if (!ret)
+        av_packet_free(&pkt);
+    return ret;
+}
+
+static InputQueueStats get_stats(InputQueue *q)
+{
+    InputQueueStats stats;
+
+    input_queue_get_stats(q, &stats);
+    return stats;
+}
+
+/* a thread in a blocking send or recv, started once the other side is set up */
+typedef struct Blocked {
+    pthread_t tid;
+    InputQueue *q;
+    int nb;                     // packets to send or receive
+    int ret;                    // result of the last call
+    int done;                   // calls that returned
+} Blocked;
+
+static void *send_thread(void *arg)
+{
+    Blocked *b = arg;
+
+    for (b->done = 0; b->done < b->nb; b->done++) {
+        if ((b->ret = send_new(b->q, 100, 0)) < 0)
+            break;
+    }
+    return NULL;
+}
+
+static void *recv_thread(void *arg)
+{
+    Blocked *b = arg;
+
+    for (b->done = 0; b->done < b->nb; b->done++) {
+        if ((b->ret = recv_free(b->q, 0)) < 0)
+            break;
+    }
+    return NULL;
+}
+
+/* wait until the queue counted a stall of the thread, it is then waiting on the condition */
+static int wait_send_stalls(InputQueue *q, int64_t nb)
+{
+    int i;
+
+    for (i = 0; i < 5000 && get_stats(q).nb_send_stalls < nb; i++)
+        usleep(1000);
+    return get_stats(q).nb_send_stalls >= nb;
+}
+
+static int wait_recv_stalls(InputQueue *q, int64_t nb)
+{
+    int i;
+
+    for (i = 0; i < 5000 && get_stats(q).nb_recv_stalls < nb; i++)
+        usleep(1000);
+    return get_stats(q).nb_recv_stalls >= nb;
+}
+
+/* a window in which the input thread found the queue full and the reader found it empty doubles the depth */
+static void test_grow(void)
+{
+    InputQueue *q;
+    Blocked sender = { .nb = 2 * WINDOW };
+    int i;
+
+    CHECK(input_queue_alloc(&q, 8, INPUT_QUEUE_MIN_DEPTH, 64, INPUT_QUEUE_MAX_BYTES) == 0, "alloc failed");
+    CHECK(recv_free(q, 1) == AVERROR(EAGAIN), "empty queue returned a packet");
+    sender.q = q;
+    pthread_create(&sender.tid, NULL, send_thread, &sender);
+    CHECK(wait_send_stalls(q, 1), "sender never found the queue full");
+    CHECK(get_stats(q).depth == 8, "depth changed before the window ended");
+
+    for (i = 0; i < WINDOW; i++)
+        CHECK(recv_free(q, 0) == 0, "recv %d failed", i);
+    CHECK(get_stats(q).depth == 16, "bursty window left the depth at %d", get_stats(q).depth);
+    CHECK(get_stats(q).peak_depth == 16, "peak depth %d", get_stats(q).peak_depth);
+
+    for (; i < sender.nb; i++)
+        CHECK(recv_free(q, 0) == 0, "recv %d failed", i);
+    pthread_join(sender.tid, NULL);
+    CHECK(sender.ret == 0 && sender.done == sender.nb, "sender stopped at %d", sender.done);
+    input_queue_free(&q);
+    CHECK(!q, "queue left after free");
+}
+
+/* a window that never drained below half of the depth halves it, down to min_depth */
+static void test_shrink(void)
+{
+    InputQueue *q;
+    int i;
+
+    CHECK(input_queue_alloc(&q, 16, INPUT_QUEUE_MIN_DEPTH, 64, INPUT_QUEUE_MAX_BYTES) == 0, "alloc failed");
+    for (i = 0; i < 16; i++)
+        CHECK(send_new(q, 100, 1) == 0, "send %d failed", i);
+    // keep the queue full, the window ends on the last receive
+    for (i = 0; i < WINDOW; i++) {
+        CHECK(recv_free(q, 1) == 0, "recv %d failed", i);
+        if (i < WINDOW - 1)
+            CHECK(send_new(q, 100, 1) == 0, "refill %d failed", i);
+    }
+    CHECK(get_stats(q).depth == 8, "full window left the depth at %d", get_stats(q).depth);
+    CHECK(get_stats(q).peak_depth == 16, "peak depth %d", get_stats(q).peak_depth);
+    CHECK(get_stats(q).nb_send_stalls == 0 && get_stats(q).nb_recv_stalls == 0, "stalls counted");
+    input_queue_free(&q);
+
+    CHECK(input_queue_alloc(&q, 2, INPUT_QUEUE_MIN_DEPTH, 64, INPUT_QUEUE_MAX_BYTES) == 0, "alloc failed");
+    for (i = 0; i < 2; i++)
+        CHECK(send_new(q, 100, 1) == 0, "send %d failed", i);
+    for (i = 0; i < WINDOW; i++) {
+        CHECK(recv_free(q, 1) == 0, "recv %d failed", i);
+        CHECK(send_new(q, 100, 1) == 0, "refill %d failed", i);
+    }
+    CHECK(get_stats(q).depth == INPUT_QUEUE_MIN_DEPTH, "depth %d below the minimum", get_stats(q).depth);
+    input_queue_free(&q);
+}
+
+/* a queue with min_depth == max_depth never changes, a full one refuses a non blocking send */
+static void test_fixed(void)
+{
+    InputQueue *q;
+    int i;
+
+    CHECK(input_queue_alloc(&q, 4, 4, 4, INPUT_QUEUE_MAX_BYTES) == 0, "alloc failed");
+    for (i = 0; i < 4; i++)
+        CHECK(send_new(q, 100, 1) == 0, "send %d failed", i);
+    CHECK(send_new(q, 100, 1) == AVERROR(EAGAIN), "full fixed queue took a packet");
+    for (i = 0; i < 4 * WINDOW; i++) {
+        CHECK(recv_free(q, 1) == 0, "recv %d failed", i);
+        CHECK(send_new(q, 100, 1) == 0, "refill %d failed", i);
+    }
+    CHECK(get_stats(q).depth == 4 && get_stats(q).peak_depth == 4, "fixed queue resized to %d", get_stats(q).depth);
+    input_queue_free(&q);
+}
+
+/* a non blocking (realtime) input grows the queue right away instead of waiting, up to max_depth */
+static void test_nonblock_grow(void)
+{
+    InputQueue *q;
+    int i;
+
+    CHECK(input_queue_alloc(&q, 2, INPUT_QUEUE_MIN_DEPTH, 8, INPUT_QUEUE_MAX_BYTES) == 0, "alloc failed");
+    for (i = 0; i < 2; i++)
+        CHECK(send_new(q, 100, 1) == 0, "send %d failed", i);
+    CHECK(send_new(q, 100, 1) == 0, "full queue did not grow");
+    CHECK(get_stats(q).depth == 4 && get_stats(q).nb_send_stalls == 1, "depth %d after one stall", get_stats(q).depth);
+    for (i = 3; i < 8; i++)
+        CHECK(send_new(q, 100, 1) == 0, "send %d failed", i);
+    CHECK(get_stats(q).depth == 8, "depth %d", get_stats(q).depth);
+    CHECK(send_new(q, 100, 1) == AVERROR(EAGAIN), "queue grew past max_depth");
+    CHECK(get_stats(q).depth == 8, "depth %d past max_depth", get_stats(q).depth);
+    input_queue_free(&q);
+}
+
+/* once max_bytes are queued the queue is full whatever its depth, and does not grow */
+static void test_max_bytes(void)
+{
+    InputQueue *q;
+
+    CHECK(input_queue_alloc(&q, 8, INPUT_QUEUE_MIN_DEPTH, 64, 1000) == 0, "alloc failed");
+    CHECK(send_new(q, 1000, 1) == 0, "send failed");
+    CHECK(send_new(q, 10, 1) == AVERROR(EAGAIN), "queue holding max_bytes took a packet");
+    CHECK(get_stats(q).depth == 8, "queue holding max_bytes grew to %d", get_stats(q).depth);
+    CHECK(recv_free(q, 1) == 0, "recv failed");
+    CHECK(send_new(q, 10, 1) == 0, "drained queue refused a packet");
+    input_queue_free(&q);
+
+    // a single packet larger than max_bytes still goes through an empty queue
+    CHECK(input_queue_alloc(&q, 8, INPUT_QUEUE_MIN_DEPTH, 64, 1000) == 0, "alloc failed");
+    CHECK(send_new(q, 5000, 1) == 0, "empty queue refused a large packet");
+    input_queue_free(&q);
+}
+
+/* packets sent before the input ended are received before its error, then the error sticks */
+static void test_eof(void)
+{
+    InputQueue *q;
+    int i;
+
+    CHECK(input_queue_alloc(&q, 8, INPUT_QUEUE_MIN_DEPTH, 64, INPUT_QUEUE_MAX_BYTES) == 0, "alloc failed");
+    for (i = 0; i < 3; i++)
+        CHECK(send_new(q, 100, 1) == 0, "send %d failed", i);
+    input_queue_set_err_recv(q, AVERROR_EOF);
+    for (i = 0; i < 3; i++)
+        CHECK(recv_free(q, 0) == 0, "queued packet %d lost after EOF", i);
+    CHECK(recv_free(q, 0) == AVERROR_EOF, "no EOF after the queued packets");
+    CHECK(recv_free(q, 1) == AVERROR_EOF, "non blocking recv missed EOF");
+    input_queue_free(&q);
+
+    // the transcode loop gave up on the input: the input thread's next send fails with its error
+    CHECK(input_queue_alloc(&q, 8, INPUT_QUEUE_MIN_DEPTH, 64, INPUT_QUEUE_MAX_BYTES) == 0, "alloc failed");
+    CHECK(send_new(q, 100, 0) == 0, "send failed");
+    input_queue_set_err_send(q, AVERROR_EXIT);
+    CHECK(send_new(q, 100, 0) == AVERROR_EXIT, "send after set_err_send did not fail");
+    CHECK(send_new(q, 100, 1) == AVERROR_EXIT, "non blocking send after set_err_send did not fail");
+    input_queue_free(&q);
+}
+
+/* a thread waiting in recv or send wakes up on the other side's packet or error */
+static void test_blocking(void)
+{
+    InputQueue *q;
+    Blocked b = { .nb = 1 };
+    int i;
+
+    // recv waiting on an empty queue gets the packet sent later
+    CHECK(input_queue_alloc(&q, 4, 4, 4, INPUT_QUEUE_MAX_BYTES) == 0, "alloc failed");
+    b.q = q;
+    pthread_create(&b.tid, NULL, recv_thread, &b);
+    CHECK(wait_recv_stalls(q, 1), "reader never waited");
+    CHECK(send_new(q, 100, 0) == 0, "send failed");
+    pthread_join(b.tid, NULL);
+    CHECK(b.ret == 0 && b.done == 1, "waiting reader got %d", b.ret);
+
+    // and the error of an input that ended
+    pthread_create(&b.tid, NULL, recv_thread, &b);
+    CHECK(wait_recv_stalls(q, 2), "reader never waited");
+    input_queue_set_err_recv(q, AVERROR_EOF);
+    pthread_join(b.tid, NULL);
+    CHECK(b.ret == AVERROR_EOF && b.done == 0, "waiting reader got %d instead of EOF", b.ret);
+    input_queue_free(&q);
+
+    // send waiting on a full queue goes through once a packet is received
+    CHECK(input_queue_alloc(&q, 4, 4, 4, INPUT_QUEUE_MAX_BYTES) == 0, "alloc failed");
+    for (i = 0; i < 4; i++)
+        CHECK(send_new(q, 100, 1) == 0, "send %d failed", i);
+    b.q = q;
+    pthread_create(&b.tid, NULL, send_thread, &b);
+    CHECK(wait_send_stalls(q, 1), "sender never waited");
+    CHECK(b.done == 0, "sender did not wait on a full queue");
+    CHECK(recv_free(q, 0) == 0, "recv failed");
+    pthread_join(b.tid, NULL);
+    CHECK(b.ret == 0 && b.done == 1, "waiting sender got %d", b.ret);
+
+    // and fails with the error of a transcode loop that stopped reading
+    pthread_create(&b.tid, NULL, send_thread, &b);
+    CHECK(wait_send_stalls(q, 2), "sender never waited");
+    input_queue_set_err_send(q, AVERROR_EXIT);
+    pthread_join(b.tid, NULL);
+    CHECK(b.ret == AVERROR_EXIT && b.done == 0, "waiting sender got %d instead of the error", b.ret);
+    input_queue_free(&q);
+}
+
+int main(void)
+{
+    test_grow();
+    test_shrink();
+    test_fixed();
+    test_nonblock_grow();
+    test_max_bytes();
+    test_eof();
+    test_blocking();
+
+    if (failures)
+        fprintf(stderr, "test_input_queue: %d failures\n", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,86 @@
+//
+// Created by hexiufeng on 2026/10/19.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "palette.h"
+
+#define MAX_WIDTH 2048
+#define CANARY 0xA5A5A5A5u
+#define CANARY_SIZE 16
+
+static int failures;
+
+#define CHECK(cond, ...) do {                                       \
+    if (!(cond)) {                                                  \
+        fprintf(stderr, "%s:%d: ", __FILE__, __LINE__);             \
+        fprintf(stderr, __VA_ARGS__);                               \
+        fprintf(stderr, "\n");                                      \
+        failures++;                                                 \
+    }                                                               \
+} while (0)
+
+/* one row of width w from a random palette through both versions, nothing may be written past w */
+static void test_row(palette_expand_fn simd, int w)
+{
+    static uint32_t pal[256];
+    static uint8_t src[MAX_WIDTH];
+    static uint32_t ref[MAX_WIDTH + CANARY_SIZE], out[MAX_WIDTH + CANARY_SIZE];
+    int i;
+
+    for (i = 0; i < 256; i++)
+        pal[i] = (uint32_t)rand() << 16 ^ (uint32_t)rand();
+    for (i = 0; i < w; i++)
+        src[i] = (uint8_t)rand();
+    // every index at least once in the wide rows, so the gather reaches both ends of the table
+    if (w >= 256) {
+        for (i = 0; i < 256; i++)
+            src[i] = (uint8_t)i;
+    }
+    for (i = 0; i < MAX_WIDTH + CANARY_SIZE; i++)
+        ref[i] = out[i] = CANARY;
+
+    palette_expand_c(ref, src, pal, w);
+    simd(out, src, pal, w);
+    for (i = 0; i < w; i++) {
+        if (ref[i] != pal[src[i]]) {
+            CHECK(0, "c: width %d pixel %d is %08x, want %08x", w, i, ref[i], pal[src[i]]);
+            break;
+        }
+    }
+    CHECK(!memcmp(out, ref, w * sizeof(*out)), "simd: width %d differs from c", w);
+    for (i = w; i < w + CANARY_SIZE; i++) {
+        if (out[i] != CANARY) {
+            CHECK(0, "simd: width %d wrote past the end at %d", w, i);
+            break;
+        }
+    }
+}
+
+int main(void)
+{
+    palette_expand_fn simd = palette_expand_simd();
+    static const int wide[] = { 255, 256, 257, 719, 720, 1279, 1280, 1917, 1920, MAX_WIDTH - 1, MAX_WIDTH };
+    int w, i, round;
+
+    if (!simd) {
+        fprintf(stderr, "test_palette: no simd version on this build or cpu, skipped\n");
+        return 0;
+    }
+    srand(1);
+    for (round = 0; round < 8; round++) {
+        // every tail length 0..7 after 0..8 whole vectors
+        for (w = 0; w <= 72; w++)
+            test_row(simd, w);
+        for (i = 0; i < sizeof(wide) / sizeof(wide[0]); i++)
+            test_row(simd, wide[i]);
+        for (i = 0; i < 32; i++)
+            test_row(simd, rand() % (MAX_WIDTH + 1));
+    }
+
+    if (failures)
+        fprintf(stderr, "test_palette: %d failures\n", failures);
+    return failures ? 1 : 0;
+}
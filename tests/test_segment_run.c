@@ -0,0 +1,152 @@
+//
+// Created by hexiufeng on 2026/10/19.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <libavformat/avformat.h>
+#include "run_ffmpeg.h"
+
+#define DURATION 70
+#define FPS 25
+
+static int failures;
+
+#define CHECK(cond, ...) do {                                       \
+    if (!(cond)) {                                                  \
+        fprintf(stderr, "%s:%d: ", __FILE__, __LINE__);             \
+        fprintf(stderr, __VA_ARGS__);                               \
+        fprintf(stderr, "\n");                                      \
+        failures++;                                                 \
+    }                                                               \
+} while (0)
+
+static int cmp_ts(const void *a, const void *b)
+{
+    int64_t x = *(const int64_t *)a, y = *(const int64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+/* one stream of the stitched output: no frame lost or doubled at the joins, no gap or overlap */
+static void check_stream(AVFormatContext *ic, int index, int64_t *pts, int64_t *dur, int nb)
+{
+    AVStream *st = ic->streams[index];
+    int64_t tol = av_rescale_q(2000, (AVRational){ 1, 1000000 }, st->time_base);
+    int64_t end;
+    int i;
+
+    if (!nb) {
+        CHECK(0, "stream %d is empty", index);
+        return;
+    }
+    if (st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO) {
+        int64_t frame = av_rescale_q(1, (AVRational){ 1, FPS }, st->time_base);
+        // b-frames come out of presentation order
+        qsort(pts, nb, sizeof(*pts), cmp_ts);
+        CHECK(abs(nb - DURATION * FPS) <= 1, "%d video frames, expected %d", nb, DURATION * FPS);
+        for (i = 1; i < nb; i++) {
+            if (llabs(pts[i] - pts[i - 1] - frame) > tol) {
+                CHECK(0, "video jumps by %lld at %.3fs", (long long)(pts[i] - pts[i - 1]),
+                      pts[i] * av_q2d(st->time_base));
+                break;
+            }
+        }
+        end = pts[nb - 1] + frame;
+    } else {
+        // pcm packets are stored in pts order, dur lines up with pts
+        for (i = 1; i < nb; i++) {
+            if (llabs(pts[i] - pts[i - 1] - dur[i - 1]) > tol) {
+                CHECK(0, "audio %s of %lld at %.3fs", pts[i] - pts[i - 1] > dur[i - 1] ? "gap" : "overlap",
+                      (long long)llabs(pts[i] - pts[i - 1] - dur[i - 1]), pts[i] * av_q2d(st->time_base));
+                break;
+            }
+        }
+        end = pts[nb - 1] + dur[nb - 1];
+    }
+    CHECK(llabs(av_rescale_q(end - pts[0], st->time_base, (AVRational){ 1, 1000 }) - DURATION * 1000) <= 50,
+          "stream %d lasts %.3fs", index, (end - pts[0]) * av_q2d(st->time_base));
+}
+
+static void check_output(const char *path)
+{
+    AVFormatContext *ic = NULL;
+    AVPacket *pkt = av_packet_alloc();
+    int64_t *pts[2] = { 0 }, *dur[2] = { 0 };
+    int nb[2] = { 0 }, index[2] = { -1, -1 };
+    int i;
+
+    if (avformat_open_input(&ic, path, NULL, NULL) < 0 || avformat_find_stream_info(ic, NULL) < 0) {
+        CHECK(0, "can't open %s", path);
+        goto end;
+    }
+    for (i = 0; i < ic->nb_streams && i < 2; i++) {
+        pts[i] = calloc(DURATION * 1000, sizeof(int64_t));
+        dur[i] = calloc(DURATION * 1000, sizeof(int64_t));
+        index[i] = i;
+    }
+    CHECK(ic->nb_streams == 2, "%d streams", ic->nb_streams);
+    while (av_read_frame(ic, pkt) >= 0) {
+        i = pkt->stream_index;
+        if (i < 2 && nb[i] < DURATION * 1000 && pkt->pts != AV_NOPTS_VALUE) {
+            pts[i][nb[i]] = pkt->pts;
+            dur[i][nb[i]] = pkt->duration;
+            nb[i]++;
+        }
+        av_packet_unref(pkt);
+    }
+    for (i = 0; i < 2; i++) {
+        if (index[i] >= 0)
+            check_stream(ic, i, pts[i], dur[i], nb[i]);
+        free(pts[i]);
+        free(dur[i]);
+    }
+end:
+    av_packet_free(&pkt);
+    avformat_close_input(&ic);
+}
+
+/*
+ * a/v with b-frames and pcm audio, the case where piece timestamps used to be shifted by
+ * the muxer: two pieces cut on a keyframe must stitch back to the whole timeline.
+ */
+static void test_av_stitch(const char *dir)
+{
+    char cmd[1024], in[512], out[512];
+    struct stat st;
+
+    snprintf(in, sizeof(in), "%s/in.mkv", dir);
+    snprintf(out, sizeof(out), "%s/out.mkv", dir);
+    snprintf(cmd, sizeof(cmd), "ffmpeg -y -f lavfi -i testsrc=size=160x90:rate=%d:duration=%d "
+             "-f lavfi -i sine=frequency=440:sample_rate=48000:duration=%d "
+             "-c:v mpeg4 -bf 2 -g %d -q:v 5 -c:a pcm_s16le %s", FPS, DURATION, DURATION, FPS, in);
+    run_ffmpeg_cmd("test-segment-input", cmd);
+    CHECK(!stat(in, &st) && st.st_size > 0, "could not generate %s, is lavfi available?", in);
+    if (failures)
+        return;
+
+    snprintf(cmd, sizeof(cmd), "ffmpeg -i %s -c:v mpeg4 -bf 2 -q:v 5 -c:a pcm_s16le %s", in, out);
+    CHECK(run_ffmpeg_segmented("test-segment", cmd, 2) >= 0, "segmented run failed");
+    check_output(out);
+
+    unlink(in);
+    unlink(out);
+}
+
+int main(void)
+{
+    char dir[] = "/tmp/test_segment_XXXXXX";
+
+    if (!mkdtemp(dir)) {
+        perror("mkdtemp");
+        return 1;
+    }
+    init_ffmpeg();
+    test_av_stitch(dir);
+    rmdir(dir);
+
+    if (failures)
+        fprintf(stderr, "test_segment_run: %d failures\n", failures);
+    return failures ? 1 : 0;
+}
@@ -9,6 +9,15 @@
 #include "internal.h"
 #include "common.h"
 #include "hw.h"
+#include "filter_pool.h"
+#include "codec_pool.h"
+#include "mux_queue.h"
+#include "mem_io.h"
+#include "job_log.h"
+#include "job_mem.h"
+#include "input_queue.h"
+#include "file_io.h"
+#include "seek_index.h"
 #include <libavutil/time.h>
 #include <libavutil/pixdesc.h>
 #include <libavutil/opt.h>
@@ -21,6 +30,11 @@
 #include <libavfilter/buffersrc.h>
 #include <libavutil/timestamp.h>
 
+/* longest single sleep on -re clocks, the loop looks at its inputs again after it */
+#define RATE_EMU_MAX_SLEEP 100000
+/* -multi_clip seeks this far before the first window, so decoders are primed when it starts */
+#define CLIP_SEEK_PREROLL 1000000
+
 const HWAccel hwaccels[] = {
 #if CONFIG_VIDEOTOOLBOX
         { "videotoolbox", videotoolbox_init, HWACCEL_VIDEOTOOLBOX, AV_PIX_FMT_VIDEOTOOLBOX },
@@ -127,10 +141,16 @@ static int ifilter_send_frame(RunContext *run_context,InputFilter *ifilter, AVFr
                 if (!tmp)
                     return AVERROR(ENOMEM);
                 av_frame_unref(frame);
+                ret = job_mem_charge(run_context, job_mem_frame_size(tmp));
+                if (ret < 0) {
+                    av_frame_free(&tmp);
+                    return ret;
+                }
 
                 if (!av_fifo_space(ifilter->frame_queue)) {
                     ret = av_fifo_realloc2(ifilter->frame_queue, 2 * av_fifo_size(ifilter->frame_queue));
                     if (ret < 0) {
+                        job_mem_release(run_context, job_mem_frame_size(tmp));
                         av_frame_free(&tmp);
                         return ret;
                     }
@@ -170,6 +190,13 @@ static int send_frame_to_filters(RunContext *run_context,InputStream *ist, AVFra
 
     av_assert1(ist->nb_filters > 0); /* ensure ret is initialized */
     for (i = 0; i < ist->nb_filters; i++) {
+        // every filter of an audio fast job is the simple graph of one encoded stream
+        if (run_context->audio_fast) {
+            ret = audio_fast_send(run_context, ist->filters[i]->graph->outputs[0]->ost, decoded_frame);
+            if (ret < 0)
+                break;
+            continue;
+        }
         if (i < ist->nb_filters - 1) {
             f = ist->filter_frame;
             ret = av_frame_ref(f, decoded_frame);
@@ -538,7 +565,7 @@ static int ifilter_send_eof(InputFilter *ifilter, int64_t pts)
     return 0;
 }
 
-static int send_filter_eof(InputStream *ist)
+static int send_filter_eof(RunContext *run_context, InputStream *ist)
 {
     int i, ret;
     /* TODO keep pts also in stream time base to avoid converting back */
@@ -546,7 +573,10 @@ static int send_filter_eof(InputStream *ist)
                                    AV_ROUND_NEAR_INF | AV_ROUND_PASS_MINMAX);
 
     for (i = 0; i < ist->nb_filters; i++) {
-        ret = ifilter_send_eof(ist->filters[i], pts);
+        if (run_context->audio_fast)
+            ret = audio_fast_eof(run_context, ist->filters[i]);
+        else
+            ret = ifilter_send_eof(ist->filters[i], pts);
         if (ret < 0)
             return ret;
     }
@@ -769,7 +799,7 @@ static int process_input_packet(RunContext *run_context,InputStream *ist, const
     /* after flushing, send an EOF on all the filter inputs attached to the stream */
     /* except when looping we need to flush but not to send an EOF */
     if (!pkt && ist->decoding_needed && eof_reached && !no_eof) {
-        int ret = send_filter_eof(ist);
+        int ret = send_filter_eof(run_context, ist);
         if (ret < 0) {
             av_log(NULL, AV_LOG_FATAL, "Error marking filters as finished\n");
 //            exit_program(1);
@@ -1135,6 +1165,36 @@ static void close_all_output_streams(RunContext *run_context,OutputStream *ost,
     }
 }
 
+/* a memory output grows inside the muxer's avio, charge whatever it added since the last packet */
+static void charge_mem_output(RunContext *run_context, OutputFile *of)
+{
+    int64_t grown = of->mem_output->size - of->mem_charged;
+
+    if (grown > 0 && job_mem_charge(run_context, grown) >= 0)
+        of->mem_charged += grown;
+}
+
+static void record_latency(RunContext *run_context, OutputFile *of, OutputStream *ost, const AVPacket *pkt)
+{
+    InputStream *ist;
+    int64_t ts = pkt->pts != AV_NOPTS_VALUE ? pkt->pts : pkt->dts;
+    int64_t read_time;
+
+    if (ost->source_index < 0 || ts == AV_NOPTS_VALUE)
+        return;
+    ist = run_context->option_input.input_streams[ost->source_index];
+    if (!ist->latency)
+        return;
+
+    // back to the input timeline, the output file start was subtracted when encoding/copying
+    ts = av_rescale_q(ts, ost->st->time_base, AV_TIME_BASE_Q);
+    if (of->start_time != AV_NOPTS_VALUE)
+        ts += of->start_time;
+    read_time = latency_track_find(ist->latency, ts);
+    if (read_time != AV_NOPTS_VALUE)
+        latency_hist_add(&run_context->latency, av_gettime_relative() - read_time);
+}
+
 static int write_packet(RunContext *run_context,OutputFile *of, AVPacket *pkt, OutputStream *ost, int unqueue)
 {
     AVFormatContext *s = of->ctx;
@@ -1162,7 +1222,8 @@ static int write_packet(RunContext *run_context,OutputFile *of, AVPacket *pkt, O
         /* the muxer is not initialized yet, buffer the packet */
         if (!av_fifo_space(ost->muxing_queue)) {
             unsigned int are_we_over_size =
-                    (ost->muxing_queue_data_size + pkt->size) > ost->muxing_queue_data_threshold;
+                    (ost->muxing_queue_data_size + pkt->size) > ost->muxing_queue_data_threshold ||
+                    mux_queue_over_budget(pkt->size);
             int new_size = are_we_over_size ?
                            FFMIN(2 * av_fifo_size(ost->muxing_queue),
                                  ost->max_muxing_queue_size) :
@@ -1186,14 +1247,23 @@ static int write_packet(RunContext *run_context,OutputFile *of, AVPacket *pkt, O
 //            exit_program(1);
             return -1;
         }
-        tmp_pkt = av_packet_alloc();
+        if (job_mem_charge(run_context, pkt->size) < 0) {
+            av_packet_unref(pkt);
+            return -1;
+        }
+        tmp_pkt = mux_queue_packet_get(pkt);
         if (!tmp_pkt){
+            job_mem_release(run_context, pkt->size);
 //            exit_program(1);
             return -1;
         }
-        av_packet_move_ref(tmp_pkt, pkt);
         ost->muxing_queue_data_size += tmp_pkt->size;
         av_fifo_generic_write(ost->muxing_queue, &tmp_pkt, sizeof(tmp_pkt), NULL);
+        ost->muxing_queue_peak_packets = FFMAX(ost->muxing_queue_peak_packets,
+                                               av_fifo_size(ost->muxing_queue) / sizeof(tmp_pkt));
+        ost->muxing_queue_peak_data_size = FFMAX(ost->muxing_queue_peak_data_size, ost->muxing_queue_data_size);
+        mux_queue_pushed(tmp_pkt->size, av_fifo_size(ost->muxing_queue) / sizeof(tmp_pkt),
+                         ost->muxing_queue_data_size);
         return 0;
     }
 
@@ -1225,6 +1295,9 @@ static int write_packet(RunContext *run_context,OutputFile *of, AVPacket *pkt, O
 
     av_packet_rescale_ts(pkt, ost->mux_timebase, ost->st->time_base);
 
+    if (run_context->low_latency)
+        record_latency(run_context, of, ost, pkt);
+
     if (!(s->oformat->flags & AVFMT_NOTIMESTAMPS)) {
         if (pkt->dts != AV_NOPTS_VALUE &&
             pkt->pts != AV_NOPTS_VALUE &&
@@ -1286,6 +1359,9 @@ static int write_packet(RunContext *run_context,OutputFile *of, AVPacket *pkt, O
         close_all_output_streams(run_context,ost, MUXER_FINISHED | ENCODER_FINISHED, ENCODER_FINISHED);
     }
     av_packet_unref(pkt);
+    if (of->mem_output)
+        charge_mem_output(run_context, of);
+    return 0;
 }
 
 static void init_encoder_time_base(RunContext *run_context,OutputStream *ost, AVRational default_time_base)
@@ -1360,10 +1436,13 @@ static int check_init_output_file(RunContext *run_context,OutputFile *of, int fi
             AVPacket *pkt;
             av_fifo_generic_read(ost->muxing_queue, &pkt, sizeof(pkt), NULL);
             ost->muxing_queue_data_size -= pkt->size;
+            mux_queue_popped(pkt->size);
+            job_mem_release(run_context, pkt->size);
             if(0 > write_packet(run_context,of, pkt, ost, 1)){
+                mux_queue_packet_put(&pkt);
                 return -1;
             }
-            av_packet_free(&pkt);
+            mux_queue_packet_put(&pkt);
         }
     }
 
@@ -1515,13 +1594,20 @@ static int init_output_stream_encode(RunContext *run_context,OutputStream *ost,
 
     switch (enc_ctx->codec_type) {
         case AVMEDIA_TYPE_AUDIO:
-            enc_ctx->sample_fmt     = av_buffersink_get_format(ost->filter->filter);
+            if (ost->audio_convert) {
+                enc_ctx->sample_fmt     = ost->audio_convert->out_format;
+                enc_ctx->sample_rate    = ost->audio_convert->out_rate;
+                enc_ctx->channel_layout = ost->audio_convert->out_layout;
+                enc_ctx->channels       = ost->audio_convert->out_channels;
+            } else {
+                enc_ctx->sample_fmt     = av_buffersink_get_format(ost->filter->filter);
+                enc_ctx->sample_rate    = av_buffersink_get_sample_rate(ost->filter->filter);
+                enc_ctx->channel_layout = av_buffersink_get_channel_layout(ost->filter->filter);
+                enc_ctx->channels       = av_buffersink_get_channels(ost->filter->filter);
+            }
             if (dec_ctx)
                 enc_ctx->bits_per_raw_sample = FFMIN(dec_ctx->bits_per_raw_sample,
                                                      av_get_bytes_per_sample(enc_ctx->sample_fmt) << 3);
-            enc_ctx->sample_rate    = av_buffersink_get_sample_rate(ost->filter->filter);
-            enc_ctx->channel_layout = av_buffersink_get_channel_layout(ost->filter->filter);
-            enc_ctx->channels       = av_buffersink_get_channels(ost->filter->filter);
 
             init_encoder_time_base(run_context,ost, av_make_q(1, enc_ctx->sample_rate));
             break;
@@ -1719,6 +1805,10 @@ static int init_output_stream(RunContext *run_context,OutputStream *ost, AVFrame
             }
         }
 
+        if ((ret = codec_pool_prepare(run_context, ost->enc_ctx, &ost->encoder_opts,
+                                      &ost->pool_reserved_threads)) < 0)
+            return ret;
+
         if ((ret = avcodec_open2(ost->enc_ctx, codec, &ost->encoder_opts)) < 0) {
             if (ret == AVERROR_EXPERIMENTAL){
 
@@ -1731,7 +1821,13 @@ static int init_output_stream(RunContext *run_context,OutputStream *ost, AVFrame
                      ost->file_index, ost->index);
             return ret;
         }
-        if (ost->enc->type == AVMEDIA_TYPE_AUDIO &&
+        if (ost->audio_convert) {
+            ret = audio_convert_set_frame_size(ost->audio_convert,
+                                               ost->enc->capabilities & AV_CODEC_CAP_VARIABLE_FRAME_SIZE ?
+                                               0 : ost->enc_ctx->frame_size);
+            if (ret < 0)
+                return ret;
+        } else if (ost->enc->type == AVMEDIA_TYPE_AUDIO &&
             !(ost->enc->capabilities & AV_CODEC_CAP_VARIABLE_FRAME_SIZE))
             av_buffersink_set_frame_size(ost->filter->filter,
                                          ost->enc_ctx->frame_size);
@@ -1928,6 +2024,10 @@ static int init_input_stream(RunContext *run_context,int ist_index, char *error,
             return ret;
         }
 
+        if ((ret = codec_pool_prepare(run_context, ist->dec_ctx, &ist->decoder_opts,
+                                      &ist->pool_reserved_threads)) < 0)
+            return ret;
+
         if ((ret = avcodec_open2(ist->dec_ctx, codec, &ist->decoder_opts)) < 0) {
             if (ret == AVERROR_EXPERIMENTAL)
             {
@@ -1949,6 +2049,169 @@ static int init_input_stream(RunContext *run_context,int ist_index, char *error,
     return 0;
 }
 
+/*
+ * -eager_init: the encoder parameters of a filtered stream only depend on the command line
+ * when size, pixel format and rate (audio: sample format, rate and channels) are all given,
+ * so the filtergraph can be configured from the demuxer parameters and the encoder opened
+ * before the first frame is decoded. a first frame that differs reconfigures the graph as usual.
+ */
+static int output_params_complete(OutputStream *ost)
+{
+    AVCodecContext *enc_ctx = ost->enc_ctx;
+    FilterGraph *fg;
+    int i;
+
+    if (!ost->filter)
+        return 0;
+    fg = ost->filter->graph;
+    switch (enc_ctx->codec_type) {
+        case AVMEDIA_TYPE_VIDEO:
+            if (!enc_ctx->width || !enc_ctx->height || enc_ctx->pix_fmt == AV_PIX_FMT_NONE ||
+                !ost->frame_rate.num)
+                return 0;
+            break;
+        case AVMEDIA_TYPE_AUDIO:
+            if (enc_ctx->sample_fmt == AV_SAMPLE_FMT_NONE || !enc_ctx->sample_rate ||
+                !(enc_ctx->channel_layout || enc_ctx->channels))
+                return 0;
+            break;
+        default:
+            return 0;
+    }
+    for (i = 0; i < fg->nb_inputs; i++) {
+        InputStream *ist = fg->inputs[i]->ist;
+        // hw frames only exist once decoded, a frozen graph would keep the guessed input format
+        if (ist->hwaccel_id != HWACCEL_NONE || !ist->reinit_filters)
+            return 0;
+    }
+    return 1;
+}
+
+/*
+ * -multi_clip: the outputs cut from an input with output -ss/-t share one demux and decode pass,
+ * each keeps its own trim and encoder. when all of them start late the input is seeked once, a
+ * little before the earliest window, and its ts_offset is left alone: the timestamps and so the
+ * trims stay as if the input had been read from the start. inputs feeding a complex filtergraph,
+ * an output without -ss, or with -ss/-stream_loop/-re/-itsscale of their own are read whole.
+ */
+static void seek_to_first_clip(RunContext *run_context, int file_index)
+{
+    InputFile *f = run_context->option_input.input_files[file_index];
+    int64_t first = INT64_MAX, ts;
+    int i, ret;
+
+    if (f->start_time != AV_NOPTS_VALUE || f->loop || f->rate_emu || run_context->copy_ts)
+        return;
+    for (i = 0; i < f->nb_streams; i++) {
+        if (run_context->option_input.input_streams[f->ist_index + i]->ts_scale != 1.0)
+            return;
+    }
+    for (i = 0; i < run_context->option_output.nb_output_streams; i++) {
+        OutputStream *ost = run_context->option_output.output_streams[i];
+        OutputFile *of = run_context->option_output.output_files[ost->file_index];
+        int j;
+
+        if (ost->source_index < 0) {
+            if (!ost->filter)
+                continue;
+            for (j = 0; j < ost->filter->graph->nb_inputs; j++) {
+                if (ost->filter->graph->inputs[j]->ist->file_index == file_index)
+                    return;
+            }
+            continue;
+        }
+        if (run_context->option_input.input_streams[ost->source_index]->file_index != file_index)
+            continue;
+        if (of->start_time == AV_NOPTS_VALUE)
+            return;
+        first = FFMIN(first, of->start_time);
+    }
+    if (first == INT64_MAX || first <= CLIP_SEEK_PREROLL)
+        return;
+
+    ts = first - CLIP_SEEK_PREROLL - f->ts_offset;
+    ret = avformat_seek_file(f->ctx, -1, INT64_MIN, ts, ts, 0);
+    if (ret < 0) {
+        av_log(NULL, AV_LOG_WARNING, "tid=%s,%s: could not seek to the first clip at %f, reading from the start\n",
+               run_context->trace_id, f->ctx->url, (double)first / AV_TIME_BASE);
+        return;
+    }
+    av_log(NULL, AV_LOG_VERBOSE, "tid=%s,%s: seeked to the first clip at %f\n",
+           run_context->trace_id, f->ctx->url, (double)first / AV_TIME_BASE);
+}
+
+/*
+ * audio only jobs: when every output stream is audio and no encoded one needs more than the
+ * format, rate and layout conversion lavfi inserts by itself, decoded frames go through an
+ * AudioConvert straight to the encoder and the filtergraphs are never configured.
+ * output -t is applied by counting samples, everything else that puts a filter into the
+ * graph (-af, -vol, -async, -map_channel, -apad, input -ss/-t, output -ss) keeps lavfi.
+ */
+static int audio_fast_possible(RunContext *run_context)
+{
+    int i;
+
+    if (!run_context->audio_fast_path || run_context->audio_volume != 256 ||
+        run_context->audio_sync_method > 0)
+        return 0;
+    for (i = 0; i < run_context->option_input.nb_input_streams; i++) {
+        InputStream *ist = run_context->option_input.input_streams[i];
+        if (ist->decoding_needed && ist->dec_ctx->codec_type != AVMEDIA_TYPE_AUDIO)
+            return 0;
+    }
+    for (i = 0; i < run_context->option_input.nb_input_files; i++) {
+        InputFile *f = run_context->option_input.input_files[i];
+        if ((f->start_time != AV_NOPTS_VALUE && f->accurate_seek) || f->recording_time != INT64_MAX)
+            return 0;
+    }
+    for (i = 0; i < run_context->option_output.nb_output_files; i++) {
+        OutputFile *of = run_context->option_output.output_files[i];
+        if (of->start_time != AV_NOPTS_VALUE || of->shortest)
+            return 0;
+    }
+    for (i = 0; i < run_context->option_output.nb_output_streams; i++) {
+        OutputStream *ost = run_context->option_output.output_streams[i];
+
+        if (ost->st->codecpar->codec_type != AVMEDIA_TYPE_AUDIO)
+            return 0;
+        if (ost->stream_copy)
+            continue;
+        if (!ost->encoding_needed || !ost->filter || !filtergraph_is_simple(ost->filter->graph) ||
+            ost->source_index < 0 || ost->audio_channels_mapped || ost->apad ||
+            (ost->avfilter && strcmp(ost->avfilter, "anull")))
+            return 0;
+    }
+    return 1;
+}
+
+static int eager_init_output_stream(RunContext *run_context, OutputStream *ost)
+{
+    FilterGraph *fg = ost->filter->graph;
+    int i, ret;
+
+    if (!fg->graph) {
+        for (i = 0; i < fg->nb_inputs; i++) {
+            InputFilter *ifilter = fg->inputs[i];
+            if (ifilter->format < 0)
+                ifilter_parameters_from_codecpar(ifilter, ifilter->ist->st->codecpar);
+        }
+        if (!ifilter_has_all_input_formats(fg))
+            return 0;
+        ret = configure_filtergraph(run_context, fg);
+        if (ret < 0) {
+            av_log(NULL, AV_LOG_ERROR, "tid=%s,Error configuring filters for output stream #%d:%d\n",
+                   run_context->trace_id, ost->file_index, ost->index);
+            return ret;
+        }
+    }
+
+    ret = init_output_stream_wrapper(run_context, ost, NULL, 1);
+    if (ret >= 0)
+        av_log(NULL, AV_LOG_VERBOSE, "tid=%s,output stream #%d:%d initialized before the first frame\n",
+               run_context->trace_id, ost->file_index, ost->index);
+    return ret;
+}
+
 static int transcode_init(RunContext *run_context)
 {
     int ret = 0, i, j, k;
@@ -1976,8 +2239,7 @@ static int transcode_init(RunContext *run_context)
     for (i = 0; i < run_context->option_input.nb_input_files; i++) {
         InputFile *ifile = run_context->option_input.input_files[i];
         if (ifile->rate_emu)
-            for (j = 0; j < ifile->nb_streams; j++)
-                run_context->option_input.input_streams[j + ifile->ist_index]->start = av_gettime_relative();
+            ifile->rate_emu_start = av_gettime_relative();
     }
 
     /* init input streams */
@@ -2010,6 +2272,33 @@ static int transcode_init(RunContext *run_context)
             goto dump_format;
     }
 
+    if (run_context->multi_clip) {
+        for (i = 0; i < run_context->option_input.nb_input_files; i++)
+            seek_to_first_clip(run_context, i);
+    }
+
+    if (audio_fast_possible(run_context)) {
+        run_context->audio_fast = 1;
+        for (i = 0; i < run_context->option_output.nb_output_streams; i++) {
+            ost = run_context->option_output.output_streams[i];
+            ost->audio_fast = !ost->stream_copy;
+        }
+        av_log(NULL, AV_LOG_VERBOSE, "tid=%s,audio only job, encoding without filtergraphs\n",
+               run_context->trace_id);
+    }
+
+    if (run_context->eager_init || run_context->low_latency) {
+        for (i = 0; i < run_context->option_output.nb_output_streams; i++) {
+            ost = run_context->option_output.output_streams[i];
+            if (ost->stream_copy || ost->audio_fast || !output_params_complete(ost))
+                continue;
+
+            ret = eager_init_output_stream(run_context, ost);
+            if (ret < 0)
+                goto dump_format;
+        }
+    }
+
     /* discard unused programs */
     for (i = 0; i < run_context->option_input.nb_input_files; i++) {
         InputFile *ifile = run_context->option_input.input_files[i];
@@ -2169,16 +2458,40 @@ static OutputStream *choose_output(RunContext * run_context)
     return ost_min;
 }
 
+/*
+ * keeps the furthest dts of a -re input up to date after one of its streams moved,
+ * the streams are only rescanned when the one holding it went back
+ */
+static void update_rate_emu_clock(RunContext *run_context, InputFile *f, InputStream *ist)
+{
+    int i, index = ist->st->index;
+
+    if (ist->dts >= f->rate_emu_dts) {
+        f->rate_emu_dts    = ist->dts;
+        f->rate_emu_stream = index;
+        return;
+    }
+    if (index != f->rate_emu_stream)
+        return;
+
+    f->rate_emu_dts = ist->dts;
+    for (i = 0; i < f->nb_streams; i++) {
+        InputStream *other = run_context->option_input.input_streams[f->ist_index + i];
+        if (other->dts > f->rate_emu_dts) {
+            f->rate_emu_dts    = other->dts;
+            f->rate_emu_stream = i;
+        }
+    }
+}
+
 static int get_input_packet(RunContext *run_context,InputFile *f, AVPacket **pkt)
 {
     if (f->rate_emu) {
-        int i;
-        for (i = 0; i < f->nb_streams; i++) {
-            InputStream *ist = run_context->option_input.input_streams[f->ist_index + i];
-            int64_t pts = av_rescale(ist->dts, 1000000, AV_TIME_BASE);
-            int64_t now = av_gettime_relative() - ist->start;
-            if (pts > now)
-                return AVERROR(EAGAIN);
+        int64_t due = f->rate_emu_start + av_rescale(f->rate_emu_dts, 1000000, AV_TIME_BASE);
+        if (due > av_gettime_relative()) {
+            f->rate_emu_wait = 1;
+            f->rate_emu_due  = due;
+            return AVERROR(EAGAIN);
         }
     }
 
@@ -2202,12 +2515,37 @@ static int got_eagain(RunContext *run_context)
 static void reset_eagain(RunContext *run_context)
 {
     int i;
-    for (i = 0; i < run_context->option_input.nb_input_files; i++)
+    for (i = 0; i < run_context->option_input.nb_input_files; i++) {
         run_context->option_input.input_files[i]->eagain = 0;
+        run_context->option_input.input_files[i]->rate_emu_wait = 0;
+    }
     for (i = 0; i < run_context->option_output.nb_output_streams; i++)
         run_context->option_output.output_streams[i]->unavailable = 0;
 }
 
+/*
+ * how long transcode_step sleeps when no output can make progress. inputs that only wait
+ * for their -re clock are slept on until the earliest is due, anything else is polled.
+ */
+static int64_t eagain_sleep_time(RunContext *run_context)
+{
+    int64_t poll = run_context->low_latency ? 1000 : 10000;
+    int64_t due = INT64_MAX;
+    int i;
+
+    for (i = 0; i < run_context->option_input.nb_input_files; i++) {
+        InputFile *ifile = run_context->option_input.input_files[i];
+        if (!ifile->eagain)
+            continue;
+        if (!ifile->rate_emu_wait)
+            return poll;
+        due = FFMIN(due, ifile->rate_emu_due);
+    }
+    if (due == INT64_MAX)
+        return poll;
+    return av_clip64(due - av_gettime_relative(), 0, RATE_EMU_MAX_SLEEP);
+}
+
 
 
 static double adjust_frame_pts_to_encoder_tb(OutputFile *of, OutputStream *ost,
@@ -2398,6 +2736,106 @@ static int do_audio_out(RunContext * run_context,OutputFile *of, OutputStream *o
     return -1;
 }
 
+/*
+ * audio fast path: the output format is the one the aformat filter of configure_output_audio_filter
+ * would have negotiated for the first frame, the encoder opens as soon as it is known.
+ */
+static int audio_fast_init(RunContext *run_context, OutputStream *ost, int format, int sample_rate,
+                           uint64_t channel_layout, int channels)
+{
+    OutputFilter *ofilter = ost->filter;
+    uint64_t layout = channel_layout ? channel_layout : av_get_default_channel_layout(channels);
+    int ret;
+
+    if (format < 0 || sample_rate <= 0 || !layout) {
+        av_log(NULL, AV_LOG_ERROR, "tid=%s,Cannot determine format of input stream for output stream %d:%d\n",
+               run_context->trace_id, ost->file_index, ost->index);
+        return AVERROR_INVALIDDATA;
+    }
+    ret = audio_convert_alloc(&ost->audio_convert,
+                              ofilter->format >= 0 ? ofilter->format :
+                              audio_convert_pick_format(ofilter->formats, format),
+                              ofilter->sample_rate ? ofilter->sample_rate :
+                              audio_convert_pick_rate(ofilter->sample_rates, sample_rate),
+                              ofilter->channel_layout ? ofilter->channel_layout :
+                              audio_convert_pick_layout(ofilter->channel_layouts, layout),
+                              ost->swr_opts);
+    if (ret < 0)
+        return ret;
+    return init_output_stream_wrapper(run_context, ost, NULL, 1);
+}
+
+/* hands the queued samples to the encoder in frame_size pieces, the rest too at eof */
+static int audio_fast_encode(RunContext *run_context, OutputStream *ost, int eof)
+{
+    OutputFile *of = run_context->option_output.output_files[ost->file_index];
+    AudioConvert *c = ost->audio_convert;
+    AVFrame *frame;
+    int ret = 0;
+
+    if (!ost->pkt && !(ost->pkt = av_packet_alloc()))
+        return AVERROR(ENOMEM);
+    if (!ost->filtered_frame && !(ost->filtered_frame = av_frame_alloc()))
+        return AVERROR(ENOMEM);
+    frame = ost->filtered_frame;
+
+    while (!ost->finished && (ret = audio_convert_receive(c, frame, eof)) >= 0) {
+        int last = 0;
+
+        frame->pts = av_rescale_q(frame->pts, (AVRational){1, c->out_rate}, ost->enc_ctx->time_base);
+        // output -t, to the sample like the trim filter
+        if (of->recording_time != INT64_MAX) {
+            int64_t left = av_rescale(of->recording_time, c->out_rate, AV_TIME_BASE) - ost->samples_encoded;
+            if (left <= 0) {
+                av_frame_unref(frame);
+                close_output_stream(run_context, ost);
+                break;
+            }
+            if (frame->nb_samples >= left) {
+                frame->nb_samples = left;
+                last = 1;
+            }
+        }
+        ret = do_audio_out(run_context, of, ost, frame);
+        av_frame_unref(frame);
+        if (ret < 0)
+            return ret;
+        if (last)
+            close_output_stream(run_context, ost);
+    }
+    return ret == AVERROR(EAGAIN) || ret == AVERROR_EOF ? 0 : ret;
+}
+
+static int audio_fast_send(RunContext *run_context, OutputStream *ost, const AVFrame *frame)
+{
+    int ret;
+
+    if (ost->finished)
+        return 0;
+    if (!ost->audio_convert &&
+        (ret = audio_fast_init(run_context, ost, frame->format, frame->sample_rate,
+                               frame->channel_layout, frame->channels)) < 0)
+        return ret;
+    if ((ret = audio_convert_send(ost->audio_convert, frame)) < 0)
+        return ret;
+    return audio_fast_encode(run_context, ost, 0);
+}
+
+static int audio_fast_eof(RunContext *run_context, InputFilter *ifilter)
+{
+    OutputStream *ost = ifilter->graph->outputs[0]->ost;
+    int ret;
+
+    ifilter->eof = 1;
+    if (ost->audio_convert && !ost->finished) {
+        if ((ret = audio_convert_send(ost->audio_convert, NULL)) < 0 ||
+            (ret = audio_fast_encode(run_context, ost, 1)) < 0)
+            return ret;
+    }
+    close_output_stream(run_context, ost);
+    return 0;
+}
+
 
 static int do_subtitle_out(RunContext *run_context,OutputFile *of,
                             OutputStream *ost,
@@ -2823,7 +3261,7 @@ static int reap_filters(RunContext *run_context,int flush)
                 if (ret != AVERROR(EAGAIN) && ret != AVERROR_EOF) {
                     av_log(NULL, AV_LOG_WARNING,
                            "Error in av_buffersink_get_frame_flags(): %s\n", av_err2str(ret));
-                } else if (flush && ret == AVERROR_EOF) {
+                } else if (flush && ret == AVERROR_EOF && !of->closed) {
                     if (av_buffersink_get_type(filter) == AVMEDIA_TYPE_VIDEO)
                         if(0 > do_video_out(run_context,of, ost, NULL)){
                             return -1;
@@ -3305,11 +3743,24 @@ static int process_input(RunContext *run_context,int file_index)
 //               av_ts2timestr(input_files[ist->file_index]->ts_offset, &AV_TIME_BASE_Q));
 //    }
 
-    sub2video_heartbeat(run_context,ist, pkt->pts);
+    if (run_context->low_latency && pkt->dts != AV_NOPTS_VALUE) {
+        // without the memory the stream just goes unmeasured
+        if (!ist->latency)
+            ist->latency = av_mallocz(sizeof(*ist->latency));
+        if (ist->latency)
+            latency_track_in(ist->latency, av_rescale_q(pkt->dts, ist->st->time_base, AV_TIME_BASE_Q),
+                             av_gettime_relative());
+    }
+
+    // no subtitles in an audio only job
+    if (!run_context->audio_fast)
+        sub2video_heartbeat(run_context,ist, pkt->pts);
 
     if(0 > process_input_packet(run_context,ist, pkt, 0)){
         return -1;
     }
+    if (ifile->rate_emu)
+        update_rate_emu_clock(run_context, ifile, ist);
 
     discard_packet:
 #if HAVE_THREADS
@@ -3372,15 +3823,17 @@ static int transcode_step(RunContext *run_context)
     ost = choose_output(run_context);
     if (!ost) {
         if (got_eagain(run_context)) {
+            int64_t sleep_time = eagain_sleep_time(run_context);
             reset_eagain(run_context);
-            av_usleep(10000);
+            if (sleep_time > 0)
+                av_usleep(sleep_time);
             return 0;
         }
         av_log(NULL, AV_LOG_VERBOSE, "No more inputs to read from, finishing.\n");
         return AVERROR_EOF;
     }
 
-    if (ost->filter && !ost->filter->graph->graph) {
+    if (ost->filter && !ost->audio_fast && !ost->filter->graph->graph) {
         if (ifilter_has_all_input_formats(ost->filter->graph)) {
             ret = configure_filtergraph(run_context,ost->filter->graph);
             if (ret < 0) {
@@ -3390,7 +3843,10 @@ static int transcode_step(RunContext *run_context)
         }
     }
 
-    if (ost->filter && ost->filter->graph->graph) {
+    if (ost->audio_fast) {
+        // decoding the input encodes it too, see send_frame_to_filters
+        ist = run_context->option_input.input_streams[ost->source_index];
+    } else if (ost->filter && ost->filter->graph->graph) {
         /*
          * Similar case to the early audio initialization in reap_filters.
          * Audio is special in ffmpeg.c currently as we depend on lavfi's
@@ -3687,113 +4143,174 @@ static int need_output(RunContext *run_context)
 //        print_final_stats(total_size);
 //}
 
-static int flush_encoders(RunContext *run_context)
+static int flush_encoder(RunContext *run_context, OutputStream *ost)
 {
-    int i, ret;
+    AVCodecContext *enc = ost->enc_ctx;
+    OutputFile      *of = run_context->option_output.output_files[ost->file_index];
+    int ret;
 
-    for (i = 0; i < run_context->option_output.nb_output_streams; i++) {
-        OutputStream   *ost = run_context->option_output.output_streams[i];
-        AVCodecContext *enc = ost->enc_ctx;
-        OutputFile      *of = run_context->option_output.output_files[ost->file_index];
+    if (!ost->encoding_needed)
+        return 0;
 
-        if (!ost->encoding_needed)
-            continue;
+    // Try to enable encoding with no input frames.
+    // Maybe we should just let encoding fail instead.
+    if (!ost->initialized) {
+        FilterGraph *fg = ost->filter->graph;
 
-        // Try to enable encoding with no input frames.
-        // Maybe we should just let encoding fail instead.
-        if (!ost->initialized) {
-            FilterGraph *fg = ost->filter->graph;
+        av_log(NULL, AV_LOG_WARNING,
+               "Finishing stream %d:%d without any data written to it.\n",
+               ost->file_index, ost->st->index);
 
-            av_log(NULL, AV_LOG_WARNING,
-                   "Finishing stream %d:%d without any data written to it.\n",
-                   ost->file_index, ost->st->index);
+        if (ost->audio_fast) {
+            AVCodecParameters *par = get_input_stream(run_context, ost)->st->codecpar;
 
-            if (ost->filter && !fg->graph) {
-                int x;
-                for (x = 0; x < fg->nb_inputs; x++) {
-                    InputFilter *ifilter = fg->inputs[x];
-                    if (ifilter->format < 0)
-                        ifilter_parameters_from_codecpar(ifilter, ifilter->ist->st->codecpar);
-                }
+            if (!ost->audio_convert &&
+                audio_fast_init(run_context, ost, par->format, par->sample_rate,
+                                par->channel_layout, par->channels) < 0)
+                return 0;
+        } else if (ost->filter && !fg->graph) {
+            int x;
+            for (x = 0; x < fg->nb_inputs; x++) {
+                InputFilter *ifilter = fg->inputs[x];
+                if (ifilter->format < 0)
+                    ifilter_parameters_from_codecpar(ifilter, ifilter->ist->st->codecpar);
+            }
 
-                if (!ifilter_has_all_input_formats(fg))
-                    continue;
+            if (!ifilter_has_all_input_formats(fg))
+                return 0;
 
-                ret = configure_filtergraph(run_context,fg);
-                if (ret < 0) {
-                    av_log(NULL, AV_LOG_ERROR, "Error configuring filter graph\n");
+            ret = configure_filtergraph(run_context,fg);
+            if (ret < 0) {
+                av_log(NULL, AV_LOG_ERROR, "Error configuring filter graph\n");
 //                    exit_program(1);
-                }
-
-                finish_output_stream(run_context,ost);
             }
 
-            init_output_stream_wrapper(run_context,ost, NULL, 1);
+            finish_output_stream(run_context,ost);
         }
 
-        if (enc->codec_type != AVMEDIA_TYPE_VIDEO && enc->codec_type != AVMEDIA_TYPE_AUDIO)
-            continue;
+        init_output_stream_wrapper(run_context,ost, NULL, 1);
+    }
 
-        for (;;) {
-            const char *desc = NULL;
-            AVPacket *pkt = ost->pkt;
-            int pkt_size;
+    if (enc->codec_type != AVMEDIA_TYPE_VIDEO && enc->codec_type != AVMEDIA_TYPE_AUDIO)
+        return 0;
 
-            if (!pkt)
-                break;
+    for (;;) {
+        const char *desc = NULL;
+        AVPacket *pkt = ost->pkt;
+        int pkt_size;
 
-            switch (enc->codec_type) {
-                case AVMEDIA_TYPE_AUDIO:
-                    desc   = "audio";
-                    break;
-                case AVMEDIA_TYPE_VIDEO:
-                    desc   = "video";
-                    break;
-                default:
-                    av_assert0(0);
-            }
+        if (!pkt)
+            break;
 
-//            update_benchmark(NULL);
+        switch (enc->codec_type) {
+            case AVMEDIA_TYPE_AUDIO:
+                desc   = "audio";
+                break;
+            case AVMEDIA_TYPE_VIDEO:
+                desc   = "video";
+                break;
+            default:
+                av_assert0(0);
+        }
 
-            av_packet_unref(pkt);
-            while ((ret = avcodec_receive_packet(enc, pkt)) == AVERROR(EAGAIN)) {
-                ret = avcodec_send_frame(enc, NULL);
-                if (ret < 0) {
-                    av_log(NULL, AV_LOG_FATAL, "%s encoding failed: %s\n",
-                           desc,
-                           av_err2str(ret));
-//                    exit_program(1);
-                    return -1;
-                }
-            }
+//            update_benchmark(NULL);
 
-//            update_benchmark("flush_%s %d.%d", desc, ost->file_index, ost->index);
-            if (ret < 0 && ret != AVERROR_EOF) {
+        av_packet_unref(pkt);
+        while ((ret = avcodec_receive_packet(enc, pkt)) == AVERROR(EAGAIN)) {
+            ret = avcodec_send_frame(enc, NULL);
+            if (ret < 0) {
                 av_log(NULL, AV_LOG_FATAL, "%s encoding failed: %s\n",
                        desc,
                        av_err2str(ret));
-//                exit_program(1);
+//                    exit_program(1);
                 return -1;
             }
-            if (ost->logfile && enc->stats_out) {
-                fprintf(ost->logfile, "%s", enc->stats_out);
-            }
-            if (ret == AVERROR_EOF) {
-                output_packet(run_context,of, pkt, ost, 1);
-                break;
-            }
-            if (ost->finished & MUXER_FINISHED) {
-                av_packet_unref(pkt);
-                continue;
-            }
-            av_packet_rescale_ts(pkt, enc->time_base, ost->mux_timebase);
-            pkt_size = pkt->size;
-            output_packet(run_context,of, pkt, ost, 0);
+        }
+
+//            update_benchmark("flush_%s %d.%d", desc, ost->file_index, ost->index);
+        if (ret < 0 && ret != AVERROR_EOF) {
+            av_log(NULL, AV_LOG_FATAL, "%s encoding failed: %s\n",
+                   desc,
+                   av_err2str(ret));
+//                exit_program(1);
+            return -1;
+        }
+        if (ost->logfile && enc->stats_out) {
+            fprintf(ost->logfile, "%s", enc->stats_out);
+        }
+        if (ret == AVERROR_EOF) {
+            output_packet(run_context,of, pkt, ost, 1);
+            break;
+        }
+        if (ost->finished & MUXER_FINISHED) {
+            av_packet_unref(pkt);
+            continue;
+        }
+        av_packet_rescale_ts(pkt, enc->time_base, ost->mux_timebase);
+        pkt_size = pkt->size;
+        output_packet(run_context,of, pkt, ost, 0);
 //            if (ost->enc_ctx->codec_type == AVMEDIA_TYPE_VIDEO && run_context->vstats_filename) {
 //                do_video_stats(ost, pkt_size);
 //            }
+    }
+    return 0;
+}
+
+static int flush_encoders(RunContext *run_context)
+{
+    int i, ret;
+
+    for (i = 0; i < run_context->option_output.nb_output_streams; i++) {
+        OutputStream *ost = run_context->option_output.output_streams[i];
+
+        if (run_context->option_output.output_files[ost->file_index]->closed)
+            continue;
+        if ((ret = flush_encoder(run_context, ost)) < 0)
+            return ret;
+    }
+    return 0;
+}
+
+/*
+ * -multi_clip: an output whose streams all finished (its -t window ended) gets its encoders
+ * flushed and its trailer written right away instead of after the whole input, the other
+ * outputs keep reading. the frames its filters still produce are dropped in reap_filters.
+ */
+static int close_finished_outputs(RunContext *run_context)
+{
+    int i, j, ret;
+
+    for (i = 0; i < run_context->option_output.nb_output_files; i++) {
+        OutputFile *of = run_context->option_output.output_files[i];
+        AVFormatContext *os = of->ctx;
+
+        if (of->closed || !of->header_written)
+            continue;
+        for (j = 0; j < os->nb_streams; j++) {
+            if (!run_context->option_output.output_streams[of->ost_index + j]->finished)
+                break;
+        }
+        if (j < os->nb_streams)
+            continue;
+
+        for (j = 0; j < os->nb_streams; j++) {
+            if ((ret = flush_encoder(run_context, run_context->option_output.output_streams[of->ost_index + j])) < 0)
+                return ret;
+        }
+        of->closed = 1;
+        if ((ret = av_write_trailer(os)) < 0) {
+            av_log(NULL, AV_LOG_ERROR, "Error writing trailer of %s: %s\n", os->url, av_err2str(ret));
+            return ret;
         }
+        if (of->mem_output)
+            charge_mem_output(run_context, of);
+        // memory outputs stay open for the caller, they are closed in ffmpegg_cleanup
+        else if (!b64mem_owns(os->pb) && !(os->oformat->flags & AVFMT_NOFILE))
+            avio_closep(&os->pb);
+        av_log(NULL, AV_LOG_VERBOSE, "tid=%s,output file %d (%s) closed, window complete\n",
+               run_context->trace_id, i, os->url);
     }
+    return 0;
 }
 
 //void hw_device_free_all(RunContext *run_context)
@@ -3849,10 +4366,16 @@ int transcode(RunContext *run_context)
         }
 
         ret = transcode_step(run_context);
+        if (atomic_load(&run_context->mem_exceeded)) {
+            ret = AVERROR(ENOMEM);
+            goto fail;
+        }
         if (ret < 0 && ret != AVERROR_EOF) {
             av_log(NULL, AV_LOG_ERROR, "Error while filtering: %s\n", av_err2str(ret));
             break;
         }
+        if (run_context->multi_clip && (ret = close_finished_outputs(run_context)) < 0)
+            break;
 
         /* dump report by using the output first video and audio streams */
 //        print_report(0, timer_start, cur_time);
@@ -3877,6 +4400,8 @@ int transcode(RunContext *run_context)
     /* write the trailer if needed and close file */
     for (i = 0; i < run_context->option_output.nb_output_files; i++) {
         os = run_context->option_output.output_files[i]->ctx;
+        if (run_context->option_output.output_files[i]->closed)
+            continue;
         if (!run_context->option_output.output_files[i]->header_written) {
             av_log(NULL, AV_LOG_ERROR,
                    "Nothing was written into output file %d (%s), because "
@@ -3890,6 +4415,8 @@ int transcode(RunContext *run_context)
 //                exit_program(1);
             return -1;
         }
+        if (run_context->option_output.output_files[i]->mem_output)
+            charge_mem_output(run_context, run_context->option_output.output_files[i]);
     }
 
     /* dump report by using the first video and audio streams */
@@ -3902,6 +4429,13 @@ int transcode(RunContext *run_context)
             av_freep(&ost->enc_ctx->stats_in);
         }
         total_packets_written += ost->packets_written;
+        if (ost->last_mux_dts != AV_NOPTS_VALUE)
+            run_context->output_duration = FFMAX(run_context->output_duration,
+                                                 av_rescale_q(ost->last_mux_dts, ost->st->time_base, AV_TIME_BASE_Q));
+        if (ost->muxing_queue_peak_packets)
+            av_log(NULL, AV_LOG_VERBOSE, "tid=%s,muxing queue of output stream %d:%d peaked at %d packets, %zu bytes\n",
+                   run_context->trace_id, ost->file_index, ost->index,
+                   ost->muxing_queue_peak_packets, ost->muxing_queue_peak_data_size);
         if (!ost->packets_written && (run_context->abort_on_flags & ABORT_ON_FLAG_EMPTY_OUTPUT_STREAM)) {
             av_log(NULL, AV_LOG_FATAL, "Empty output on stream %d.\n", i);
 //            exit_program(1);
@@ -3927,8 +4461,8 @@ int transcode(RunContext *run_context)
 
     hw_device_free_all(run_context);
 
-    /* finished ! */
-    ret = 0;
+    /* finished ! unless the trailers went over the memory limit */
+    ret = atomic_load(&run_context->mem_exceeded) ? AVERROR(ENOMEM) : 0;
 
     fail:
 #if HAVE_THREADS
@@ -3966,9 +4500,11 @@ static void *input_thread(void *arg)
 {
     InputFile *f = arg;
     AVPacket *pkt = f->pkt, *queue_pkt;
-    unsigned flags = f->non_blocking ? AV_THREAD_MESSAGE_NONBLOCK : 0;
+    int nonblock = f->non_blocking;
     int ret = 0;
 
+    job_log_enter(f->p_run_context);
+
     while (1) {
         ret = av_read_frame(f->ctx, pkt);
 
@@ -3977,36 +4513,45 @@ static void *input_thread(void *arg)
             continue;
         }
         if (ret < 0) {
-            av_thread_message_queue_set_err_recv(f->in_thread_queue, ret);
+            input_queue_set_err_recv(f->in_thread_queue, ret);
             break;
         }
         queue_pkt = av_packet_alloc();
         if (!queue_pkt) {
             av_packet_unref(pkt);
-            av_thread_message_queue_set_err_recv(f->in_thread_queue, AVERROR(ENOMEM));
+            input_queue_set_err_recv(f->in_thread_queue, AVERROR(ENOMEM));
             break;
         }
         av_packet_move_ref(queue_pkt, pkt);
-        ret = av_thread_message_queue_send(f->in_thread_queue, &queue_pkt, flags);
-        if (flags && ret == AVERROR(EAGAIN)) {
-            flags = 0;
-            ret = av_thread_message_queue_send(f->in_thread_queue, &queue_pkt, flags);
+        if ((ret = job_mem_charge(f->p_run_context, queue_pkt->size)) < 0) {
+            av_packet_free(&queue_pkt);
+            input_queue_set_err_recv(f->in_thread_queue, ret);
+            break;
+        }
+        ret = input_queue_send(f->in_thread_queue, queue_pkt, nonblock);
+        if (nonblock && ret == AVERROR(EAGAIN)) {
+            InputQueueStats stats;
+            input_queue_get_stats(f->in_thread_queue, &stats);
+            nonblock = 0;
+            ret = input_queue_send(f->in_thread_queue, queue_pkt, nonblock);
             av_log(f->ctx, AV_LOG_WARNING,
                    "Thread message queue blocking; consider raising the "
-                   "thread_queue_size option (current value: %d)\n",
-                   f->thread_queue_size);
+                   "thread_queue_size option (current depth: %d)\n",
+                   stats.depth);
         }
         if (ret < 0) {
             if (ret != AVERROR_EOF)
                 av_log(f->ctx, AV_LOG_ERROR,
                        "Unable to send packet to main thread: %s\n",
                        av_err2str(ret));
+            job_mem_release(f->p_run_context, queue_pkt->size);
             av_packet_free(&queue_pkt);
-            av_thread_message_queue_set_err_recv(f->in_thread_queue, ret);
+            input_queue_set_err_recv(f->in_thread_queue, ret);
             break;
         }
     }
 
+    job_log_leave();
     return NULL;
 }
 
@@ -4014,16 +4559,27 @@ static void free_input_thread(RunContext  *run_context,int i)
 {
     InputFile *f = run_context->option_input.input_files[i];
     AVPacket *pkt;
+    InputQueueStats stats;
 
     if (!f || !f->in_thread_queue)
         return;
-    av_thread_message_queue_set_err_send(f->in_thread_queue, AVERROR_EOF);
-    while (av_thread_message_queue_recv(f->in_thread_queue, &pkt, 0) >= 0)
+    // before draining, which would count as stalls
+    input_queue_get_stats(f->in_thread_queue, &stats);
+    input_queue_set_err_send(f->in_thread_queue, AVERROR_EOF);
+    while (input_queue_recv(f->in_thread_queue, &pkt, 0) >= 0) {
+        job_mem_release(run_context, pkt->size);
         av_packet_free(&pkt);
+    }
 
     pthread_join(f->thread, NULL);
     f->joined = 1;
-    av_thread_message_queue_free(&f->in_thread_queue);
+
+    av_log(NULL, AV_LOG_VERBOSE, "tid=%s,input file #%d queue depth %d (peak %d), %"PRId64" reader stalls, %"PRId64" consumer stalls\n",
+           run_context->trace_id, i, stats.depth, stats.peak_depth, stats.nb_send_stalls, stats.nb_recv_stalls);
+    run_context->input_queue_depth = FFMAX(run_context->input_queue_depth, stats.depth);
+    run_context->nb_input_send_stalls += stats.nb_send_stalls;
+    run_context->nb_input_recv_stalls += stats.nb_recv_stalls;
+    input_queue_free(&f->in_thread_queue);
 }
 
 static void free_input_threads(RunContext  *run_context)
@@ -4039,22 +4595,30 @@ static int init_input_thread(RunContext *run_context,int i)
     int ret;
     InputFile *f = run_context->option_input.input_files[i];
 
-    if (f->thread_queue_size < 0)
+    if (f->thread_queue_size < 0) {
         f->thread_queue_size = (run_context->option_input.nb_input_files > 1 ? 8 : 0);
+        f->thread_queue_adaptive = 1;
+    }
     if (!f->thread_queue_size)
         return 0;
 
     if (f->ctx->pb ? !f->ctx->pb->seekable :
         strcmp(f->ctx->iformat->name, "lavfi"))
         f->non_blocking = 1;
-    ret = av_thread_message_queue_alloc(&f->in_thread_queue,
-                                        f->thread_queue_size, sizeof(f->pkt));
+    // an explicit -thread_queue_size is kept as is
+    if (f->thread_queue_adaptive)
+        ret = input_queue_alloc(&f->in_thread_queue, f->thread_queue_size,
+                                INPUT_QUEUE_MIN_DEPTH, INPUT_QUEUE_MAX_DEPTH, INPUT_QUEUE_MAX_BYTES);
+    else
+        ret = input_queue_alloc(&f->in_thread_queue, f->thread_queue_size,
+                                f->thread_queue_size, f->thread_queue_size, INT64_MAX);
     if (ret < 0)
         return ret;
 
+    f->p_run_context = run_context;
     if ((ret = pthread_create(&f->thread, NULL, input_thread, f))) {
         av_log(NULL, AV_LOG_ERROR, "pthread_create failed: %s. Try to increase `ulimit -v` or decrease `ulimit -s`.\n", strerror(ret));
-        av_thread_message_queue_free(&f->in_thread_queue);
+        input_queue_free(&f->in_thread_queue);
         return AVERROR(ret);
     }
 
@@ -4075,9 +4639,10 @@ static int init_input_threads(RunContext *run_context)
 
 static int get_input_packet_mt(InputFile *f, AVPacket **pkt)
 {
-    return av_thread_message_queue_recv(f->in_thread_queue, pkt,
-                                        f->non_blocking ?
-                                        AV_THREAD_MESSAGE_NONBLOCK : 0);
+    int ret = input_queue_recv(f->in_thread_queue, pkt, f->non_blocking);
+    if (ret >= 0)
+        job_mem_release(f->p_run_context, (*pkt)->size);
+    return ret;
 }
 #endif
 
@@ -4110,6 +4675,7 @@ void ffmpegg_cleanup(ParsedOptionsContext *parsed_ctx)
     RunContext *run_context = &parsed_ctx->raw_context;
     for (i = 0; i < run_context->nb_filtergraphs; i++) {
         FilterGraph *fg = run_context->filtergraphs[i];
+        filter_pool_detach(fg);
         avfilter_graph_free(&fg->graph);
         for (j = 0; j < fg->nb_inputs; j++) {
             InputFilter *ifilter = fg->inputs[j];
@@ -4119,6 +4685,7 @@ void ffmpegg_cleanup(ParsedOptionsContext *parsed_ctx)
                 AVFrame *frame;
                 av_fifo_generic_read(ifilter->frame_queue, &frame,
                                      sizeof(frame), NULL);
+                job_mem_release(run_context, job_mem_frame_size(frame));
                 av_frame_free(&frame);
             }
             av_fifo_freep(&ifilter->frame_queue);
@@ -4162,7 +4729,11 @@ void ffmpegg_cleanup(ParsedOptionsContext *parsed_ctx)
         if (!of)
             continue;
         s = of->ctx;
-        if (s && s->oformat && !(s->oformat->flags & AVFMT_NOFILE))
+        // the data of a memory output now belongs to the caller
+        job_mem_release(run_context, of->mem_charged);
+        if (s && b64mem_owns(s->pb))
+            b64mem_close(&s->pb);
+        else if (s && s->oformat && !(s->oformat->flags & AVFMT_NOFILE))
             avio_closep(&s->pb);
         avformat_free_context(s);
         av_dict_free(&of->opts);
@@ -4179,6 +4750,7 @@ void ffmpegg_cleanup(ParsedOptionsContext *parsed_ctx)
 
         av_frame_free(&ost->filtered_frame);
         av_frame_free(&ost->last_frame);
+        audio_convert_free(&ost->audio_convert);
         av_packet_free(&ost->pkt);
         av_dict_free(&ost->encoder_opts);
 
@@ -4194,13 +4766,16 @@ void ffmpegg_cleanup(ParsedOptionsContext *parsed_ctx)
         av_dict_free(&ost->swr_opts);
 
         avcodec_free_context(&ost->enc_ctx);
+        codec_pool_release(&ost->pool_reserved_threads);
         avcodec_parameters_free(&ost->ref_par);
 
         if (ost->muxing_queue) {
             while (av_fifo_size(ost->muxing_queue)) {
                 AVPacket *pkt;
                 av_fifo_generic_read(ost->muxing_queue, &pkt, sizeof(pkt), NULL);
-                av_packet_free(&pkt);
+                mux_queue_popped(pkt->size);
+                job_mem_release(run_context, pkt->size);
+                mux_queue_packet_put(&pkt);
             }
             av_fifo_freep(&ost->muxing_queue);
         }
@@ -4213,7 +4788,14 @@ void ffmpegg_cleanup(ParsedOptionsContext *parsed_ctx)
     }
 #endif
     for (i = 0; i < run_context->option_input.nb_input_files; i++) {
+        AVFormatContext *ic = run_context->option_input.input_files[i]->ctx;
+        AVIOContext *b64_pb = ic && b64mem_owns(ic->pb) ? ic->pb : NULL;
+        AVIOContext *file_pb = ic && file_io_owns(ic->pb) ? ic->pb : NULL;
+        if (ic && run_context->option_input.input_files[i]->seek_index)
+            seek_index_save(ic, ic->url);
         avformat_close_input(&run_context->option_input.input_files[i]->ctx);
+        b64mem_close(&b64_pb);
+        file_io_close(&file_pb);
         av_packet_free(&run_context->option_input.input_files[i]->pkt);
         av_freep(&run_context->option_input.input_files[i]);
     }
@@ -4222,15 +4804,20 @@ void ffmpegg_cleanup(ParsedOptionsContext *parsed_ctx)
 
         av_frame_free(&ist->decoded_frame);
         av_frame_free(&ist->filter_frame);
+        av_frame_free(&ist->hwaccel_download_frame);
+        download_pool_uninit(&ist->hwaccel_download_pool);
         av_packet_free(&ist->pkt);
         av_dict_free(&ist->decoder_opts);
         avsubtitle_free(&ist->prev_sub.subtitle);
         av_frame_free(&ist->sub2video.frame);
+        av_buffer_pool_uninit(&ist->sub2video.pool);
         av_freep(&ist->filters);
         av_freep(&ist->hwaccel_device);
         av_freep(&ist->dts_buffer);
+        av_freep(&ist->latency);
 
         avcodec_free_context(&ist->dec_ctx);
+        codec_pool_release(&ist->pool_reserved_threads);
 
         av_freep(&run_context->option_input.input_streams[i]);
     }
@@ -19,6 +19,8 @@ static int do_subtitle_out(RunContext *run_context,OutputFile *of,
 static int output_packet(RunContext *run_context,OutputFile *of, AVPacket *pkt,
                          OutputStream *ost, int eof);
 static void close_output_stream(RunContext *run_context,OutputStream *ost);
+static int audio_fast_send(RunContext *run_context, OutputStream *ost, const AVFrame *frame);
+static int audio_fast_eof(RunContext *run_context, InputFilter *ifilter);
 
 #if HAVE_THREADS
 static void *input_thread(void *arg);
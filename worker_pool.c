@@ -0,0 +1,169 @@
+//
+// Created by hexiufeng on 2026/10/19.
+//
+
+#include "worker_pool.h"
+#include <pthread.h>
+#include <string.h>
+#include <libavutil/cpu.h>
+#include <libavutil/log.h>
+#include <libavutil/mem.h>
+#include <libavutil/error.h>
+
+typedef struct WorkerPool {
+    pthread_mutex_t lock;
+    pthread_cond_t work_cond;
+    pthread_cond_t done_cond;
+
+    WorkerBatch *head, *tail;
+
+    pthread_t *threads;
+    int nb_threads;
+    int budget;         // < 0 disabled, 0 auto
+} WorkerPool;
+
+static WorkerPool pool = {
+    .lock      = PTHREAD_MUTEX_INITIALIZER,
+    .work_cond = PTHREAD_COND_INITIALIZER,
+    .done_cond = PTHREAD_COND_INITIALIZER,
+};
+
+static void queue_remove(WorkerBatch *b)
+{
+    WorkerBatch **p = &pool.head, *prev = NULL;
+
+    while (*p && *p != b) {
+        prev = *p;
+        p = &(*p)->next;
+    }
+    if (!*p)
+        return;
+    *p = b->next;
+    if (pool.tail == b)
+        pool.tail = prev;
+    b->next = NULL;
+}
+
+static void queue_push(WorkerBatch *b)
+{
+    b->next = NULL;
+    if (pool.tail)
+        pool.tail->next = b;
+    else
+        pool.head = b;
+    pool.tail = b;
+}
+
+/* hand out one job of b, called with the lock held. returns -1 when nothing is left */
+static int take_job(WorkerBatch *b)
+{
+    int jobnr;
+
+    if (b->next_job >= b->nb_jobs)
+        return -1;
+    jobnr = b->next_job++;
+    queue_remove(b);
+    /* round robin between batches: a batch with many jobs must not starve the others */
+    if (b->next_job < b->nb_jobs)
+        queue_push(b);
+    return jobnr;
+}
+
+static void *pool_worker(void *arg)
+{
+    pthread_mutex_lock(&pool.lock);
+    for (;;) {
+        WorkerBatch *b = pool.head;
+        int jobnr;
+
+        if (!b) {
+            pthread_cond_wait(&pool.work_cond, &pool.lock);
+            continue;
+        }
+        jobnr = take_job(b);
+        pthread_mutex_unlock(&pool.lock);
+
+        b->run(b, jobnr);
+
+        pthread_mutex_lock(&pool.lock);
+        if (++b->nb_done == b->nb_jobs)
+            pthread_cond_broadcast(&pool.done_cond);
+    }
+    return NULL;
+}
+
+void worker_pool_execute(WorkerBatch *b)
+{
+    int jobnr;
+
+    b->next_job = 0;
+    b->nb_done  = 0;
+    b->next     = NULL;
+
+    if (b->nb_jobs <= 1)
+        goto run_inline;
+
+    pthread_mutex_lock(&pool.lock);
+    if (!pool.nb_threads) {
+        pthread_mutex_unlock(&pool.lock);
+        goto run_inline;
+    }
+    queue_push(b);
+    if (b->nb_jobs > 2)
+        pthread_cond_broadcast(&pool.work_cond);
+    else
+        pthread_cond_signal(&pool.work_cond);
+
+    while ((jobnr = take_job(b)) >= 0) {
+        pthread_mutex_unlock(&pool.lock);
+        b->run(b, jobnr);
+        pthread_mutex_lock(&pool.lock);
+        b->nb_done++;
+    }
+    while (b->nb_done < b->nb_jobs)
+        pthread_cond_wait(&pool.done_cond, &pool.lock);
+    pthread_mutex_unlock(&pool.lock);
+    return;
+
+    run_inline:
+    for (jobnr = 0; jobnr < b->nb_jobs; jobnr++)
+        b->run(b, jobnr);
+}
+
+void worker_pool_set_budget(int budget)
+{
+    pthread_mutex_lock(&pool.lock);
+    pool.budget = budget;
+    pthread_mutex_unlock(&pool.lock);
+}
+
+int worker_pool_start(void)
+{
+    int want, ret;
+
+    pthread_mutex_lock(&pool.lock);
+    if (pool.budget < 0) {
+        pthread_mutex_unlock(&pool.lock);
+        return 0;
+    }
+    // workers are never stopped, a lowered budget only lowers the share handed out
+    want = pool.budget ? pool.budget : av_cpu_count();
+    if (pool.nb_threads < want) {
+        if (av_reallocp_array(&pool.threads, want, sizeof(*pool.threads)) < 0) {
+            pthread_mutex_unlock(&pool.lock);
+            return AVERROR(ENOMEM);
+        }
+        while (pool.nb_threads < want) {
+            ret = pthread_create(&pool.threads[pool.nb_threads], NULL, pool_worker, NULL);
+            if (ret) {
+                av_log(NULL, AV_LOG_ERROR, "worker pool: pthread_create failed: %s\n", strerror(ret));
+                break;
+            }
+            pthread_detach(pool.threads[pool.nb_threads]);
+            pool.nb_threads++;
+        }
+    }
+    ret = pool.nb_threads < want ? pool.nb_threads : want;
+    pthread_mutex_unlock(&pool.lock);
+    return ret;
+}
@@ -0,0 +1,37 @@
+//
+// Created by hexiufeng on 2026/10/19.
+//
+
+#ifndef RUN_FFMPEG_WORKER_POOL_H
+#define RUN_FFMPEG_WORKER_POOL_H
+
+/*
+ * the one process-wide pool of worker threads. filter graphs (filter_pool.c) and
+ * codecs (codec_pool.c) of every job submit batches of independent jobs to it
+ * instead of owning threads.
+ */
+
+typedef struct WorkerBatch {
+    void (*run)(struct WorkerBatch *b, int jobnr);
+    void *priv;
+    int nb_jobs;
+
+    /* owned by the pool */
+    int next_job;
+    int nb_done;
+    struct WorkerBatch *next;
+} WorkerBatch;
+
+/* budget < 0 disables the pool, 0 means one worker per cpu */
+void worker_pool_set_budget(int budget);
+
+/* start the workers if needed. returns the number of workers, 0 when the pool is disabled */
+int worker_pool_start(void);
+
+/*
+ * run all jobs of b and return once they are finished. the calling thread runs
+ * jobs of its own batch too, so a saturated pool slows a batch down but never stalls it
+ */
+void worker_pool_execute(WorkerBatch *b);
+
+#endif //RUN_FFMPEG_WORKER_POOL_H